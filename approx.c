@@ -0,0 +1,172 @@
+/*
+ * Power-law and exponential kernels
+ *
+ * With the -A option, the power laws in ion() and pathloss() and the
+ * exponential in the multipath test use the kernels below in place of
+ * the general-purpose pow() and exp(). Each has a bounded, smooth input
+ * and a fixed exponent, so it can be done with a small table and a
+ * short polynomial.
+ *
+ * For x^a, x = m 2^e with m in [1/2, 1) by frexp(). The factor 2^(a e)
+ * comes from a table over e. The mantissa range is split into NXBIN
+ * bins; m^a is the table value at the center c of the bin times the
+ * cubic of the binomial series for (1 + t)^a, where t = m / c - 1 is
+ * less than 1 / NXBIN in magnitude. The relative error is below 2e-10
+ * for the exponents used here. E-layer critical frequency x^.25 is
+ * sqrt(sqrt(x)), which is as good as pow().
+ *
+ * For e^x, x = (64 n + j) ln2 / 64 + r with |r| <= ln2 / 128, so e^x is
+ * 2^n times the table value 2^(j / 64) times the quartic for e^r, with
+ * a relative error below 1e-13.
+ *
+ * Arguments out of the table ranges are passed to pow() and exp(). The
+ * verify mode (-V) checks the predictions against the reference kernel
+ * with the kernels in use.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#define NXBIN	64		/* mantissa bins */
+#define NXEXP	64		/* max binary exponent in tables */
+#define NXTAB	64		/* exponential table size */
+#define LN2	0.69314718055994530942 /* natural logarithm of 2 */
+
+/*
+ * Power-law tables for one exponent
+ */
+struct xpow {
+	double a;		/* exponent */
+	double c1, c2, c3;	/* binomial series coefficients */
+	double cpow[NXBIN];	/* bin center to the power a */
+	double crec[NXBIN];	/* reciprocal of bin center */
+	double epow[2 * NXEXP + 1]; /* 2^(a e) for e = -NXEXP to NXEXP */
+};
+
+static struct xpow p03;		/* x^.3 */
+static struct xpow pm002;	/* x^-.02 */
+static double etab[NXTAB];	/* 2^(j / NXTAB) */
+
+/*
+ * Local function declarations
+ */
+static void xpinit(struct xpow *, double);
+static double xpow(struct xpow *, double);
+
+/*
+ * xinit() - compute kernel tables
+ */
+void
+xinit(void)
+{
+	int j;
+
+	xpinit(&p03, .3);
+	xpinit(&pm002, -.02);
+	for (j = 0; j < NXTAB; j++)
+		etab[j] = pow(2., (double)j / NXTAB);
+}
+
+/*
+ * xpow25(x) - x^.25
+ */
+double
+xpow25(
+	double x		/* argument */
+	)
+{
+	return (sqrt(sqrt(x)));
+}
+
+/*
+ * xpow13(x) - x^1.3
+ */
+double
+xpow13(
+	double x		/* argument */
+	)
+{
+	return (x * xpow(&p03, x));
+}
+
+/*
+ * xpow198(x) - x^1.98
+ */
+double
+xpow198(
+	double x		/* argument */
+	)
+{
+	return (x * x * xpow(&pm002, x));
+}
+
+/*
+ * xexp(x) - e^x
+ */
+double
+xexp(
+	double x		/* argument */
+	)
+{
+	double r;		/* reduced argument */
+	int n, j;
+
+	if (!(x > -700. && x < 700.))
+		return (exp(x));
+	n = (int)floor(x * (NXTAB / LN2) + .5);
+	r = x - n * (LN2 / NXTAB);
+	j = n & (NXTAB - 1);
+	n = (n - j) / NXTAB;
+	r = 1. + r * (1. + r * (1. / 2. + r * (1. / 6. + r * (1. / 24.))));
+	return (ldexp(etab[j] * r, n));
+}
+
+/*
+ * xpinit(xp, a) - compute power-law tables
+ */
+static void
+xpinit(
+	struct xpow *xp,	/* tables */
+	double a		/* exponent */
+	)
+{
+	double c;		/* bin center */
+	int i;
+
+	xp->a = a;
+	xp->c1 = a;
+	xp->c2 = a * (a - 1.) / 2.;
+	xp->c3 = a * (a - 1.) * (a - 2.) / 6.;
+	for (i = 0; i < NXBIN; i++) {
+		c = .5 + (i + .5) / (2. * NXBIN);
+		xp->cpow[i] = pow(c, a);
+		xp->crec[i] = 1. / c;
+	}
+	for (i = -NXEXP; i <= NXEXP; i++)
+		xp->epow[i + NXEXP] = pow(2., a * i);
+}
+
+/*
+ * xpow(xp, x) - x^a from tables
+ */
+static double
+xpow(
+	struct xpow *xp,	/* tables */
+	double x		/* argument */
+	)
+{
+	double m, t;		/* mantissa, offset from bin center */
+	int e, i;
+
+	if (!(x > 0.))
+		return (pow(x, xp->a));
+	m = frexp(x, &e);
+	if (e < -NXEXP || e > NXEXP)
+		return (pow(x, xp->a));
+	i = (int)((m - .5) * (2. * NXBIN));
+	t = m * xp->crec[i] - 1.;
+	return (xp->cpow[i] * xp->epow[e + NXEXP] * (1. + t * (xp->c1 + t *
+	    (xp->c2 + t * xp->c3))));
+}
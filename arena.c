@@ -0,0 +1,335 @@
+/*
+ * Arenas and pools
+ *
+ * Storage that lives only as long as one query, such as the candidate
+ * and reachable lists of the search and reverse query modes and the
+ * scratch space for sorting them, is taken from an arena, which hands
+ * out space from large blocks by bumping a pointer and gives it all
+ * back at once when reset after each query. The blocks are kept over
+ * the reset, so once the arena has grown to the size of the largest
+ * query, the queries that follow make no calls to malloc(). Each thread
+ * has an arena of its own (see athread()), so no locking is needed.
+ *
+ * Blocks of one size that are taken and returned in any order, such as
+ * the result blocks of the pipeline slots, come from a pool, which
+ * allocates them a slab at a time and keeps the free blocks on a list.
+ * A pool is used by one thread at a time.
+ *
+ * The allocation counters are displayed on stderr at exit when the -T
+ * option is given. A block or slab allocated after the arena has first
+ * been reset after use, or after the first block has been returned to
+ * the pool, is counted as a steady-state allocation, which happens only
+ * when a query needs more space than any before it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minimuf.h"
+
+#define ACHUNK	65536		/* arena block size */
+#define AALIGN	16		/* allocation alignment */
+#define AROUND(n) (((n) + AALIGN - 1) & ~(size_t)(AALIGN - 1))
+
+/*
+ * Arena block header, followed by the space handed out
+ */
+struct ablock {
+	struct ablock *next;	/* next block */
+	size_t size;		/* size of space */
+};
+
+#define AHEAD	AROUND(sizeof(struct ablock))
+
+static __thread struct arena tarena; /* arena of this thread */
+
+static long nalloc;		/* arena allocations */
+static long nreset;		/* arena resets */
+static long nget;		/* pool blocks taken */
+static long nblock;		/* arena blocks and pool slabs allocated */
+static long nsteady;		/* those allocated in steady state */
+
+/*
+ * Local function declarations
+ */
+static void asort1(char *, char *, size_t, size_t,
+    int (*)(const void *, const void *));
+static int pslab(struct pool *);
+static void astats(void);
+
+/*
+ * athread() - arena of the calling thread
+ */
+struct arena *
+athread(void)
+{
+	return (&tarena);
+}
+
+/*
+ * aalloc(ap, n) - allocate space from arena
+ *
+ * Returns a pointer to the space, aligned for any type, or NULL if no
+ * memory.
+ */
+void *
+aalloc(
+	struct arena *ap,	/* arena */
+	size_t n		/* bytes */
+	)
+{
+	struct ablock *bp;	/* block */
+	char *cp;		/* space */
+	size_t size;		/* block size */
+
+	__atomic_add_fetch(&nalloc, 1, __ATOMIC_RELAXED);
+	n = AROUND(n);
+	if (ap->cur == NULL || (size_t)(ap->end - ap->next) < n) {
+
+		/*
+		 * Move on to the next block that was kept over the last
+		 * reset, or allocate one after the current block.
+		 */
+		bp = ap->cur == NULL ? ap->head : ap->cur->next;
+		if (bp == NULL || bp->size < n) {
+			size = n > ACHUNK ? n : ACHUNK;
+			bp = malloc(AHEAD + size);
+			if (bp == NULL)
+				return (NULL);
+			__atomic_add_fetch(&nblock, 1, __ATOMIC_RELAXED);
+			if (ap->warm)
+				__atomic_add_fetch(&nsteady, 1,
+				    __ATOMIC_RELAXED);
+			bp->size = size;
+			if (ap->cur == NULL) {
+				bp->next = ap->head;
+				ap->head = bp;
+			} else {
+				bp->next = ap->cur->next;
+				ap->cur->next = bp;
+			}
+		}
+		ap->cur = bp;
+		ap->next = (char *)bp + AHEAD;
+		ap->end = ap->next + bp->size;
+	}
+	cp = ap->next;
+	ap->next += n;
+	return (cp);
+}
+
+/*
+ * arealloc(ap, p, old, n) - grow space allocated from arena
+ *
+ * The space is grown in place if it was the last allocated and there
+ * is room in the block; otherwise the contents are copied to new space.
+ * Returns a pointer to the space or NULL if no memory.
+ */
+void *
+arealloc(
+	struct arena *ap,	/* arena */
+	void *p,		/* space (NULL if none) */
+	size_t old,		/* bytes in use */
+	size_t n		/* bytes wanted */
+	)
+{
+	char *cp;		/* new space */
+
+	if (p != NULL && (char *)p + AROUND(old) == ap->next &&
+	    (size_t)(ap->end - (char *)p) >= AROUND(n)) {
+		ap->next = (char *)p + AROUND(n);
+		return (p);
+	}
+	cp = aalloc(ap, n);
+	if (cp != NULL && p != NULL)
+		memcpy(cp, p, old < n ? old : n);
+	return (cp);
+}
+
+/*
+ * areset(ap) - free all space allocated from arena
+ *
+ * The blocks are kept for the next query.
+ */
+void
+areset(
+	struct arena *ap	/* arena */
+	)
+{
+	__atomic_add_fetch(&nreset, 1, __ATOMIC_RELAXED);
+	if (ap->cur != NULL)
+		ap->warm = 1;
+	ap->cur = NULL;
+	ap->next = ap->end = NULL;
+}
+
+/*
+ * asort(ap, base, n, size, cmp) - stable sort with arena scratch
+ *
+ * This is a merge sort, as is qsort() in the GNU C library when it
+ * can allocate the scratch space, so items that compare equal are in
+ * the same order; but the scratch space comes from the arena rather
+ * than malloc(). Returns 0 if ok, -1 if no memory.
+ */
+int
+asort(
+	struct arena *ap,	/* arena */
+	void *base,		/* items */
+	size_t n,		/* number of items */
+	size_t size,		/* item size */
+	int (*cmp)(const void *, const void *) /* comparison */
+	)
+{
+	char *tmp;		/* scratch space */
+
+	if (n < 2)
+		return (0);
+	tmp = aalloc(ap, n * size);
+	if (tmp == NULL)
+		return (-1);
+	asort1(base, tmp, n, size, cmp);
+	return (0);
+}
+
+/*
+ * asort1(base, tmp, n, size, cmp) - merge sort
+ *
+ * The halves are sorted in place, then merged into the scratch space
+ * and copied back.
+ */
+static void
+asort1(
+	char *base,		/* items */
+	char *tmp,		/* scratch space */
+	size_t n,		/* number of items */
+	size_t size,		/* item size */
+	int (*cmp)(const void *, const void *) /* comparison */
+	)
+{
+	char *a, *b, *ae, *be, *tp; /* merge pointers */
+	size_t n1;		/* items in first half */
+
+	if (n < 2)
+		return;
+	n1 = n / 2;
+	a = base;
+	b = base + n1 * size;
+	asort1(a, tmp, n1, size, cmp);
+	asort1(b, tmp, n - n1, size, cmp);
+	ae = b;
+	be = base + n * size;
+	tp = tmp;
+	while (a < ae && b < be) {
+		if ((*cmp)(a, b) <= 0) {
+			memcpy(tp, a, size);
+			a += size;
+		} else {
+			memcpy(tp, b, size);
+			b += size;
+		}
+		tp += size;
+	}
+	if (a < ae)
+		memcpy(tp, a, ae - a);
+	memcpy(base, tmp, (tp - tmp) + (ae - a));
+}
+
+/*
+ * pinit(pp, size, n) - initialize pool
+ *
+ * The pool hands out blocks of the given size, n to a slab. Returns 0
+ * if ok, -1 if no memory.
+ */
+int
+pinit(
+	struct pool *pp,	/* pool */
+	size_t size,		/* block size */
+	int n			/* blocks per slab */
+	)
+{
+	pp->size = AROUND(size > sizeof(void *) ? size : sizeof(void *));
+	pp->nslab = n > 0 ? n : 1;
+	pp->free = NULL;
+	pp->warm = 0;
+	return (pslab(pp));
+}
+
+/*
+ * pget(pp) - take block from pool
+ *
+ * Returns a pointer to the block or NULL if no memory.
+ */
+void *
+pget(
+	struct pool *pp		/* pool */
+	)
+{
+	void *bp;		/* block */
+
+	if (pp->free == NULL && pslab(pp) < 0)
+		return (NULL);
+	__atomic_add_fetch(&nget, 1, __ATOMIC_RELAXED);
+	bp = pp->free;
+	pp->free = *(void **)bp;
+	return (bp);
+}
+
+/*
+ * pslab(pp) - add slab to pool
+ *
+ * Returns 0 if ok, -1 if no memory.
+ */
+static int
+pslab(
+	struct pool *pp		/* pool */
+	)
+{
+	char *cp;		/* slab */
+	int i;
+
+	cp = malloc(pp->nslab * pp->size);
+	if (cp == NULL)
+		return (-1);
+	__atomic_add_fetch(&nblock, 1, __ATOMIC_RELAXED);
+	if (pp->warm)
+		__atomic_add_fetch(&nsteady, 1, __ATOMIC_RELAXED);
+	for (i = pp->nslab - 1; i >= 0; i--) {
+		*(void **)(cp + i * pp->size) = pp->free;
+		pp->free = cp + i * pp->size;
+	}
+	return (0);
+}
+
+/*
+ * pput(pp, bp) - return block to pool
+ */
+void
+pput(
+	struct pool *pp,	/* pool */
+	void *bp		/* block */
+	)
+{
+	*(void **)bp = pp->free;
+	pp->free = bp;
+	pp->warm = 1;
+}
+
+/*
+ * ainit() - display allocation counters at exit
+ */
+void
+ainit(void)
+{
+	atexit(astats);
+}
+
+/*
+ * astats() - display allocation counters on stderr
+ */
+static void
+astats(void)
+{
+	fprintf(stderr,
+	    "alloc: %ld arena allocations, %ld resets, %ld pool blocks, %ld mallocs, %ld in steady state\n",
+	    nalloc, nreset, nget, nblock, nsteady);
+}
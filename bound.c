@@ -0,0 +1,213 @@
+/*
+ * Upper bounds for pruning
+ *
+ * The query and search modes reject paths, dates and hours that cannot
+ * produce a usable prediction by comparing upper bounds on the MUF and
+ * receive power against what is wanted, so only the survivors need be
+ * predicted with evaluate(). The bounds depend on the path geometry
+ * computed by pathgeom() and, for the absorption, the sun zenith angle
+ * at the midpoint of the path. They are conservative: the prediction
+ * never exceeds them.
+ *
+ * The F-layer MUF of any hop is no greater than the MINIMUF value for
+ * the path, which is no greater than (1 + ssn / 250) m9 sqrt(6 + 58
+ * sqrt(2)) 1.2, since the daytime term g0 cannot exceed 2 and the
+ * other factors 1.2 in all. Here m9 depends only on the distance. A
+ * frequency is unusable at or above 0.85 times the MUF.
+ *
+ * The receive power is no greater than the power with the largest
+ * antenna gain, the free-space loss for the shortest possible ray
+ * path, the least absorption at normal incidence and the ground-
+ * reflection loss for the min-hop path. When the hour is known, the
+ * ray paths and angles of incidence are those of predict() and only
+ * the absorption and antenna gain are bounded.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+/*
+ * bmuf(par, p) - MUF upper bound for all dates and hours (MHz)
+ *
+ * This follows the geometry factor m9 in minimuf(), which always uses
+ * the short path.
+ */
+double
+bmuf(
+	struct param *pp,	/* prediction parameters */
+	struct path *p		/* path state */
+	)
+{
+	double dist;		/* short-path distance (rad) */
+	double muf;		/* MUF bound (MHz) */
+	double ftemp;		/* double temp */
+
+	dist = pp->options & H_LONG ? PID - p->d : p->d;
+	ftemp = 1.59 * dist;
+	if (ftemp < 1.)
+		ftemp = 1.;
+	ftemp = 2.5 * dist / ftemp;
+	if (ftemp > PIH)
+		ftemp = PIH;
+	ftemp = sin(ftemp);
+	muf = (1. + pp->ssn / 250.) * (1. + 2.5 * ftemp * sqrt(ftemp)) *
+	    sqrt(6. + 58. * sqrt(2.)) * 1.2;
+	if (muf > 100.)
+		muf = 100.;
+	return (muf);
+}
+
+/*
+ * bgain(par) - largest antenna gain (dB)
+ *
+ * The largest gain anywhere in the table bounds the gain at any
+ * frequency and elevation angle.
+ */
+double
+bgain(
+	struct param *pp	/* prediction parameters */
+	)
+{
+	double gmax;		/* max gain (dB) */
+	int i, j;
+
+	if (~pp->options & H_GAIN)
+		return (0);
+	gmax = pp->ant->gain[0][0];
+	for (i = 0; i < 46; i++) {
+		for (j = 0; j < NGAIN; j++) {
+			if (pp->ant->gain[i][j] > gmax)
+				gmax = pp->ant->gain[i][j];
+		}
+	}
+	return (gmax);
+}
+
+/*
+ * babsorp(par, p, psi) - absorption lower bound for one reflection
+ *
+ * The absorption at a reflection zone decreases with the sun zenith
+ * angle there, which on the short path differs from the angle psi at
+ * the midpoint by no more than half the path. Otherwise the bound is
+ * the floor of 0.1.
+ */
+double
+babsorp(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double psi		/* sun zenith angle at midpoint (rad) */
+	)
+{
+	double ftemp;		/* double temp */
+
+	if (pp->options & H_LONG || !(psi >= 0))
+		return (.1);
+	ftemp = psi + p->d / 2. + 1e-6;
+	if (ftemp > 100.8 * D2R)
+		ftemp = 100.8 * D2R;
+	ftemp = cos(90. / 100.8 * ftemp);
+	if (ftemp < 0.)
+		ftemp = 0.;
+	ftemp = (1. + .0037 * pp->ssn) * pow(ftemp, 1.3);
+	if (ftemp < .1)
+		ftemp = .1;
+	return (ftemp);
+}
+
+/*
+ * bpower(par, p, gmax, absorp, freq) - receive power upper bound (dBm)
+ *
+ * The ray path of hop h is 2 h sin(dhop) (R + height) / cos(beta),
+ * where the height is at least hF - 30 and dhop is no greater than for
+ * the min-hop path. Since sin(x) / x decreases with x, the ray path is
+ * at least the great-circle distance scaled by sin(dhop) / dhop for
+ * the min-hop path. There are at least as many reflections as hops.
+ */
+double
+bpower(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double gmax,		/* max antenna gain (dB) */
+	double absorp,		/* min absorption per reflection */
+	double freq		/* frequency (MHz) */
+	)
+{
+	double pmin;		/* path length bound (km) */
+	double signal;		/* receive power bound (dBm) */
+
+	if (p->dhop <= 0 || p->dhop >= PI || freq <= 0)
+		return (HUGE_VAL);
+	pmin = p->d * (R + hF - 30.) * sin(p->dhop) / p->dhop;
+	signal = pp->dB1 + gmax + 30.;
+	signal -= 32.44 + 20. * log10(pmin * freq) + SLOSS;
+	signal -= 677.2 * absorp * p->hop / (pow((freq + GAMMA), 1.98) +
+	    10.2);
+	signal -= p->hop * GLOSS;
+	return (signal);
+}
+
+/*
+ * bhour(par, p, gmax, muf, psi) - receive power upper bound for hour
+ *
+ * This is the largest receive power for any frequency and any of the
+ * three hops considered by predict(), given the MINIMUF value for the
+ * hour and the sun zenith angle at the midpoint, which determines the
+ * F-layer height. The geometry is the same as in predict() and ion();
+ * the absorption is bounded by babsorp(). Returns -HUGE_VAL if no
+ * frequency is below the MUF.
+ */
+double
+bhour(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double gmax,		/* max antenna gain (dB) */
+	double muf,		/* MINIMUF (MHz) */
+	double psi		/* sun zenith angle at midpoint (rad) */
+	)
+{
+	double height;		/* height of F layer (km) */
+	double absorp;		/* min absorption per reflection */
+	double dhop;		/* hop angle / 2 (rad) */
+	double beta;		/* elevation angle (rad) */
+	double path;		/* path length (km) */
+	double secE;		/* secant of E-layer angle of incidence */
+	double mufF;		/* F-layer MUF (MHz) */
+	double freq;		/* frequency (MHz) */
+	double signal, level;	/* receive power bound (dBm) */
+	double ftemp;		/* double temp */
+	int h, i;
+
+	height = hF;
+	if (90. - psi * R2D < 0)
+		height += 70.;
+	else
+		height -= 30.;
+	absorp = babsorp(pp, p, psi);
+	level = -HUGE_VAL;
+	for (h = p->hop; h < p->hop + 3; h++) {
+		dhop = p->d / (h * 2.);
+		beta = atan((cos(dhop) - R / (R + height)) / sin(dhop));
+		path = 2. * h * sin(dhop) * (R + height) / cos(beta);
+		ftemp = R * cos(beta) / (R + hE);
+		secE = 1. / cos(atan(ftemp / sqrt(1. - ftemp * ftemp)));
+		beta = atan((cos(dhop) - R / (R + hF)) / sin(dhop));
+		ftemp = R * cos(beta) / (R + hF);
+		mufF = muf * cos(p->phiF) / cos(atan(ftemp / sqrt(1. -
+		    ftemp * ftemp)));
+		for (i = 0; i < pp->nfreq; i++) {
+			freq = pp->freq[i];
+			if (freq >= 0.85 * mufF * (1. + 1e-9))
+				continue;
+			signal = pp->dB1 + gmax + 30.;
+			signal -= 32.44 + 20. * log10(path * freq) + SLOSS;
+			signal -= 677.2 * absorp * h * secE / (pow((freq +
+			    GAMMA), 1.98) + 10.2);
+			signal -= h * GLOSS;
+			if (signal > level)
+				level = signal;
+		}
+	}
+	return (level);
+}
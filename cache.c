@@ -0,0 +1,348 @@
+/*
+ * Prediction cache
+ *
+ * When enabled by the -C option, the predictions for each hour are
+ * saved in a cache keyed on the transmitter and receiver coordinates,
+ * month, day, hour, flux, power, minimum elevation angle, frequency
+ * list, antenna table and short/long path, so a path that appears more
+ * than once in the input is computed only once. An entry holds the
+ * prediction and the hour-dependent path state for the three hops that
+ * were considered, which is needed by output format 4.
+ *
+ * The coordinates can be quantized to a grid of the given spacing in
+ * degrees, so nearby sites share entries; the prediction is then that
+ * of the first site to be computed. By default the coordinates must
+ * match exactly. When the cache is full, the least recently used entry
+ * is replaced or, with the fifo policy, the oldest.
+ *
+ * Note that the multipath flag depends on the receive power left over
+ * from the previous hour (see ref.c), so an entry can differ in that
+ * flag from what would be computed at a later point in the input.
+ *
+ * The cache is not shared between threads.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#define NKEY	(12 + FMAX)	/* key words */
+
+/*
+ * Eviction policies (policy)
+ */
+#define C_LRU	0		/* least recently used */
+#define C_FIFO	1		/* first in, first out */
+
+/*
+ * Cache entry
+ */
+struct centry {
+	struct centry *hnext;	/* next entry in hash chain */
+	struct centry *prev;	/* previous entry in use list */
+	struct centry *next;	/* next entry in use list */
+	unsigned long long hash; /* key hash */
+	unsigned long long key[NKEY]; /* key */
+	struct result res;	/* prediction */
+	double lats, lons;	/* subsolar coordinates (rad) */
+	double slats, clats;	/* sine, cosine of subsolar latitude */
+	double psi;		/* sun zenith angle at midpoint (rad) */
+	struct hops hs;		/* path state for hops hop to hop + 2 */
+};
+
+int caching;			/* cache enabled */
+
+static struct centry *entries;	/* entries */
+static struct centry **table;	/* hash table */
+static struct centry head;	/* use list (most recent first) */
+static unsigned long long mask;	/* hash table mask */
+static long size;		/* number of entries */
+static long nused;		/* entries in use */
+static double quantum;		/* coordinate grid (rad) */
+static int policy;		/* eviction policy */
+static long nhit, nmiss, nevict; /* statistics */
+
+/*
+ * Local function declarations
+ */
+static void cmakekey(struct param *, struct path *, double,
+    unsigned long long *);
+static unsigned long long cbits(double);
+static void cunlink(struct centry *);
+static void cfront(struct centry *);
+static void csave(struct centry *, struct path *);
+static void crestore(struct centry *, struct path *);
+static void cprint(void);
+
+/*
+ * cinit(spec) - initialize cache
+ *
+ * The specification is size[,grid[,policy]], where size is the number
+ * of entries, grid is the coordinate grid spacing (deg) and policy is
+ * lru or fifo. Returns 0 if all went well, -1 if not.
+ */
+int
+cinit(
+	char *spec		/* size[,grid[,policy]] */
+	)
+{
+	char name[10];		/* policy name */
+	double grid;		/* grid spacing (deg) */
+	long n;			/* hash table size */
+	int i;			/* int temps */
+
+	grid = 0;
+	strcpy(name, "lru");
+	i = sscanf(spec, "%ld,%lf,%9s", &size, &grid, name);
+	if (i < 1 || size <= 0 || grid < 0) {
+		fprintf(stderr, "minimuf: bad cache %s\n", spec);
+		return (-1);
+	}
+	if (strcmp(name, "lru") == 0) {
+		policy = C_LRU;
+	} else if (strcmp(name, "fifo") == 0) {
+		policy = C_FIFO;
+	} else {
+		fprintf(stderr, "minimuf: bad cache policy %s\n", name);
+		return (-1);
+	}
+	quantum = grid * D2R;
+
+	/*
+	 * The hash table has at least twice as many slots as entries,
+	 * so the chains are short.
+	 */
+	for (n = 1; n < size * 2; n <<= 1)
+		;
+	mask = n - 1;
+	entries = calloc(size, sizeof(struct centry));
+	table = calloc(n, sizeof(struct centry *));
+	if (entries == NULL || table == NULL) {
+		fprintf(stderr, "minimuf: no memory for cache\n");
+		return (-1);
+	}
+	head.next = head.prev = &head;
+	caching = 1;
+	if (stats)
+		atexit(cprint);
+	return (0);
+}
+
+/*
+ * cevaluate(par, p, hour, r) - prediction for one hour, using cache
+ *
+ * The path geometry must have been computed by geometry().
+ */
+void
+cevaluate(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	struct result *r	/* prediction */
+	)
+{
+	unsigned long long key[NKEY]; /* key */
+	unsigned long long hash; /* key hash */
+	struct centry *ep, **epp; /* entry pointers */
+	int i;
+
+	if (!caching) {
+		evaluate(pp, p, hour, r);
+		return;
+	}
+
+	/*
+	 * Look up the key. The hash is FNV-1a on the key words.
+	 */
+	cmakekey(pp, p, hour, key);
+	hash = 14695981039346656037ULL;
+	for (i = 0; i < NKEY; i++)
+		hash = (hash ^ key[i]) * 1099511628211ULL;
+	for (ep = table[hash & mask]; ep != NULL; ep = ep->hnext) {
+		if (ep->hash == hash && memcmp(ep->key, key,
+		    sizeof(key)) == 0)
+			break;
+	}
+	if (ep != NULL) {
+		nhit++;
+		if (policy == C_LRU) {
+			cunlink(ep);
+			cfront(ep);
+		}
+		*r = ep->res;
+		crestore(ep, p);
+		return;
+	}
+
+	/*
+	 * Not found. Compute the prediction and save it in a free
+	 * entry or, if none, the entry at the end of the use list.
+	 */
+	nmiss++;
+	evaluate(pp, p, hour, r);
+	if (nused < size) {
+		ep = &entries[nused++];
+	} else {
+		nevict++;
+		ep = head.prev;
+		cunlink(ep);
+		for (epp = &table[ep->hash & mask]; *epp != ep; epp =
+		    &(*epp)->hnext)
+			;
+		*epp = ep->hnext;
+	}
+	ep->hash = hash;
+	memcpy(ep->key, key, sizeof(key));
+	ep->res = *r;
+	csave(ep, p);
+	ep->hnext = table[hash & mask];
+	table[hash & mask] = ep;
+	cfront(ep);
+}
+
+/*
+ * cflush() - discard all entries
+ *
+ * This must be called when the antenna table changes.
+ */
+void
+cflush(void)
+{
+	if (!caching)
+		return;
+	memset(table, 0, (mask + 1) * sizeof(struct centry *));
+	head.next = head.prev = &head;
+	nused = 0;
+}
+
+/*
+ * cmakekey(par, p, hour, key) - construct key
+ *
+ * Quantized coordinates are grid indices; everything else is the bit
+ * pattern of the value, so the match is exact.
+ */
+static void
+cmakekey(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	unsigned long long *key	/* key */
+	)
+{
+	int i;
+
+	if (quantum > 0) {
+		key[0] = (unsigned long long)llround(p->lat1 / quantum);
+		key[1] = (unsigned long long)llround(p->lon1 / quantum);
+		key[2] = (unsigned long long)llround(p->lat2 / quantum);
+		key[3] = (unsigned long long)llround(p->lon2 / quantum);
+	} else {
+		key[0] = cbits(p->lat1);
+		key[1] = cbits(p->lon1);
+		key[2] = cbits(p->lat2);
+		key[3] = cbits(p->lon2);
+	}
+	key[4] = cbits(pp->month);
+	key[5] = cbits(pp->day);
+	key[6] = cbits(hour);
+	key[7] = cbits(pp->flux);
+	key[8] = cbits(pp->dB1);
+	key[9] = cbits(pp->minbeta);
+	key[10] = pp->options & (H_GAIN | H_LONG);
+	key[11] = pp->nfreq;
+	for (i = 0; i < FMAX; i++)
+		key[12 + i] = i < pp->nfreq ? cbits(pp->freq[i]) : 0;
+}
+
+/*
+ * cbits(x) - bit pattern of double
+ */
+static unsigned long long
+cbits(
+	double x		/* value */
+	)
+{
+	unsigned long long u;
+
+	memcpy(&u, &x, sizeof(u));
+	return (u);
+}
+
+/*
+ * csave(ep, p) - save path state in entry
+ *
+ * Only the hops considered by predict() are saved. The other hops are
+ * left as they are in the path, since format 4 can display a hop left
+ * over from the previous line.
+ */
+static void
+csave(
+	struct centry *ep,	/* entry */
+	struct path *p		/* path state */
+	)
+{
+	ep->lats = p->lats;
+	ep->slats = p->slats;
+	ep->clats = p->clats;
+	ep->lons = p->lons;
+	ep->psi = p->psi;
+	ep->hs = p->hs;
+}
+
+/*
+ * crestore(ep, p) - restore path state from entry
+ */
+static void
+crestore(
+	struct centry *ep,	/* entry */
+	struct path *p		/* path state */
+	)
+{
+	p->lats = ep->lats;
+	p->slats = ep->slats;
+	p->clats = ep->clats;
+	p->lons = ep->lons;
+	p->psi = ep->psi;
+	hopset(p);
+	p->hs = ep->hs;
+}
+
+/*
+ * cunlink(ep) - remove entry from use list
+ */
+static void
+cunlink(
+	struct centry *ep	/* entry */
+	)
+{
+	ep->prev->next = ep->next;
+	ep->next->prev = ep->prev;
+}
+
+/*
+ * cfront(ep) - insert entry at front of use list
+ */
+static void
+cfront(
+	struct centry *ep	/* entry */
+	)
+{
+	ep->next = head.next;
+	ep->prev = &head;
+	head.next->prev = ep;
+	head.next = ep;
+}
+
+/*
+ * cprint() - display cache statistics on stderr
+ */
+static void
+cprint(void)
+{
+	fprintf(stderr,
+	    "cache: %ld entries, %ld used, %ld hits (%.1f%%), %ld misses, %ld evictions\n",
+	    size, nused, nhit, nhit + nmiss > 0 ? nhit * 100. / (nhit +
+	    nmiss) : 0., nmiss, nevict);
+}
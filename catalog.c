@@ -0,0 +1,472 @@
+/*
+ * Station catalog and batch path geometry
+ *
+ * Modes with many paths keep their stations in a catalog, which holds
+ * each quantity in its own array, with the sines and cosines of the
+ * latitude and longitude computed once when the station is added. The
+ * batch kernel catgeom() computes the great-circle distance, both
+ * bearings, min hops, elevation angle, F-layer angle of incidence and
+ * path delay from one transmitter to a run of catalog stations, the
+ * same quantities as pathgeom(), and stores them in a geometry batch,
+ * also one array for each quantity. catpath() copies the results for
+ * one receiver into the path state.
+ *
+ * The loops run over the stations with no dependence between them, so
+ * they can be compiled for SIMD; gcc does this at -O3 with -ffast-math,
+ * using the vector math library for acos(), atan() and the rest, whose
+ * results differ from the scalar ones by roundoff. The kernel uses
+ * cos(theta) = cos(lon1) cos(lon2) + sin(lon1) sin(lon2), which may
+ * differ from the scalar value in the last place.
+ *
+ * The min-hop loop in pathgeom() is replaced by the closed form for the
+ * half-hop distance at which the elevation angle falls to the minimum,
+ * which is acos(k cos(minbeta)) - minbeta with k = R / (R + hF), since
+ * the elevation angle decreases with the hop distance. Where the hop
+ * count is within roundoff of an integer, the loop is run as in
+ * pathgeom(), so the hop count is always the same. The minimum angle
+ * must be between 0 and 90 degrees; otherwise the callers use
+ * pathgeom(), which copes with the original program's treatment of
+ * such angles.
+ *
+ * With the -f option, the kernel runs in single precision, so twice as
+ * many paths fit in each vector and the scratch arrays take half the
+ * space; the path angle, which decides which way round the bearings
+ * go, and the distance, which is displayed, are still computed in
+ * double precision, and the results are stored in the batch in double
+ * precision. The rest is good to a few parts in 1e7, which is all the
+ * prediction needs, except within about 300 km of the transmitter or
+ * its antipode, where acos() loses accuracy. Those paths, and paths
+ * where the hop count is within 1e-4 of an integer or roundoff makes a
+ * bearing NaN, are redone in double precision, so the hop count is
+ * always the same as without -f. The other values displayed, such as
+ * the MUF and delay, can still differ in the last digit where they
+ * fall within roundoff of a rounding boundary.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#define FCHUNK	256		/* paths per single-precision chunk */
+#define FNEAR	1e-4f		/* near-miss margin (float) */
+#define FSHORT	.05f		/* short path distance (float) (rad) */
+
+/*
+ * Local function declarations
+ */
+static void catgeomf(struct param *, struct station *, struct catalog *,
+    int, int, struct gbatch *);
+static int cathop(struct param *, double, double *, double *);
+
+/*
+ * catadd(cat, lat, lon) - add station to catalog
+ *
+ * Returns the station index or -1 if no memory.
+ */
+int
+catadd(
+	struct catalog *cat,	/* catalog */
+	double lat,		/* latitude (rad N) */
+	double lon		/* longitude (rad W) */
+	)
+{
+	double *dp;		/* array block */
+	int size, n;
+
+	if (cat->n == cat->size) {
+		size = cat->size * 2 + 1024;
+		dp = malloc(6 * (size_t)size * sizeof(double));
+		if (dp == NULL) {
+			fprintf(stderr, "minimuf: no memory for catalog\n");
+			return (-1);
+		}
+		if (cat->n > 0) {
+			memcpy(dp, cat->lat, cat->n * sizeof(double));
+			memcpy(dp + size, cat->lon, cat->n * sizeof(double));
+			memcpy(dp + 2 * size, cat->slat, cat->n *
+			    sizeof(double));
+			memcpy(dp + 3 * size, cat->clat, cat->n *
+			    sizeof(double));
+			memcpy(dp + 4 * size, cat->slon, cat->n *
+			    sizeof(double));
+			memcpy(dp + 5 * size, cat->clon, cat->n *
+			    sizeof(double));
+		}
+		free(cat->lat);
+		cat->lat = dp;
+		cat->lon = dp + size;
+		cat->slat = dp + 2 * size;
+		cat->clat = dp + 3 * size;
+		cat->slon = dp + 4 * size;
+		cat->clon = dp + 5 * size;
+		cat->size = size;
+	}
+	n = cat->n++;
+	cat->lat[n] = lat;
+	cat->lon[n] = lon;
+	cat->slat[n] = sin(lat);
+	cat->clat[n] = cos(lat);
+	cat->slon[n] = sin(lon);
+	cat->clon[n] = cos(lon);
+	return (n);
+}
+
+/*
+ * gbinit(gb, size) - allocate geometry batch
+ *
+ * Returns 0 if ok, -1 if no memory.
+ */
+int
+gbinit(
+	struct gbatch *gb,	/* geometry batch */
+	int size		/* max paths */
+	)
+{
+	double *dp;		/* array block */
+
+	dp = malloc(8 * (size_t)size * sizeof(double));
+	gb->hop = malloc(size * sizeof(int));
+	if (dp == NULL || gb->hop == NULL) {
+		fprintf(stderr, "minimuf: no memory for geometry\n");
+		return (-1);
+	}
+	gb->size = size;
+	gb->theta = dp;
+	gb->d = dp + size;
+	gb->b1 = dp + 2 * size;
+	gb->b2 = dp + 3 * size;
+	gb->dhop = dp + 4 * size;
+	gb->beta1 = dp + 5 * size;
+	gb->phiF = dp + 6 * size;
+	gb->delay = dp + 7 * size;
+	return (0);
+}
+
+/*
+ * catgeom(par, tx, cat, j1, n, gb) - batch path geometry
+ *
+ * This computes the geometry of the paths from the transmitter to the
+ * n catalog stations starting at j1 and stores it at the start of the
+ * batch.
+ */
+void
+catgeom(
+	struct param *pp,	/* prediction parameters */
+	struct station *tx,	/* transmitter */
+	struct catalog *cat,	/* receiver catalog */
+	int j1,			/* first receiver */
+	int n,			/* number of receivers */
+	struct gbatch *gb	/* geometry batch */
+	)
+{
+	const double *slat2, *clat2, *slon2, *clon2, *lon2; /* receivers */
+	double *theta, *d, *b1, *b2, *dhop, *beta1, *phiF, *delay;
+	int *hop;
+	double lon1;		/* transmitter longitude (rad W) */
+	double s1, c1, sl1, cl1; /* transmitter sines, cosines */
+	double k;		/* R / (R + hF) */
+	double hmin;		/* half-hop distance for min-hop count */
+	double dmax;		/* half-hop distance at min angle */
+	double x, ftemp;	/* double temps */
+	int longp;		/* long path */
+	int j;
+
+	if (pp->options & H_FLOAT) {
+		catgeomf(pp, tx, cat, j1, n, gb);
+		return;
+	}
+	slat2 = cat->slat + j1;
+	clat2 = cat->clat + j1;
+	slon2 = cat->slon + j1;
+	clon2 = cat->clon + j1;
+	lon2 = cat->lon + j1;
+	theta = gb->theta;
+	d = gb->d;
+	b1 = gb->b1;
+	b2 = gb->b2;
+	dhop = gb->dhop;
+	beta1 = gb->beta1;
+	phiF = gb->phiF;
+	delay = gb->delay;
+	hop = gb->hop;
+	lon1 = tx->lon;
+	s1 = tx->slat;
+	c1 = tx->clat;
+	sl1 = tx->slon;
+	cl1 = tx->clon;
+	k = R / (R + hF);
+	hmin = 2. * acos(k);
+	dmax = acos(k * cos(pp->minbeta)) - pp->minbeta;
+	longp = (pp->options & H_LONG) != 0;
+
+	/*
+	 * Distance and bearings. The sign of the path angle decides
+	 * which way round the bearings go, as in pathgeom(). The sine and
+	 * cosine of the distance are computed in loops of their own and
+	 * saved in the bearing arrays, since gcc combines the two in one
+	 * loop into a call to sincos(), which has no vector version.
+	 */
+	for (j = 0; j < n; j++) {
+		ftemp = lon1 - lon2[j];
+		ftemp -= ftemp >= PI ? PID : 0;
+		ftemp += ftemp <= -PI ? PID : 0;
+		theta[j] = ftemp;
+	}
+	for (j = 0; j < n; j++) {
+		d[j] = acos(s1 * slat2[j] + c1 * clat2[j] * (cl1 * clon2[j] +
+		    sl1 * slon2[j]));
+	}
+	for (j = 0; j < n; j++)
+		b1[j] = cos(d[j]);
+	for (j = 0; j < n; j++)
+		b2[j] = sin(d[j]);
+	for (j = 0; j < n; j++) {
+		x = acos((slat2[j] - s1 * b1[j]) / (c1 * b2[j]));
+		b2[j] = acos((s1 - slat2[j] * b1[j]) / (clat2[j] * b2[j]));
+		b1[j] = theta[j] < 0 ? PID - x : x;
+		b2[j] = theta[j] >= 0 ? PID - b2[j] : b2[j];
+	}
+	if (longp) {
+		for (j = 0; j < n; j++) {
+			d[j] = PID - d[j];
+			b1[j] += PI;
+			b1[j] -= b1[j] >= PID ? PID : 0;
+			b2[j] += PI;
+			b2[j] -= b2[j] >= PID ? PID : 0;
+		}
+	}
+
+	/*
+	 * Min hops from the closed form, then the elevation angle, angle
+	 * of incidence and delay for the min-hop path. The cosine and
+	 * sine of the hop distance are saved in the angle of incidence and
+	 * delay arrays.
+	 */
+	for (j = 0; j < n; j++) {
+		x = ceil(d[j] / (2. * dmax));
+		ftemp = floor(d[j] / hmin) + 1.;
+		hop[j] = (int)(x > ftemp ? x : ftemp);
+		dhop[j] = d[j] / (hop[j] * 2.);
+	}
+	for (j = 0; j < n; j++)
+		phiF[j] = cos(dhop[j]);
+	for (j = 0; j < n; j++)
+		delay[j] = sin(dhop[j]);
+	for (j = 0; j < n; j++) {
+		beta1[j] = atan((phiF[j] - k) / delay[j]);
+		x = cos(beta1[j]);
+		ftemp = R * x / (R + hF);
+		phiF[j] = atan(ftemp / sqrt(1. - ftemp * ftemp));
+		delay[j] = 2. * hop[j] * delay[j] * (R + hF) / x / VOFL * 1e6;
+	}
+
+	/*
+	 * Redo the near misses one at a time.
+	 */
+	for (j = 0; j < n; j++) {
+		x = d[j] / (2. * dmax);
+		if (!(d[j] >= 0) || fabs(x - floor(x + .5)) < 1e-9 * (x + 1.)) {
+			hop[j] = cathop(pp, d[j], &dhop[j], &beta1[j]);
+			ftemp = R * cos(beta1[j]) / (R + hF);
+			phiF[j] = atan(ftemp / sqrt(1. - ftemp * ftemp));
+			delay[j] = 2. * hop[j] * sin(dhop[j]) * (R + hF) /
+			    cos(beta1[j]) / VOFL * 1e6;
+		}
+	}
+}
+
+/*
+ * catgeomf(par, tx, cat, j1, n, gb) - batch path geometry in single
+ * precision
+ *
+ * This is catgeom() with float arithmetic, a chunk of FCHUNK paths at a
+ * time. The near misses are redone by catgeom() on a batch of one path.
+ */
+static void
+catgeomf(
+	struct param *pp,	/* prediction parameters */
+	struct station *tx,	/* transmitter */
+	struct catalog *cat,	/* receiver catalog */
+	int j1,			/* first receiver */
+	int n,			/* number of receivers */
+	struct gbatch *gb	/* geometry batch */
+	)
+{
+	float slat2[FCHUNK], clat2[FCHUNK]; /* receiver sine, cosine of lat */
+	float d[FCHUNK];	/* great-circle distance (rad) */
+	float b1[FCHUNK], b2[FCHUNK]; /* transmitter/receiver bearing (rad) */
+	float dhop[FCHUNK];	/* hop great-circle distance (rad) */
+	float beta1[FCHUNK];	/* min-hop elevation angle (rad) */
+	float phiF[FCHUNK];	/* F-layer angle of incidence (rad) */
+	float delay[FCHUNK];	/* path delay (ms) */
+	struct param pd;	/* parameters for near misses */
+	struct gbatch g1;	/* batch of one path */
+	double *theta;		/* path angle (rad) */
+	double *dd;		/* great-circle distance (rad) */
+	int *hop;		/* number of ray hops */
+	double ftemp;		/* double temp */
+	float s1, c1;		/* transmitter sine, cosine of lat */
+	float k;		/* R / (R + hF) */
+	float hmin;		/* half-hop distance for min-hop count */
+	float dmax;		/* half-hop distance at min angle */
+	float x, y;		/* float temps */
+	int longp;		/* long path */
+	int j0, m, j;
+
+	pd = *pp;
+	pd.options &= ~H_FLOAT;
+	s1 = tx->slat;
+	c1 = tx->clat;
+	k = R / (R + hF);
+	hmin = 2. * acos(R / (R + hF));
+	dmax = acos(R / (R + hF) * cos(pp->minbeta)) - pp->minbeta;
+	longp = (pp->options & H_LONG) != 0;
+	for (j0 = 0; j0 < n; j0 += FCHUNK) {
+		m = n - j0 < FCHUNK ? n - j0 : FCHUNK;
+		theta = gb->theta + j0;
+		hop = gb->hop + j0;
+
+		/*
+		 * Path angle and distance in double precision, then
+		 * bearings as in catgeom().
+		 */
+		dd = gb->d + j0;
+		for (j = 0; j < m; j++) {
+			ftemp = tx->lon - cat->lon[j1 + j0 + j];
+			ftemp -= ftemp >= PI ? PID : 0;
+			ftemp += ftemp <= -PI ? PID : 0;
+			theta[j] = ftemp;
+		}
+		for (j = 0; j < m; j++) {
+			dd[j] = acos(tx->slat * cat->slat[j1 + j0 + j] +
+			    tx->clat * cat->clat[j1 + j0 + j] * (tx->clon *
+			    cat->clon[j1 + j0 + j] + tx->slon *
+			    cat->slon[j1 + j0 + j]));
+		}
+		for (j = 0; j < m; j++) {
+			slat2[j] = cat->slat[j1 + j0 + j];
+			clat2[j] = cat->clat[j1 + j0 + j];
+			d[j] = dd[j];
+		}
+		for (j = 0; j < m; j++)
+			b1[j] = cosf(d[j]);
+		for (j = 0; j < m; j++)
+			b2[j] = sinf(d[j]);
+		for (j = 0; j < m; j++) {
+			x = acosf((slat2[j] - s1 * b1[j]) / (c1 * b2[j]));
+			b2[j] = acosf((s1 - slat2[j] * b1[j]) / (clat2[j] *
+			    b2[j]));
+			b1[j] = theta[j] < 0 ? (float)PID - x : x;
+			b2[j] = theta[j] >= 0 ? (float)PID - b2[j] : b2[j];
+		}
+		if (longp) {
+			for (j = 0; j < m; j++) {
+				dd[j] = PID - dd[j];
+				d[j] = dd[j];
+				b1[j] += (float)PI;
+				b1[j] -= b1[j] >= (float)PID ? (float)PID : 0;
+				b2[j] += (float)PI;
+				b2[j] -= b2[j] >= (float)PID ? (float)PID : 0;
+			}
+		}
+
+		/*
+		 * Min hops, elevation angle, angle of incidence and delay
+		 */
+		for (j = 0; j < m; j++) {
+			x = ceilf(d[j] / (2.f * dmax));
+			y = floorf(d[j] / hmin) + 1.f;
+			hop[j] = (int)(x > y ? x : y);
+			dhop[j] = d[j] / (hop[j] * 2.f);
+		}
+		for (j = 0; j < m; j++)
+			phiF[j] = cosf(dhop[j]);
+		for (j = 0; j < m; j++)
+			delay[j] = sinf(dhop[j]);
+		for (j = 0; j < m; j++) {
+			beta1[j] = atanf((phiF[j] - k) / delay[j]);
+			x = cosf(beta1[j]);
+			y = (float)(R / (R + hF)) * x;
+			phiF[j] = atanf(y / sqrtf(1.f - y * y));
+			delay[j] = 2.f * hop[j] * delay[j] * (float)(R + hF) /
+			    x / (float)(VOFL / 1e6);
+		}
+		for (j = 0; j < m; j++) {
+			gb->b1[j0 + j] = b1[j];
+			gb->b2[j0 + j] = b2[j];
+			gb->dhop[j0 + j] = dhop[j];
+			gb->beta1[j0 + j] = beta1[j];
+			gb->phiF[j0 + j] = phiF[j];
+			gb->delay[j0 + j] = delay[j];
+		}
+
+		/*
+		 * Redo the near misses in double precision.
+		 */
+		for (j = 0; j < m; j++) {
+			x = d[j] / (2.f * dmax);
+			y = longp ? (float)PID - d[j] : d[j];
+			if (d[j] >= 0 && b1[j] == b1[j] && b2[j] == b2[j] &&
+			    fabsf(x - floorf(x + .5f)) >= FNEAR * (x + 1.f) &&
+			    y >= FSHORT && y <= (float)PI - FSHORT)
+				continue;
+			g1.size = 1;
+			g1.theta = gb->theta + j0 + j;
+			g1.d = gb->d + j0 + j;
+			g1.b1 = gb->b1 + j0 + j;
+			g1.b2 = gb->b2 + j0 + j;
+			g1.dhop = gb->dhop + j0 + j;
+			g1.beta1 = gb->beta1 + j0 + j;
+			g1.phiF = gb->phiF + j0 + j;
+			g1.delay = gb->delay + j0 + j;
+			g1.hop = gb->hop + j0 + j;
+			catgeom(&pd, tx, cat, j1 + j0 + j, 1, &g1);
+		}
+	}
+}
+
+/*
+ * cathop(par, d, dhop, beta1) - min hops as in pathgeom()
+ */
+static int
+cathop(
+	struct param *pp,	/* prediction parameters */
+	double d,		/* great-circle distance (rad) */
+	double *dhop,		/* hop great-circle distance (rad) */
+	double *beta1		/* min-hop elevation angle (rad) */
+	)
+{
+	int hop;
+
+	hop = (int)(d / (2. * acos(R / (R + hF))));
+	*beta1 = 0.;
+	while (*beta1 < pp->minbeta) {
+		hop++;
+		*dhop = d / (hop * 2.);
+		*beta1 = atan((cos(*dhop) - R / (R + hF)) / sin(*dhop));
+	}
+	return (hop);
+}
+
+/*
+ * catpath(gb, j, p) - copy batch geometry to path state
+ */
+void
+catpath(
+	struct gbatch *gb,	/* geometry batch */
+	int j,			/* path index */
+	struct path *p		/* path state */
+	)
+{
+	p->theta = gb->theta[j];
+	p->d = gb->d[j];
+	p->b1 = gb->b1[j];
+	p->b2 = gb->b2[j];
+	p->dhop = gb->dhop[j];
+	p->beta1 = gb->beta1[j];
+	p->phiF = gb->phiF[j];
+	p->delay = gb->delay[j];
+	p->hop = gb->hop[j];
+}
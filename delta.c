@@ -0,0 +1,325 @@
+/*
+ * Delta output against the previous run
+ *
+ * When enabled by the -D option, the program computes the prediction
+ * tables as usual but displays only what changed since the previous
+ * run: for each receiver and hour, the MUF if it moved by at least the
+ * MUF threshold, and each frequency whose hop number or flags changed
+ * or whose receive power moved by at least the power threshold. The
+ * results are kept in a binary file named on the command line, which
+ * is read at the start of the run and written again at the end, so the
+ * next run is compared with this one. A run with no file, or with a
+ * file for other frequencies or hours, displays every cell.
+ *
+ * The file holds what has been displayed, not what was computed: a
+ * value that has not moved by the threshold keeps its old value, so
+ * small changes from run to run cannot add up unseen. The file is a
+ * header followed by one fixed-size record for each receiver, in the
+ * byte order of the host. The receivers are matched by position in the
+ * input data; a receiver whose coordinates differ from those in the
+ * record is displayed in full, as are receivers beyond the end of the
+ * file.
+ *
+ * Each changed receiver is displayed with its coordinates and name,
+ * then one line for each change, which gives the hour, the MUF or the
+ * frequency, the new value and the old value. A cell is displayed as
+ * in the best time search, with the receive power (dBm above threshold)
+ * followed by the day/night flag, hop number and multipath or
+ * sensitivity flag, or a dash if no path is usable.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#ifndef _WIN32
+
+#define DMAGIC	"MMUFDLT1"	/* file magic */
+
+/*
+ * File header
+ */
+struct dxhdr {
+	char magic[8];		/* file magic */
+	int nfreq;		/* number of frequencies */
+	int h1, h2;		/* first, last hour */
+	double freq[FMAX];	/* frequencies (MHz) */
+};
+
+/*
+ * Results for one hour as displayed
+ */
+struct dxhour {
+	double muf;		/* MUF (MHz) */
+	double dB[FMAX];	/* receive power (dBm above threshold) */
+	char hop[FMAX];		/* hop number (0 if no path) */
+	char flags[FMAX];	/* path flags */
+};
+
+/*
+ * Receiver record
+ */
+struct dxrec {
+	double lat, lon;	/* coordinates (deg N/E) */
+	struct dxhour hr[24];	/* hours */
+};
+
+static long nrx;		/* receivers */
+static long nnew;		/* receivers not in file */
+static long ncell;		/* cells */
+static long nchange;		/* cells changed */
+static long nmuf;		/* MUF values changed */
+
+/*
+ * Local function declarations
+ */
+static void dxhead(struct obuf *, struct site *, int);
+static void dxcell(struct obuf *, double, int, int);
+static void dxstats(void);
+
+/*
+ * delta(par, ip, tx, file, h1, h2, ob) - delta output mode
+ *
+ * The file name may be followed by the power threshold (dB) and the MUF
+ * threshold (MHz), separated by commas. The input data have been read
+ * up to and including the transmitter. Returns the program exit status.
+ */
+int
+delta(
+	struct param *pp,	/* prediction parameters */
+	struct input *ip,	/* input data */
+	struct site *tx,	/* transmitter in input data */
+	char *arg,		/* file name and thresholds */
+	int h1,			/* first hour */
+	int h2,			/* last hour */
+	struct obuf *ob		/* output buffer */
+	)
+{
+	struct station txs, rxs; /* transmitter, receiver */
+	struct site site;	/* receiver site */
+	struct path path;	/* path state */
+	struct result res;	/* prediction for one hour */
+	struct dxhdr hdr, old;	/* file headers */
+	struct dxrec rec, prev;	/* receiver records */
+	struct dxhour *hp, *op;	/* hour records */
+	struct cell *cp;	/* path descriptor */
+	FILE *fin, *fout;	/* previous, new file */
+	char file[256], tmp[270]; /* file names */
+	double dBtol, muftol;	/* thresholds (dB, MHz) */
+	double dB;		/* receive power (dBm above threshold) */
+	int have;		/* previous record matches */
+	int shown;		/* receiver displayed */
+	int i, h, rval;		/* int temps */
+
+	dBtol = 1.;
+	muftol = .1;
+	file[0] = '\0';
+	sscanf(arg, "%255[^,],%lf,%lf", file, &dBtol, &muftol);
+	if (file[0] == '\0' || h1 < 0 || h2 > 23) {
+		fprintf(stderr, "minimuf: bad delta file %s\n", arg);
+		return (1);
+	}
+	sprintf(tmp, "%s.tmp", file);
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, DMAGIC, sizeof(hdr.magic));
+	hdr.nfreq = pp->nfreq;
+	hdr.h1 = h1;
+	hdr.h2 = h2;
+	for (i = 0; i < pp->nfreq; i++)
+		hdr.freq[i] = pp->freq[i];
+
+	/*
+	 * The previous file is used only if it is for the same
+	 * frequencies and hours.
+	 */
+	fin = fopen(file, "r");
+	if (fin != NULL && (fread(&old, sizeof(old), 1, fin) != 1 ||
+	    memcmp(&old, &hdr, sizeof(hdr)) != 0)) {
+		fprintf(stderr, "minimuf: %s is for other data, ignored\n",
+		    file);
+		fclose(fin);
+		fin = NULL;
+	}
+	fout = fopen(tmp, "w");
+	if (fout == NULL || fwrite(&hdr, sizeof(hdr), 1, fout) != 1) {
+		fprintf(stderr, "minimuf: cannot write %s\n", tmp);
+		return (1);
+	}
+	if (stats)
+		atexit(dxstats);
+	instation(&txs, tx);
+	obprintf(ob, "10-cm solar flux:%4.0lf   SN:%4.0lf   Month:%3.0lf   Day:%3.0lf   Power:%3.0f dBW\n",
+	    pp->flux, pp->ssn, pp->month, pp->day, pp->dB1);
+
+	/*
+	 * Receiver loop. The path state carries over from one receiver
+	 * to the next, as in the prediction tables.
+	 */
+	memset(&path, 0, sizeof(path));
+	memset(&rec, 0, sizeof(rec));
+	memset(&prev, 0, sizeof(prev));
+	while ((rval = insite(ip, &site)) > 0) {
+		nrx++;
+		instation(&rxs, &site);
+		path.lat1 = txs.lat;
+		path.lon1 = txs.lon;
+		path.lat2 = rxs.lat;
+		path.lon2 = rxs.lon;
+		TSTART(ST_GEOM);
+		geometry(pp, &path);
+		TSTOP(ST_GEOM);
+		rec.lat = site.lat;
+		rec.lon = site.lon;
+		have = 0;
+		if (fin != NULL) {
+			if (fread(&prev, sizeof(prev), 1, fin) == 1)
+				have = prev.lat == rec.lat && prev.lon ==
+				    rec.lon;
+			else {
+				fclose(fin);
+				fin = NULL;
+			}
+		}
+		if (!have)
+			nnew++;
+
+		/*
+		 * Hour loop. Compare each value with the one displayed
+		 * last and display the changes.
+		 */
+		shown = 0;
+		for (h = h1; h <= h2; h++) {
+			cevaluate(pp, &path, h, &res);
+			hp = &rec.hr[h];
+			op = &prev.hr[h];
+			*hp = *op;
+			TSTART(ST_OUT);
+			if (!have || fabs(res.muf - op->muf) >= muftol) {
+				if (!shown++)
+					dxhead(ob, &site, have);
+				nmuf++;
+				hp->muf = res.muf;
+				obint(ob, h, 2);
+				obputs(ob, "   MUF");
+				obfix(ob, res.muf, 7, 1);
+				if (have) {
+					obputs(ob, "      was");
+					obfix(ob, op->muf, 7, 1);
+				}
+				obputc(ob, '\n');
+			}
+			for (i = 0; i < pp->nfreq; i++) {
+				ncell++;
+				cp = &res.f[i];
+				dB = cp->dB2 - RSENS;
+				if (have && cp->hop == op->hop[i] &&
+				    (cp->hop == 0 || (cp->flags ==
+				    op->flags[i] && fabs(dB - op->dB[i]) <
+				    dBtol)))
+					continue;
+				if (!shown++)
+					dxhead(ob, &site, have);
+				nchange++;
+				hp->dB[i] = cp->hop != 0 ? dB : 0.;
+				hp->hop[i] = cp->hop;
+				hp->flags[i] = cp->hop != 0 ? cp->flags : 0;
+				obint(ob, h, 2);
+				obfix(ob, pp->freq[i], 9, 3);
+				dxcell(ob, hp->dB[i], hp->hop[i],
+				    hp->flags[i]);
+				if (have) {
+					obputs(ob, "  was");
+					dxcell(ob, op->dB[i], op->hop[i],
+					    op->flags[i]);
+				}
+				obputc(ob, '\n');
+			}
+			TSTOP(ST_OUT);
+		}
+		if (fwrite(&rec, sizeof(rec), 1, fout) != 1) {
+			fprintf(stderr, "minimuf: cannot write %s\n", tmp);
+			return (1);
+		}
+	}
+	if (fin != NULL)
+		fclose(fin);
+
+	/*
+	 * Replace the previous file only if the run is complete.
+	 */
+	if (fclose(fout) != 0 || (rval == 0 && rename(tmp, file) != 0)) {
+		fprintf(stderr, "minimuf: cannot write %s\n", file);
+		return (1);
+	}
+	if (obflush(ob) < 0)
+		return (1);
+	return (rval < 0);
+}
+
+/*
+ * dxhead(ob, sp, have) - display receiver
+ */
+static void
+dxhead(
+	struct obuf *ob,	/* output buffer */
+	struct site *sp,	/* receiver site */
+	int have		/* receiver in file */
+	)
+{
+	obprintf(ob, "\nReceiver");
+	obfix(ob, sp->lat, 8, 2);
+	obputs(ob, "N ");
+	obfix(ob, -sp->lon, 7, 2);
+	obputs(ob, "W ");
+	obname(ob, sp->name, sp->namelen, 0);
+	obputs(ob, have ? "\n" : " (new)\n");
+}
+
+/*
+ * dxcell(ob, dB, hop, flags) - display cell
+ */
+static void
+dxcell(
+	struct obuf *ob,	/* output buffer */
+	double dB,		/* receive power (dBm above threshold) */
+	int hop,		/* hop number (0 if no path) */
+	int flags		/* path flags */
+	)
+{
+	char c1, c2;		/* path flags */
+
+	if (hop == 0) {
+		obputs(ob, "      -   ");
+		return;
+	}
+	if (flags & P_J && flags & P_N)
+		c1 = 'x';
+	else if (flags & P_J)
+		c1 = 'j';
+	else
+		c1 = 'n';
+	if (flags & P_S)
+		c2 = 's';
+	else if (flags & P_M)
+		c2 = 'm';
+	else
+		c2 = ' ';
+	obfix(ob, dB, 7, 0);
+	obputc(ob, c1);
+	obint(ob, hop, 1);
+	obputc(ob, c2);
+}
+
+/*
+ * dxstats() - display delta statistics on stderr
+ */
+static void
+dxstats(void)
+{
+	fprintf(stderr,
+	    "delta: %ld receivers, %ld not in file, %ld cells, %ld changed, %ld MUF values changed\n",
+	    nrx, nnew, ncell, nchange, nmuf);
+}
+#endif /* _WIN32 */
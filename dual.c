@@ -0,0 +1,183 @@
+/*
+ * Short and long path together
+ *
+ * When enabled by the -L option, the program predicts the short and
+ * long paths to each receiver in the same pass and displays for each
+ * hour and frequency which path gives the larger receive power and by
+ * how much. The two paths have the same endpoints, so the MINIMUF value
+ * for each hour, which is also the MUF of both, and the subsolar point
+ * are computed once and shared; only the hop geometry, ionospheric
+ * reflection and path loss are computed for each path.
+ *
+ * The sun zenith angle column of the normal tables is for the midpoint
+ * of the path, which differs between the short and long paths, so both
+ * are shown, short first, as the sun elevation in degrees.
+ *
+ * Each frequency column shows S or L for the winning path, the margin
+ * (dB) over the other path, or a dash if the other path is unusable,
+ * and the receive power (dBm above threshold), day/night flag, hop
+ * number and multipath or sensitivity flag of the winning path, as in
+ * output format 1. The column is blank if neither path is usable.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#ifndef _WIN32
+
+/*
+ * Local function declarations
+ */
+static void dcell(struct obuf *, struct cell *, struct cell *);
+
+/*
+ * dual(par, ip, tx, h1, h2, ob) - short and long path mode
+ *
+ * The input data have been read up to and including the transmitter.
+ * Returns the program exit status.
+ */
+int
+dual(
+	struct param *pp,	/* prediction parameters */
+	struct input *ip,	/* input data */
+	struct site *tx,	/* transmitter in input data */
+	int h1,			/* first hour */
+	int h2,			/* last hour */
+	struct obuf *ob		/* output buffer */
+	)
+{
+	struct param ps, pl;	/* short, long path parameters */
+	struct station txs, rxs; /* transmitter, receiver */
+	struct site site;	/* receiver site */
+	struct path sp, lp;	/* short, long path state */
+	struct result sr, lr;	/* short, long path predictions */
+	double muf;		/* MINIMUF (MHz) */
+	double offset;		/* offset for local time (hours) */
+	double time;		/* time of day (hour) */
+	int i, h, rval;		/* int temps */
+
+	ps = pl = *pp;
+	ps.options &= ~H_LONG;
+	pl.options |= H_LONG;
+	instation(&txs, tx);
+	memset(&sp, 0, sizeof(sp));
+	memset(&lp, 0, sizeof(lp));
+	while ((rval = insite(ip, &site)) > 0) {
+		instation(&rxs, &site);
+		sp.lat1 = lp.lat1 = txs.lat;
+		sp.lon1 = lp.lon1 = txs.lon;
+		sp.lat2 = lp.lat2 = rxs.lat;
+		sp.lon2 = lp.lon2 = rxs.lon;
+		TSTART(ST_GEOM);
+		pathgeom(&ps, &sp, txs.slat, txs.clat, rxs.slat, rxs.clat);
+		pathgeom(&pl, &lp, txs.slat, txs.clat, rxs.slat, rxs.clat);
+		TSTOP(ST_GEOM);
+
+		TSTART(ST_OUT);
+		obprintf(ob, "\n10-cm solar flux:%4.0lf   SN:%4.0lf   Month:%3.0lf   Day:%3.0lf\n",
+		    pp->flux, pp->ssn, pp->month, pp->day);
+		obprintf(ob, "Power:%3.0f dBW    Distance:%6.0f km short%7.0f km long\n",
+		    pp->dB1, sp.d * R, lp.d * R);
+		obputs(ob, "Location                        Lat      Long    Azim  Long\n");
+		obname(ob, tx->name, tx->namelen, 27);
+		obprintf(ob, " %7.2fN  %7.2fW    %3.0f   %3.0f\n",
+		    sp.lat1 * R2D, sp.lon1 * R2D, sp.b1 * R2D, lp.b1 * R2D);
+		obname(ob, site.name, site.namelen, 27);
+		obprintf(ob, " %7.2fN  %7.2fW    %3.0f   %3.0f\n",
+		    sp.lat2 * R2D, sp.lon2 * R2D, sp.b2 * R2D, lp.b2 * R2D);
+		obputs(ob, "UT LT  MUF ZenS ZenL");
+		for (i = 0; i < pp->nfreq; i++)
+			obfix(ob, pp->freq[i], 12, 1);
+		obputc(ob, '\n');
+		TSTOP(ST_OUT);
+
+		/*
+		 * Hour loop
+		 */
+		offset = (sp.lon2 * 24. / PID);
+		for (h = h1; h <= h2; h++) {
+			TSTART(ST_MUF);
+			muf = minimuf(pp->flux, pp->month, pp->day, h,
+			    sp.lat1, sp.lon1, sp.lat2, sp.lon2);
+			TSTOP(ST_MUF);
+			subsolar(pp, &sp, h);
+			lp.lats = sp.lats;
+			lp.slats = sp.slats;
+			lp.clats = sp.clats;
+			lp.lons = sp.lons;
+			evalsun(&ps, &sp, h, muf, &sr);
+			evalsun(&pl, &lp, h, muf, &lr);
+			time = h - offset;
+			if (time < 0.)
+				time += 24.;
+			if (time >= 24.)
+				time -= 24.;
+			TSTART(ST_OUT);
+			obint(ob, h, 2);
+			obputc(ob, ' ');
+			obfix(ob, time, 2, 0);
+			obfix(ob, muf, 5, 1);
+			obfix(ob, 90. - sr.psi * R2D, 5, 0);
+			obfix(ob, 90. - lr.psi * R2D, 5, 0);
+			for (i = 0; i < pp->nfreq; i++)
+				dcell(ob, &sr.f[i], &lr.f[i]);
+			obputc(ob, '\n');
+			TSTOP(ST_OUT);
+		}
+	}
+	if (obflush(ob) < 0)
+		return (1);
+	return (rval < 0);
+}
+
+/*
+ * dcell(ob, sc, lc) - display winning path for one frequency
+ */
+static void
+dcell(
+	struct obuf *ob,	/* output buffer */
+	struct cell *sc,	/* short path descriptor */
+	struct cell *lc		/* long path descriptor */
+	)
+{
+	struct cell *cp, *op;	/* winner, other */
+	char c1, c2;		/* path flags */
+
+	if (sc->hop == 0 && lc->hop == 0) {
+		obputs(ob, "            ");
+		return;
+	}
+	if (lc->hop == 0 || (sc->hop != 0 && sc->dB2 >= lc->dB2)) {
+		cp = sc;
+		op = lc;
+		obputs(ob, " S");
+	} else {
+		cp = lc;
+		op = sc;
+		obputs(ob, " L");
+	}
+	if (op->hop == 0)
+		obputs(ob, "  -");
+	else
+		obfix(ob, cp->dB2 - op->dB2, 3, 0);
+	if (cp->flags & P_J && cp->flags & P_N)
+		c1 = 'x';
+	else if (cp->flags & P_J)
+		c1 = 'j';
+	else
+		c1 = 'n';
+	if (cp->flags & P_S)
+		c2 = 's';
+	else if (cp->flags & P_M)
+		c2 = 'm';
+	else
+		c2 = ' ';
+	obfix(ob, cp->dB2 - RSENS, 4, 0);
+	obputc(ob, c1);
+	obint(ob, cp->hop, 1);
+	obputc(ob, c2);
+}
+#endif /* _WIN32 */
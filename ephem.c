@@ -0,0 +1,94 @@
+/*
+ * Solar ephemeris table
+ *
+ * The subsolar latitude computed by subsolar() and the seasonal terms
+ * of MINIMUF 3.5, the solar declination y2 = .409 cos(y1) with its sine
+ * and cosine and the equation-of-time term .13 (sin(y1) + 1.2 sin(2 y1)),
+ * depend only on the date. MINIMUF evaluates the sine and cosine of y2
+ * at every point along the path, and the sun zenith angle at each
+ * reflection zone needs the sine and cosine of the subsolar latitude.
+ * These are computed once by ephinit() for each month and day and kept
+ * in a table of 372 entries, which fits in the cache, so the hour loop
+ * looks them up instead. The entries are computed with the same
+ * expressions as before, so the results are the same to the last bit.
+ *
+ * A date with a fractional month or day, or one out of range, is not in
+ * the table and is computed when needed. The subsolar longitude depends
+ * only on the hour and needs no trigonometry, so it is not tabulated.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+static struct ephem etab[12][31]; /* table by month and day */
+static int eready;		/* table is ready */
+
+/*
+ * Local function declarations
+ */
+static void ephcalc(double, double, struct ephem *);
+
+/*
+ * ephinit() - compute ephemeris table
+ */
+void
+ephinit(void)
+{
+	int i, j;
+
+	for (i = 0; i < 12; i++) {
+		for (j = 0; j < 31; j++)
+			ephcalc(i + 1., j + 1., &etab[i][j]);
+	}
+	eready = 1;
+}
+
+/*
+ * ephem(month, day, ep) - look up ephemeris for date
+ *
+ * Returns the table entry for the date or, if there is none, ep with
+ * the ephemeris computed for the date.
+ */
+struct ephem *
+ephem(
+	double month,		/* month of year (1 - 12) */
+	double day,		/* day of month (1 - 31) */
+	struct ephem *ep	/* ephemeris if not in table */
+	)
+{
+	int m, d;
+
+	m = (int)month;
+	d = (int)day;
+	if (eready && m >= 1 && m <= 12 && d >= 1 && d <= 31 && m == month &&
+	    d == day)
+		return (&etab[m - 1][d - 1]);
+	ephcalc(month, day, ep);
+	return (ep);
+}
+
+/*
+ * ephcalc(month, day, ep) - compute ephemeris for date
+ */
+static void
+ephcalc(
+	double month,		/* month of year (1 - 12) */
+	double day,		/* day of month (1 - 31) */
+	struct ephem *ep	/* ephemeris */
+	)
+{
+	double y1;		/* MINIMUF day angle */
+	double ftemp;		/* double temp */
+
+	ftemp = (month - 1.) * 365.25 / 12. + day - 80.;
+	ep->lats = 23.5 * D2R * sin(ftemp / 365.25 * PID);
+	ep->slats = sin(ep->lats);
+	ep->clats = cos(ep->lats);
+	y1 = .0172 * (10. + (month - 1.) * 30.4 + day);
+	ep->y2 = .409 * cos(y1);
+	ep->sy2 = sin(ep->y2);
+	ep->cy2 = cos(ep->y2);
+	ep->eot = .13 * (sin(y1) + 1.2 * sin(2. * y1));
+}
@@ -0,0 +1,349 @@
+/*
+ * Binary startup image
+ *
+ * A large receiver list takes most of the startup time of a run to
+ * parse, and it is parsed again by every run. The -c option writes the
+ * input data as parsed, with the antenna gain table if there is one, to
+ * a binary image file; given as the input file of a later run, the
+ * image is mapped into memory and used in place of the text, with
+ * nothing to parse or convert.
+ *
+ * The image is a header, which holds the output format, date, flux,
+ * power, frequencies and antenna table, followed by the sites, the
+ * transmitter first. For each site it holds the coordinates as read,
+ * the coordinates in radians with their sines and cosines as in the
+ * station catalog, the input line number and the name. The values in
+ * the header are those in effect when the image was written, including
+ * any command-line modifiers; modifiers and an antenna file given with
+ * the image override them as they do the input data. All numbers are
+ * in the byte order of the host, so the image is not portable.
+ *
+ * The receivers are served by insite() from the image, so every mode
+ * works with an image as with the text. The main program also uses the
+ * catalog in the image for the batch path geometry, so the sines and
+ * cosines of the receiver coordinates are not computed again.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#define IMAGIC	"MMUFIMG1"	/* file magic, with version */
+
+/*
+ * File header
+ */
+struct imhdr {
+	char magic[8];		/* file magic */
+	int flag;		/* output format */
+	int nfreq;		/* number of frequencies */
+	int nsite;		/* number of sites */
+	int gain;		/* antenna gain table present */
+	double month;		/* month of year (1 - 12) */
+	double day;		/* day of month (1 - 31) */
+	double flux;		/* 10-cm solar flux */
+	double dB1;		/* transmitter output power (dBW) */
+	double freq[FMAX];	/* frequencies (MHz) */
+	struct antenna ant;	/* antenna gain table (if gain) */
+	size_t nname;		/* length of names */
+};
+
+/*
+ * Image size for n sites with nname bytes of names. Each site has two
+ * coordinates as read, six catalog values, a line number and a name
+ * offset, and there is one more name offset at the end.
+ */
+#define ISIZE(n, nname)	(sizeof(struct imhdr) + (size_t)(n) * (8 * \
+	sizeof(double) + 2 * sizeof(int)) + sizeof(int) + (nname))
+
+static struct image image;	/* mapped image */
+
+/*
+ * imbuild(par, ip, tx, flag, file) - write image
+ *
+ * The input data have been read up to and including the transmitter.
+ * Returns the program exit status.
+ */
+int
+imbuild(
+	struct param *pp,	/* prediction parameters */
+	struct input *ip,	/* input data */
+	struct site *tx,	/* transmitter in input data */
+	int flag,		/* output format */
+	char *file		/* image file */
+	)
+{
+	struct imhdr hdr;	/* file header */
+	struct site site;	/* site */
+	struct catalog cat;	/* coordinates and trig */
+	double *lat, *lon;	/* coordinates as read (deg N/E) */
+	int *line, *name;	/* line numbers, name offsets */
+	char *names;		/* names */
+	size_t nname, maxname;	/* length of names, allocated */
+	FILE *fout;		/* new file */
+	char tmp[270];		/* temporary file name */
+	int n, maxsite;		/* sites, allocated */
+	int i, rval;
+
+	if (strlen(file) > 255) {
+		fprintf(stderr, "minimuf: bad image file %s\n", file);
+		return (1);
+	}
+	if (flag < 0 || flag > 4) {
+		fprintf(stderr, "minimuf: bad output format %d\n", flag);
+		return (1);
+	}
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, IMAGIC, sizeof(hdr.magic));
+	hdr.flag = flag;
+	hdr.nfreq = pp->nfreq;
+	hdr.month = pp->month;
+	hdr.day = pp->day;
+	hdr.flux = pp->flux;
+	hdr.dB1 = pp->dB1;
+	for (i = 0; i < pp->nfreq; i++)
+		hdr.freq[i] = pp->freq[i];
+	if (pp->options & H_GAIN) {
+		hdr.gain = 1;
+		hdr.ant = *pp->ant;
+	}
+
+	/*
+	 * Collect the sites, the transmitter first. The catalog
+	 * computes the sines and cosines as the main program does.
+	 */
+	memset(&cat, 0, sizeof(cat));
+	lat = lon = NULL;
+	line = name = NULL;
+	names = NULL;
+	n = maxsite = 0;
+	nname = maxname = 0;
+	site = *tx;
+	rval = 1;
+	do {
+		if (n == maxsite) {
+			maxsite = maxsite > 0 ? maxsite * 2 : 1024;
+			lat = realloc(lat, maxsite * sizeof(double));
+			lon = realloc(lon, maxsite * sizeof(double));
+			line = realloc(line, maxsite * sizeof(int));
+			name = realloc(name, (maxsite + 1) * sizeof(int));
+			if (lat == NULL || lon == NULL || line == NULL ||
+			    name == NULL) {
+				fprintf(stderr,
+				    "minimuf: no memory for image\n");
+				return (1);
+			}
+		}
+		if (nname + site.namelen > INT_MAX) {
+			fprintf(stderr, "minimuf: names too long for image\n");
+			return (1);
+		}
+		if (nname + site.namelen > maxname) {
+			maxname = 2 * (nname + site.namelen) + 65536;
+			names = realloc(names, maxname);
+			if (names == NULL) {
+				fprintf(stderr,
+				    "minimuf: no memory for image\n");
+				return (1);
+			}
+		}
+		lat[n] = site.lat;
+		lon[n] = site.lon;
+		line[n] = site.line;
+		name[n] = nname;
+		if (site.namelen > 0)
+			memcpy(names + nname, site.name, site.namelen);
+		nname += site.namelen;
+		if (catadd(&cat, site.lat * D2R, -site.lon * D2R) < 0)
+			return (1);
+		n++;
+	} while ((rval = insite(ip, &site)) > 0);
+	if (rval < 0)
+		return (1);
+	name[n] = nname;
+	hdr.nsite = n;
+	hdr.nname = nname;
+
+	/*
+	 * Write the file.
+	 */
+	sprintf(tmp, "%s.tmp", file);
+	fout = fopen(tmp, "w");
+	if (fout == NULL || fwrite(&hdr, sizeof(hdr), 1, fout) != 1 ||
+	    fwrite(lat, sizeof(double), n, fout) != (size_t)n ||
+	    fwrite(lon, sizeof(double), n, fout) != (size_t)n ||
+	    fwrite(cat.lat, sizeof(double), n, fout) != (size_t)n ||
+	    fwrite(cat.lon, sizeof(double), n, fout) != (size_t)n ||
+	    fwrite(cat.slat, sizeof(double), n, fout) != (size_t)n ||
+	    fwrite(cat.clat, sizeof(double), n, fout) != (size_t)n ||
+	    fwrite(cat.slon, sizeof(double), n, fout) != (size_t)n ||
+	    fwrite(cat.clon, sizeof(double), n, fout) != (size_t)n ||
+	    fwrite(line, sizeof(int), n, fout) != (size_t)n ||
+	    fwrite(name, sizeof(int), n + 1, fout) != (size_t)n + 1 ||
+	    (nname > 0 && fwrite(names, 1, nname, fout) != nname)) {
+		fprintf(stderr, "minimuf: cannot write %s\n", tmp);
+		return (1);
+	}
+	if (fclose(fout) != 0 || rename(tmp, file) != 0) {
+		fprintf(stderr, "minimuf: cannot write %s\n", file);
+		return (1);
+	}
+	if (stats)
+		fprintf(stderr, "image: %d receivers, %.1f MB\n", n - 1,
+		    ISIZE(n, nname) / 1e6);
+	return (0);
+}
+
+/*
+ * imopen(ip, file, par, flag) - map image
+ *
+ * If the file is an image, the header values are stored in the
+ * prediction parameters and output format and the input is set up to
+ * serve the sites. Returns 1 if the file is an image, 0 if it is not
+ * and -1 if it is an image that cannot be used.
+ */
+int
+imopen(
+	struct input *ip,	/* input */
+	char *file,		/* input file */
+	struct param *pp,	/* prediction parameters */
+	int *flag		/* output format */
+	)
+{
+	struct stat st;		/* file status */
+	struct imhdr *hp;	/* header */
+	struct image *im;	/* image */
+	char magic[8];		/* file magic */
+	char *buf;		/* mapping */
+	int fd, i;
+
+	/*
+	 * Anything that does not start with the magic is left to the
+	 * text parser, which gives any error message.
+	 */
+	fd = open(file, O_RDONLY);
+	if (fd < 0)
+		return (0);
+	if (read(fd, magic, sizeof(magic)) != sizeof(magic) ||
+	    memcmp(magic, IMAGIC, sizeof(magic)) != 0) {
+		close(fd);
+		return (0);
+	}
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(struct
+	    imhdr)) {
+		close(fd);
+		goto bad;
+	}
+	buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (buf == MAP_FAILED) {
+		fprintf(stderr, "minimuf: cannot map image %s\n", file);
+		return (-1);
+	}
+	hp = (struct imhdr *)buf;
+	if (hp->nsite < 1 || hp->nfreq < 1 || hp->nfreq > FMAX ||
+	    hp->flag < 0 || hp->flag > 4 || hp->nname > (size_t)st.st_size ||
+	    ISIZE(hp->nsite, hp->nname) != (size_t)st.st_size) {
+		munmap(buf, st.st_size);
+		goto bad;
+	}
+
+	/*
+	 * Header values
+	 */
+	*flag = hp->flag;
+	pp->month = hp->month;
+	pp->day = hp->day;
+	pp->flux = hp->flux;
+	pp->dB1 = hp->dB1;
+	pp->nfreq = hp->nfreq;
+	for (i = 0; i < pp->nfreq; i++)
+		pp->freq[i] = hp->freq[i];
+	if (hp->gain) {
+		*pp->ant = hp->ant;
+		pp->options |= H_GAIN;
+	}
+
+	/*
+	 * Sites
+	 */
+	im = &image;
+	memset(im, 0, sizeof(struct image));
+	im->n = hp->nsite;
+	im->lat = (double *)(hp + 1);
+	im->lon = im->lat + im->n;
+	im->cat.n = im->cat.size = im->n;
+	im->cat.lat = im->lon + im->n;
+	im->cat.lon = im->cat.lat + im->n;
+	im->cat.slat = im->cat.lon + im->n;
+	im->cat.clat = im->cat.slat + im->n;
+	im->cat.slon = im->cat.clat + im->n;
+	im->cat.clon = im->cat.slon + im->n;
+	im->line = (int *)(im->cat.clon + im->n);
+	im->name = im->line + im->n;
+	im->names = (char *)(im->name + im->n + 1);
+
+	/*
+	 * The name offsets are checked once here, so imsite() can trust
+	 * them.
+	 */
+	if (im->name[0] != 0 || (size_t)im->name[im->n] != hp->nname) {
+		munmap(buf, st.st_size);
+		goto bad;
+	}
+	for (i = 0; i < im->n; i++) {
+		if (im->name[i + 1] < im->name[i]) {
+			munmap(buf, st.st_size);
+			goto bad;
+		}
+	}
+	memset(ip, 0, sizeof(struct input));
+	ip->name = file;
+	ip->line = 1;
+	ip->fd = -1;
+	ip->buf = buf;
+	ip->len = st.st_size;
+	ip->mapped = 1;
+	ip->cp = ip->end = ip->buf + ip->len;
+	ip->img = im;
+	return (1);
+
+bad:
+	fprintf(stderr, "minimuf: %s is not a valid image\n", file);
+	return (-1);
+}
+
+/*
+ * imsite(im, sp) - get next site from image
+ *
+ * Returns 1 if a site was found and 0 at end of image, as insite().
+ */
+int
+imsite(
+	struct image *im,	/* image */
+	struct site *sp		/* site */
+	)
+{
+	int i;
+
+	if (im->next >= im->n)
+		return (0);
+	i = im->next++;
+	sp->lat = im->lat[i];
+	sp->lon = im->lon[i];
+	sp->line = im->line[i];
+	sp->name = im->names + im->name[i];
+	sp->namelen = im->name[i + 1] - im->name[i];
+	return (1);
+}
+#endif /* _WIN32 */
@@ -0,0 +1,419 @@
+/*
+ * Spherical spatial index
+ *
+ * The stations are converted to unit vectors and stored in a k-d tree,
+ * so the stations within a given great-circle distance of a point can
+ * be found without looking at every station. The great-circle distance
+ * d and the chord c between two points on a sphere of radius R are
+ * related by c = 2 sin(d / 2R), which increases with d, so a distance
+ * query is a query on the chord, which is the ordinary distance between
+ * the unit vectors.
+ *
+ * The tree is stored implicitly in a permutation of the stations. The
+ * root of the subtree for the stations lo to hi - 1 is the station at
+ * the midpoint, which is the median along the split axis; the stations
+ * before it are on the low side and those after on the high side.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+/*
+ * Query state
+ */
+struct kdquery {
+	double q[3];		/* query point */
+	double cmin2, cmax2;	/* chord bounds squared */
+	double cmax;		/* chord upper bound */
+	int *out;		/* result list */
+	double *dist;		/* result chords squared (nearest) */
+	int n;			/* number of results */
+	int k;			/* max results (nearest) */
+};
+
+/*
+ * Local function declarations
+ */
+static void kdvec(double, double, double *);
+static void kdsplit(struct kdtree *, int, int);
+static void kdselect(struct kdtree *, int, int, int, int);
+static void kdrange1(struct kdtree *, struct kdquery *, int, int);
+static void kdnear1(struct kdtree *, struct kdquery *, int, int);
+static double kdchord(double);
+static int kdcmp(const void *, const void *);
+
+/*
+ * kdbuild(tp, sites, n) - build index
+ *
+ * Returns 0 if all went well, -1 if not.
+ */
+int
+kdbuild(
+	struct kdtree *tp,	/* index */
+	struct site *sites,	/* stations */
+	int n			/* number of stations */
+	)
+{
+	int i;
+
+	tp->n = n;
+	tp->v = malloc((n + 1) * sizeof(tp->v[0]));
+	tp->idx = malloc((n + 1) * sizeof(int));
+	tp->axis = malloc(n + 1);
+	if (tp->v == NULL || tp->idx == NULL || tp->axis == NULL) {
+		fprintf(stderr, "minimuf: no memory for index\n");
+		return (-1);
+	}
+	for (i = 0; i < n; i++) {
+		kdvec(sites[i].lat, sites[i].lon, tp->v[i]);
+		tp->idx[i] = i;
+	}
+	kdsplit(tp, 0, n);
+	return (0);
+}
+
+/*
+ * kdrange(tp, lat, lon, dmin, dmax, out) - find stations in annulus
+ *
+ * The stations at great-circle distances from dmin to dmax (km) from
+ * the given point are stored in the list in input order. Returns the
+ * number of stations found.
+ */
+int
+kdrange(
+	struct kdtree *tp,	/* index */
+	double lat,		/* latitude (deg) */
+	double lon,		/* longitude (deg) */
+	double dmin,		/* min distance (km) */
+	double dmax,		/* max distance (km) */
+	int *out		/* result list */
+	)
+{
+	struct kdquery kq;
+
+	kdvec(lat, lon, kq.q);
+	kq.cmin2 = kdchord(dmin) * kdchord(dmin);
+	kq.cmax = kdchord(dmax);
+	kq.cmax2 = kq.cmax * kq.cmax;
+	kq.out = out;
+	kq.n = 0;
+	kdrange1(tp, &kq, 0, tp->n);
+	qsort(out, kq.n, sizeof(int), kdcmp);
+	return (kq.n);
+}
+
+/*
+ * kdnear(tp, lat, lon, k, out) - find nearest stations
+ *
+ * The k stations nearest the given point are stored in the list,
+ * nearest first. Returns the number of stations found, which is less
+ * than k only if there are fewer than k stations.
+ */
+int
+kdnear(
+	struct kdtree *tp,	/* index */
+	double lat,		/* latitude (deg) */
+	double lon,		/* longitude (deg) */
+	int k,			/* number of stations */
+	int *out		/* result list */
+	)
+{
+	struct kdquery kq;
+	double *dist;		/* chords squared */
+	double c2;		/* chord squared */
+	int i, j, m, n;
+
+	if (k > tp->n)
+		k = tp->n;
+	if (k <= 0)
+		return (0);
+	dist = malloc(k * sizeof(double));
+	if (dist == NULL)
+		return (0);
+	kdvec(lat, lon, kq.q);
+	kq.cmax2 = HUGE_VAL;
+	kq.out = out;
+	kq.dist = dist;
+	kq.n = 0;
+	kq.k = k;
+	kdnear1(tp, &kq, 0, tp->n);
+
+	/*
+	 * Sort the heap, nearest first.
+	 */
+	for (i = kq.n - 1; i > 0; i--) {
+		c2 = dist[i];
+		n = out[i];
+		dist[i] = dist[0];
+		out[i] = out[0];
+		j = 0;
+		while ((m = 2 * j + 1) < i) {
+			if (m + 1 < i && dist[m + 1] > dist[m])
+				m++;
+			if (dist[m] <= c2)
+				break;
+			dist[j] = dist[m];
+			out[j] = out[m];
+			j = m;
+		}
+		dist[j] = c2;
+		out[j] = n;
+	}
+	free(dist);
+	return (kq.n);
+}
+
+/*
+ * kdvec(lat, lon, v) - unit vector for coordinates
+ */
+static void
+kdvec(
+	double lat,		/* latitude (deg) */
+	double lon,		/* longitude (deg) */
+	double *v		/* unit vector */
+	)
+{
+	lat *= D2R;
+	lon *= D2R;
+	v[0] = cos(lat) * cos(lon);
+	v[1] = cos(lat) * sin(lon);
+	v[2] = sin(lat);
+}
+
+/*
+ * kdchord(d) - chord for great-circle distance
+ */
+static double
+kdchord(
+	double d		/* great-circle distance (km) */
+	)
+{
+	if (d <= 0)
+		return (0);
+	if (d >= PI * R)
+		return (2.);
+	return (2. * sin(d / (2. * R)));
+}
+
+/*
+ * kdsplit(tp, lo, hi) - build subtree
+ *
+ * The split axis is the one along which the stations are most spread
+ * out.
+ */
+static void
+kdsplit(
+	struct kdtree *tp,	/* index */
+	int lo,			/* first station */
+	int hi			/* last station + 1 */
+	)
+{
+	double vmin[3], vmax[3]; /* bounding box */
+	double *v;		/* vector pointer */
+	int i, j, ax, mid;
+
+	if (hi - lo < 1)
+		return;
+	for (j = 0; j < 3; j++) {
+		vmin[j] = HUGE_VAL;
+		vmax[j] = -HUGE_VAL;
+	}
+	for (i = lo; i < hi; i++) {
+		v = tp->v[tp->idx[i]];
+		for (j = 0; j < 3; j++) {
+			if (v[j] < vmin[j])
+				vmin[j] = v[j];
+			if (v[j] > vmax[j])
+				vmax[j] = v[j];
+		}
+	}
+	ax = 0;
+	for (j = 1; j < 3; j++) {
+		if (vmax[j] - vmin[j] > vmax[ax] - vmin[ax])
+			ax = j;
+	}
+	mid = (lo + hi) / 2;
+	kdselect(tp, lo, hi, mid, ax);
+	tp->axis[mid] = ax;
+	kdsplit(tp, lo, mid);
+	kdsplit(tp, mid + 1, hi);
+}
+
+/*
+ * kdselect(tp, lo, hi, k, ax) - partition about the kth station
+ *
+ * This is Hoare's selection algorithm. On return, the station at k is
+ * where it would be if the stations were sorted along the axis.
+ */
+static void
+kdselect(
+	struct kdtree *tp,	/* index */
+	int lo,			/* first station */
+	int hi,			/* last station + 1 */
+	int k,			/* station to select */
+	int ax			/* axis */
+	)
+{
+	double pivot;		/* pivot value */
+	int i, j, itemp;
+
+	hi--;
+	while (lo < hi) {
+		pivot = tp->v[tp->idx[(lo + hi) / 2]][ax];
+		i = lo;
+		j = hi;
+		while (i <= j) {
+			while (tp->v[tp->idx[i]][ax] < pivot)
+				i++;
+			while (tp->v[tp->idx[j]][ax] > pivot)
+				j--;
+			if (i <= j) {
+				itemp = tp->idx[i];
+				tp->idx[i] = tp->idx[j];
+				tp->idx[j] = itemp;
+				i++;
+				j--;
+			}
+		}
+		if (k <= j)
+			hi = j;
+		else if (k >= i)
+			lo = i;
+		else
+			break;
+	}
+}
+
+/*
+ * kdrange1(tp, kq, lo, hi) - range query on subtree
+ */
+static void
+kdrange1(
+	struct kdtree *tp,	/* index */
+	struct kdquery *kq,	/* query */
+	int lo,			/* first station */
+	int hi			/* last station + 1 */
+	)
+{
+	double *v;		/* vector pointer */
+	double c2, ftemp;	/* double temps */
+	int mid, ax;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		v = tp->v[tp->idx[mid]];
+		c2 = 0;
+		for (ax = 0; ax < 3; ax++) {
+			ftemp = v[ax] - kq->q[ax];
+			c2 += ftemp * ftemp;
+		}
+		if (c2 >= kq->cmin2 && c2 <= kq->cmax2)
+			kq->out[kq->n++] = tp->idx[mid];
+
+		/*
+		 * Search the near side, then continue with the far side
+		 * if the sphere reaches across the split.
+		 */
+		ax = tp->axis[mid];
+		ftemp = kq->q[ax] - v[ax];
+		if (ftemp < 0) {
+			kdrange1(tp, kq, lo, mid);
+			if (-ftemp > kq->cmax)
+				return;
+			lo = mid + 1;
+		} else {
+			kdrange1(tp, kq, mid + 1, hi);
+			if (ftemp > kq->cmax)
+				return;
+			hi = mid;
+		}
+	}
+}
+
+/*
+ * kdnear1(tp, kq, lo, hi) - nearest query on subtree
+ *
+ * The results are kept as a max-heap on the chord, so the farthest of
+ * the k nearest so far is at the top.
+ */
+static void
+kdnear1(
+	struct kdtree *tp,	/* index */
+	struct kdquery *kq,	/* query */
+	int lo,			/* first station */
+	int hi			/* last station + 1 */
+	)
+{
+	double *v;		/* vector pointer */
+	double c2, ftemp;	/* double temps */
+	int mid, ax, i, j;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		v = tp->v[tp->idx[mid]];
+		c2 = 0;
+		for (ax = 0; ax < 3; ax++) {
+			ftemp = v[ax] - kq->q[ax];
+			c2 += ftemp * ftemp;
+		}
+		if (kq->n < kq->k || c2 < kq->dist[0]) {
+
+			/*
+			 * Insert in the heap, replacing the top if it
+			 * is full, then sift down.
+			 */
+			if (kq->n < kq->k) {
+				i = kq->n++;
+				while (i > 0 && kq->dist[(i - 1) / 2] < c2) {
+					kq->dist[i] = kq->dist[(i - 1) / 2];
+					kq->out[i] = kq->out[(i - 1) / 2];
+					i = (i - 1) / 2;
+				}
+			} else {
+				i = 0;
+				while ((j = 2 * i + 1) < kq->n) {
+					if (j + 1 < kq->n && kq->dist[j + 1] >
+					    kq->dist[j])
+						j++;
+					if (kq->dist[j] <= c2)
+						break;
+					kq->dist[i] = kq->dist[j];
+					kq->out[i] = kq->out[j];
+					i = j;
+				}
+			}
+			kq->dist[i] = c2;
+			kq->out[i] = tp->idx[mid];
+			if (kq->n == kq->k)
+				kq->cmax2 = kq->dist[0];
+		}
+		ax = tp->axis[mid];
+		ftemp = kq->q[ax] - v[ax];
+		if (ftemp < 0) {
+			kdnear1(tp, kq, lo, mid);
+			if (ftemp * ftemp > kq->cmax2)
+				break;
+			lo = mid + 1;
+		} else {
+			kdnear1(tp, kq, mid + 1, hi);
+			if (ftemp * ftemp > kq->cmax2)
+				break;
+			hi = mid;
+		}
+	}
+}
+
+/*
+ * kdcmp(a, b) - compare station numbers for qsort()
+ */
+static int
+kdcmp(
+	const void *a,		/* first station */
+	const void *b		/* second station */
+	)
+{
+	return (*(const int *)a - *(const int *)b);
+}
@@ -0,0 +1,612 @@
+/*
+ * Input data parser
+ *
+ * The input file is mapped into memory and parsed in place. Numbers are
+ * converted by a hand-written parser and site names are returned as
+ * views into the mapping, so nothing is copied and there is no limit
+ * on the length of a name. When the input is not a regular file, such
+ * as a pipe, it is read into memory first.
+ *
+ * The parser follows the rules of the original fscanf() calls. Numbers
+ * are separated by white space without regard to line boundaries and
+ * a site name extends from the end of the preceding number to the end
+ * of the line, including any leading white space.
+ *
+ * In stream mode the input is read as it arrives, so the program can
+ * run as a filter on a pipe that stays open. The parser sees only the
+ * complete lines read so far, and waits for more when it reaches the
+ * end of them, so no number or name is ever cut short by a read. Names
+ * remain valid until the next call of inrelease(), which lets the
+ * space be reused; when the buffer must grow, the data in use are
+ * copied to a new buffer and the old one is kept until then.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <poll.h>
+#include <errno.h>
+#endif /* _WIN32 */
+
+#include "minimuf.h"
+
+#define INCHUNK	65536		/* read size for unmappable input */
+
+/*
+ * Exact powers of ten for the fast path of indouble()
+ */
+static const double pow10[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * Local function declarations
+ */
+static int inskip(struct input *);
+#ifndef _WIN32
+static int inmore(struct input *, int);
+#endif /* _WIN32 */
+
+/*
+ * inopen(ip, file) - open input
+ *
+ * If the file name is NULL, the standard input is used. Returns 0 if
+ * the input is ready and -1 if not.
+ */
+int
+inopen(
+	struct input *ip,	/* input */
+	char *file		/* file name */
+	)
+{
+	FILE *fp;
+	char *buf;
+	size_t len, size, n;
+#ifndef _WIN32
+	struct stat st;
+	int fd;
+#endif /* _WIN32 */
+
+	memset(ip, 0, sizeof(struct input));
+	ip->name = file != NULL ? file : "stdin";
+	ip->line = 1;
+	ip->fd = -1;
+
+#ifndef _WIN32
+	/*
+	 * A regular file is mapped, unless its length is a multiple
+	 * of the page size. Otherwise the zero fill at the end of the
+	 * last page terminates the data, so the number conversion
+	 * routines can never run off the end of the mapping.
+	 */
+	fd = file != NULL ? open(file, O_RDONLY) : 0;
+	if (fd < 0)
+		return (-1);
+	if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+	    st.st_size % sysconf(_SC_PAGESIZE) != 0) {
+		buf = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (buf != MAP_FAILED) {
+			madvise(buf, st.st_size, MADV_SEQUENTIAL);
+			ip->buf = buf;
+			ip->len = st.st_size;
+			ip->mapped = 1;
+			ip->cp = ip->buf;
+			ip->end = ip->buf + ip->len;
+			if (fd != 0)
+				close(fd);
+			return (0);
+		}
+	}
+	if (fd != 0)
+		close(fd);
+#endif /* _WIN32 */
+
+	/*
+	 * Otherwise read the whole thing into memory.
+	 */
+	fp = file != NULL ? fopen(file, "r") : stdin;
+	if (fp == NULL)
+		return (-1);
+	size = INCHUNK;
+	len = 0;
+	buf = malloc(size + 1);
+	while (buf != NULL) {
+		if (size - len < INCHUNK) {
+			size *= 2;
+			buf = realloc(buf, size + 1);
+			if (buf == NULL)
+				break;
+		}
+		n = fread(buf + len, 1, size - len, fp);
+		if (n == 0)
+			break;
+		len += n;
+	}
+	if (fp != stdin)
+		fclose(fp);
+	if (buf == NULL)
+		return (-1);
+	buf[len] = '\0';
+	ip->buf = buf;
+	ip->len = len;
+	ip->cp = ip->buf;
+	ip->end = ip->buf + ip->len;
+	return (0);
+}
+
+#ifndef _WIN32
+/*
+ * instream(ip, file) - open input in stream mode
+ *
+ * If the file name is NULL, the standard input is used. Nothing is
+ * read until the parser asks for it. Returns 0 if the input is ready
+ * and -1 if not.
+ */
+int
+instream(
+	struct input *ip,	/* input */
+	char *file		/* file name */
+	)
+{
+	char *blk;		/* buffer block */
+
+	memset(ip, 0, sizeof(struct input));
+	ip->name = file != NULL ? file : "stdin";
+	ip->line = 1;
+	ip->fd = file != NULL ? open(file, O_RDONLY) : 0;
+	if (ip->fd < 0)
+		return (-1);
+	blk = malloc(sizeof(char *) + INCHUNK + 1);
+	if (blk == NULL) {
+		fprintf(stderr, "minimuf: no memory for input\n");
+		return (-1);
+	}
+	ip->buf = blk + sizeof(char *);
+	ip->size = INCHUNK;
+	ip->cp = ip->end = ip->tail = ip->keep = ip->buf;
+	*ip->end = '\0';
+	return (0);
+}
+
+/*
+ * inmore(ip, wait) - read more of stream
+ *
+ * If wait is nonzero, this reads until at least one more complete line
+ * has arrived or the stream ends; otherwise it reads only what can be
+ * had without waiting. Each buffer block starts with a pointer that
+ * chains it on the retired list. Returns 1 if there are more lines
+ * for the parser, 0 if not and -1 if no memory.
+ */
+static int
+inmore(
+	struct input *ip,	/* input */
+	int wait		/* wait for data */
+	)
+{
+	struct pollfd pfd;	/* poll descriptor */
+	char *blk, *buf;	/* new buffer block, buffer */
+	size_t used, size;	/* data in use, new buffer size */
+	ssize_t n;		/* bytes read */
+	char *cp;
+
+	while (!ip->eof) {
+		if (ip->buf + ip->size - ip->tail < INCHUNK / 2) {
+			used = ip->tail - ip->keep;
+			size = 2 * used + INCHUNK;
+			blk = malloc(sizeof(char *) + size + 1);
+			if (blk == NULL) {
+				fprintf(stderr,
+				    "minimuf: no memory for input\n");
+				return (-1);
+			}
+			buf = blk + sizeof(char *);
+			memcpy(buf, ip->keep, used);
+			blk = ip->buf - sizeof(char *);
+			*(char **)blk = ip->retired;
+			ip->retired = blk;
+			ip->cp = buf + (ip->cp - ip->keep);
+			ip->end = buf + (ip->end - ip->keep);
+			ip->tail = buf + used;
+			ip->keep = ip->buf = buf;
+			ip->size = size;
+		}
+		if (!wait) {
+			pfd.fd = ip->fd;
+			pfd.events = POLLIN;
+			if (poll(&pfd, 1, 0) <= 0)
+				return (0);
+		}
+		n = read(ip->fd, ip->tail, ip->buf + ip->size - ip->tail);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			if (n < 0)
+				inerr(ip, strerror(errno));
+			ip->eof = 1;
+			ip->end = ip->tail;
+			*ip->end = '\0';
+			return (ip->cp < ip->end);
+		}
+		cp = ip->tail += n;
+		while (cp > ip->end && cp[-1] != '\n')
+			cp--;
+		if (cp > ip->end) {
+			ip->end = cp;
+			return (1);
+		}
+	}
+	return (0);
+}
+
+/*
+ * inready(ip) - check for buffered receivers
+ *
+ * This reads whatever has arrived without waiting. Returns 1 if a
+ * complete line with something on it is buffered or the stream has
+ * ended, so the parser will not wait, and 0 if not.
+ */
+int
+inready(
+	struct input *ip	/* input */
+	)
+{
+	char *cp;
+
+	if (ip->fd < 0)
+		return (1);
+	do {
+		for (cp = ip->cp; cp < ip->end; cp++) {
+			if (!isspace((unsigned char)*cp))
+				return (1);
+		}
+	} while (inmore(ip, 0) > 0);
+	return (ip->eof);
+}
+
+/*
+ * inrelease(ip) - release stream data parsed so far
+ *
+ * Names parsed before this call are no longer valid.
+ */
+void
+inrelease(
+	struct input *ip	/* input */
+	)
+{
+	char *blk;		/* buffer block */
+
+	while ((blk = ip->retired) != NULL) {
+		ip->retired = *(char **)blk;
+		free(blk);
+	}
+	ip->keep = ip->cp;
+}
+#endif /* _WIN32 */
+
+/*
+ * inclose(ip) - close input
+ */
+void
+inclose(
+	struct input *ip	/* input */
+	)
+{
+	if (ip->buf == NULL)
+		return;
+#ifndef _WIN32
+	if (ip->fd >= 0) {
+		inrelease(ip);
+		free(ip->buf - sizeof(char *));
+		if (ip->fd != 0)
+			close(ip->fd);
+	} else if (ip->mapped)
+		munmap(ip->buf, ip->len);
+	else
+#endif /* _WIN32 */
+		free(ip->buf);
+	ip->buf = NULL;
+}
+
+/*
+ * inskip(ip) - skip white space
+ *
+ * Returns 1 if there is more data, 0 at end of input.
+ */
+static int
+inskip(
+	struct input *ip	/* input */
+	)
+{
+	char *cp = ip->cp;
+
+	while (cp < ip->end && isspace((unsigned char)*cp)) {
+		if (*cp == '\n')
+			ip->line++;
+		cp++;
+	}
+	ip->cp = cp;
+#ifndef _WIN32
+	if (cp == ip->end && ip->fd >= 0 && inmore(ip, 1) > 0)
+		return (inskip(ip));
+#endif /* _WIN32 */
+	return (cp < ip->end);
+}
+
+/*
+ * indouble(ip, dp) - parse floating-point number
+ *
+ * Returns 1 if a number was found, 0 if something else was found and
+ * -1 at end of input. Numbers with no more than 19 significant digits
+ * and a decimal exponent no more than 22 in magnitude are converted
+ * exactly with one multiply or divide; anything else, including
+ * infinities, NaNs and hex numbers, is left to strtod().
+ */
+int
+indouble(
+	struct input *ip,	/* input */
+	double *dp		/* number */
+	)
+{
+	unsigned long long m;	/* mantissa */
+	char *cp, *ep;		/* character pointers */
+	int neg, ndig, nsig;	/* sign, digits, significant digits */
+	int exp, eneg, edig;	/* exponent */
+	double ftemp;
+
+	if (!inskip(ip))
+		return (-1);
+	cp = ip->cp;
+	neg = 0;
+	if (*cp == '-' || *cp == '+')
+		neg = *cp++ == '-';
+	m = 0;
+	ndig = nsig = exp = 0;
+	while (cp < ip->end && isdigit((unsigned char)*cp)) {
+		if (nsig < 19) {
+			m = m * 10 + *cp - '0';
+			if (m > 0)
+				nsig++;
+		} else {
+			nsig++;
+			exp++;
+		}
+		ndig++;
+		cp++;
+	}
+	if (cp < ip->end && *cp == '.') {
+		cp++;
+		while (cp < ip->end && isdigit((unsigned char)*cp)) {
+			if (nsig < 19) {
+				m = m * 10 + *cp - '0';
+				if (m > 0)
+					nsig++;
+				exp--;
+			} else {
+				nsig++;
+			}
+			ndig++;
+			cp++;
+		}
+	}
+	if (ndig == 0 || (cp < ip->end && (*cp == 'x' || *cp == 'X')))
+		goto slow;
+	if (cp < ip->end && (*cp == 'e' || *cp == 'E')) {
+		ep = cp + 1;
+		eneg = 0;
+		if (ep < ip->end && (*ep == '-' || *ep == '+'))
+			eneg = *ep++ == '-';
+		edig = 0;
+		while (ep < ip->end && isdigit((unsigned char)*ep)) {
+			if (edig < 9)
+				edig = edig * 10 + *ep - '0';
+			ep++;
+		}
+		if (ep > cp + 1 && isdigit((unsigned char)ep[-1])) {
+			exp += eneg ? -edig : edig;
+			cp = ep;
+		}
+	}
+	if (nsig > 19 || m >= (1ULL << 53) || exp < -22 || exp > 22)
+		goto slow;
+	ftemp = (double)m;
+	if (exp < 0)
+		ftemp /= pow10[-exp];
+	else
+		ftemp *= pow10[exp];
+	*dp = neg ? -ftemp : ftemp;
+	ip->cp = cp;
+	return (1);
+
+	/*
+	 * Hard cases
+	 */
+slow:
+	ftemp = strtod(ip->cp, &ep);
+	if (ep == ip->cp)
+		return (0);
+	*dp = ftemp;
+	ip->cp = ep;
+	return (1);
+}
+
+/*
+ * inint(ip, np) - parse integer
+ *
+ * Like %i, this accepts octal and hex numbers. Returns as indouble().
+ */
+int
+inint(
+	struct input *ip,	/* input */
+	int *np			/* number */
+	)
+{
+	char *ep;
+	long ltemp;
+
+	if (!inskip(ip))
+		return (-1);
+	ltemp = strtol(ip->cp, &ep, 0);
+	if (ep == ip->cp)
+		return (0);
+	*np = (int)ltemp;
+	ip->cp = ep;
+	return (1);
+}
+
+/*
+ * inname(ip, sp) - parse site name
+ *
+ * The name extends to the end of the line. Returns 1 if a name was
+ * found and 0 if the line is empty.
+ */
+int
+inname(
+	struct input *ip,	/* input */
+	struct site *sp		/* site */
+	)
+{
+	char *cp;
+
+	cp = memchr(ip->cp, '\n', ip->end - ip->cp);
+	if (cp == NULL)
+		cp = ip->end;
+	sp->name = ip->cp;
+	sp->namelen = cp - ip->cp;
+	ip->cp = cp;
+	return (sp->namelen > 0);
+}
+
+/*
+ * insite(ip, sp) - parse site coordinates and name
+ *
+ * Returns 1 if a site was found, 0 at end of input or if the line has
+ * no name, as with the original fscanf(), and -1 if the line is not
+ * valid, in which case a message has been displayed. Sites in a
+ * startup image are served from the image.
+ */
+int
+insite(
+	struct input *ip,	/* input */
+	struct site *sp		/* site */
+	)
+{
+	int rval;
+
+#ifndef _WIN32
+	if (ip->img != NULL)
+		return (imsite(ip->img, sp));
+#endif /* _WIN32 */
+	rval = indouble(ip, &sp->lat);
+	if (rval < 0)
+		return (0);
+	if (rval == 0) {
+		inerr(ip, "bad latitude");
+		return (-1);
+	}
+	if (indouble(ip, &sp->lon) != 1) {
+		inerr(ip, "bad longitude");
+		return (-1);
+	}
+	sp->line = ip->line;
+	return (inname(ip, sp));
+}
+
+/*
+ * insave(sp) - copy site name
+ *
+ * The copy outlives the input data, which in stream mode are reused.
+ * Returns 0 if all went well, -1 if no memory.
+ */
+int
+insave(
+	struct site *sp		/* site */
+	)
+{
+	char *cp;
+
+	cp = malloc(sp->namelen + 1);
+	if (cp == NULL) {
+		fprintf(stderr, "minimuf: no memory for name\n");
+		return (-1);
+	}
+	memcpy(cp, sp->name, sp->namelen);
+	cp[sp->namelen] = '\0';
+	sp->name = cp;
+	return (0);
+}
+
+/*
+ * inlist(ip, list, n) - parse station list
+ *
+ * Stations are appended to the list, which is grown as necessary, until
+ * end of input. Returns 0 if all went well, -1 if not.
+ */
+int
+inlist(
+	struct input *ip,	/* input */
+	struct station **list,	/* station list */
+	int *n			/* number of stations */
+	)
+{
+	struct station *sp;	/* new list */
+	struct site site;	/* site */
+	int size;		/* list size */
+	int rval;
+
+	size = *n;
+	while ((rval = insite(ip, &site)) > 0) {
+		if (*n == size) {
+			size = size * 2 + 16;
+			sp = realloc(*list, size * sizeof(struct station));
+			if (sp == NULL) {
+				fprintf(stderr,
+				    "minimuf: no memory for stations\n");
+				return (-1);
+			}
+			*list = sp;
+		}
+		instation(&(*list)[(*n)++], &site);
+	}
+	return (rval);
+}
+
+/*
+ * instation(sp, site) - initialize station data from site
+ */
+void
+instation(
+	struct station *sp,	/* station */
+	struct site *site	/* site */
+	)
+{
+	sp->lat = site->lat * D2R;
+	sp->lon = -site->lon * D2R;
+	sp->slat = sin(sp->lat);
+	sp->clat = cos(sp->lat);
+	sp->slon = sin(sp->lon);
+	sp->clon = cos(sp->lon);
+	sp->name = site->name;
+	sp->namelen = site->namelen;
+}
+
+/*
+ * inerr(ip, msg) - display parse error
+ */
+void
+inerr(
+	struct input *ip,	/* input */
+	char *msg		/* message */
+	)
+{
+	fprintf(stderr, "minimuf: %s line %d: %s\n", ip->name, ip->line,
+	    msg);
+}
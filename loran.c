@@ -0,0 +1,525 @@
+/*
+ * Loran-C time differences
+ *
+ * When enabled by the -g or -G option, the input data describe a
+ * Loran-C chain, as in lorsta.dat, and the program computes the ground-
+ * wave time of arrival (TOA) of each station and the time difference
+ * (TD) of each secondary relative to the master, either for each
+ * receiver in the input data (-g) or over a latitude/longitude grid
+ * (-G). The header and frequency lines are read as usual but not used.
+ * The name of each site begins with a role letter: r for a receiver, m
+ * for the master or any other letter for a secondary, which names the
+ * secondary. The name of each station ends with the emission delay
+ * (us), which is the baseline delay plus the coding delay and is zero
+ * for the master:
+ *
+ *	39.68005 -75.75085 r UDel Evans Hall
+ *	42.71406 -76.82607 m Seneca 0.0
+ *	46.80756 -67.92714 w Caribou 13797.20
+ *
+ * The TOA is the great-circle distance over the speed of light in air,
+ * with an index of refraction of 1.000338. The secondary phase factor
+ * over sea water and the additional secondary factor over land are not
+ * modelled. The TD of a secondary is its emission delay plus its TOA
+ * less the TOA of the master.
+ *
+ * The geometric dilution of precision (GDOP) is the ratio of position
+ * error to range error for independent errors of the same size in the
+ * arrival times of all stations. The TDs share the arrival time of the
+ * master, so their errors are correlated with covariance I + 11' in
+ * units of the arrival time variance. With the rows of H the gradients
+ * of the secondary distances less that of the master distance, the GDOP
+ * is sqrt(trace(A^-1)), where A = H'(I + 11')^-1 H = H'H - (H'1)(1'H) /
+ * (n + 1) for n secondaries. It is displayed as a dash with fewer than
+ * two secondaries or where the lines of position are parallel.
+ *
+ * The stations and the points of a batch are held as arrays of unit
+ * vectors, so the geometry for a batch is a set of simple loops over
+ * the points, one for each station, which the compiler can vectorize.
+ * The receivers are one batch; a grid is done one row at a time.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#ifndef _WIN32
+
+#define NLORAN	8		/* max stations in a chain */
+#define NREFR	1.000338	/* index of refraction of air */
+
+/*
+ * Batch of points. The coordinates and directions are unit vectors in
+ * the Earth frame.
+ */
+struct lbatch {
+	int n;			/* number of points */
+	double *x, *y, *z;	/* position */
+	double *ex, *ey;	/* east direction (z component is zero) */
+	double *nx, *ny, *nz;	/* north direction */
+	double *dist[NLORAN];	/* distance to station (km) */
+	double *ge[NLORAN];	/* distance gradient east */
+	double *gn[NLORAN];	/* distance gradient north */
+};
+
+/*
+ * Chain data. The master is first.
+ */
+static int nsta;		/* number of stations */
+static struct site sta[NLORAN];	/* stations */
+static int tag[NLORAN];		/* role letters */
+static double ed[NLORAN];	/* emission delays (us) */
+static double sx[NLORAN], sy[NLORAN], sz[NLORAN]; /* positions */
+
+/*
+ * Local function declarations
+ */
+static int lrole(struct site *, int *, double *);
+static int lalloc(struct lbatch *, int);
+static void lpoint(struct lbatch *, int, double, double);
+static void lgeom(struct lbatch *);
+static double lgdop(struct lbatch *, int);
+static void lprint(struct obuf *, struct lbatch *, int, struct site *);
+static void lrow(struct obuf *, struct lbatch *, double, double,
+    double);
+
+/*
+ * loran(ip, first, grid, ob) - Loran-C time difference mode
+ *
+ * The input data have been read up to and including the first site.
+ * With a grid specification lat1,lat2,lon1,lon2,step (deg N/E), the TDs
+ * are displayed over the grid; otherwise for the receivers. Returns the
+ * program exit status.
+ */
+int
+loran(
+	struct input *ip,	/* input data */
+	struct site *first,	/* first site in input data */
+	char *grid,		/* grid specification */
+	struct obuf *ob		/* output buffer */
+	)
+{
+	struct lbatch lb;	/* batch */
+	struct site *rxs, *sp;	/* receivers */
+	struct site site;	/* site */
+	double lat1, lat2, lon1, lon2, step; /* grid (deg) */
+	double delay;		/* emission delay (us) */
+	int nrx, size;		/* receivers, list size */
+	int role;		/* role letter */
+	int i, n, rval;		/* int temps */
+
+	/*
+	 * Read the sites and sort out the roles.
+	 */
+	if (grid != NULL && (sscanf(grid, "%lf,%lf,%lf,%lf,%lf", &lat1,
+	    &lat2, &lon1, &lon2, &step) != 5 || step <= 0 || lat2 < lat1 ||
+	    lon2 < lon1)) {
+		fprintf(stderr, "minimuf: bad grid %s\n", grid);
+		return (1);
+	}
+	rxs = NULL;
+	nrx = size = 0;
+	nsta = 1;
+	tag[0] = 0;
+	site = *first;
+	do {
+		if (lrole(&site, &role, &delay) < 0)
+			return (1);
+		if (role == 'r') {
+			if (nrx == size) {
+				size = size * 2 + 16;
+				sp = realloc(rxs, size * sizeof(struct site));
+				if (sp == NULL) {
+					fprintf(stderr,
+					    "minimuf: no memory for receivers\n");
+					return (1);
+				}
+				rxs = sp;
+			}
+			rxs[nrx++] = site;
+			continue;
+		}
+		if (role == 'm') {
+			if (tag[0] != 0) {
+				fprintf(stderr,
+				    "minimuf: line %d: second master\n",
+				    site.line);
+				return (1);
+			}
+			i = 0;
+		} else if (nsta == NLORAN) {
+			fprintf(stderr, "minimuf: line %d: too many stations\n",
+			    site.line);
+			return (1);
+		} else {
+			i = nsta++;
+		}
+		sta[i] = site;
+		tag[i] = role;
+		ed[i] = delay;
+	} while ((rval = insite(ip, &site)) > 0);
+	if (rval < 0)
+		return (1);
+	if (tag[0] == 0) {
+		fprintf(stderr, "minimuf: no master station\n");
+		return (1);
+	}
+	for (i = 0; i < nsta; i++) {
+		sx[i] = cos(sta[i].lat * D2R) * cos(sta[i].lon * D2R);
+		sy[i] = cos(sta[i].lat * D2R) * sin(sta[i].lon * D2R);
+		sz[i] = sin(sta[i].lat * D2R);
+	}
+
+	/*
+	 * Display the chain.
+	 */
+	TSTART(ST_OUT);
+	obputs(ob, "Station                           Lat     Long    ED (us)\n");
+	for (i = 0; i < nsta; i++) {
+		obputc(ob, tag[i]);
+		obputc(ob, ' ');
+		obname(ob, sta[i].name, sta[i].namelen, 27);
+		obfix(ob, sta[i].lat, 8, 2);
+		obputs(ob, "N ");
+		obfix(ob, -sta[i].lon, 7, 2);
+		obputs(ob, "W ");
+		obfix(ob, ed[i], 9, 2);
+		obputc(ob, '\n');
+	}
+	TSTOP(ST_OUT);
+
+	/*
+	 * Receivers, all in one batch
+	 */
+	if (grid == NULL) {
+		if (lalloc(&lb, nrx) < 0)
+			return (1);
+		TSTART(ST_GEOM);
+		for (i = 0; i < nrx; i++)
+			lpoint(&lb, i, rxs[i].lat, rxs[i].lon);
+		lgeom(&lb);
+		TSTOP(ST_GEOM);
+		TSTART(ST_OUT);
+		for (i = 0; i < nrx; i++)
+			lprint(ob, &lb, i, &rxs[i]);
+		TSTOP(ST_OUT);
+		return (obflush(ob) < 0);
+	}
+
+	/*
+	 * Grid, one batch for each row of constant latitude. The rows
+	 * and columns are counted to avoid accumulating roundoff.
+	 */
+	n = (int)((lon2 - lon1) / step + 1e-9) + 1;
+	if (lalloc(&lb, n) < 0)
+		return (1);
+	TSTART(ST_OUT);
+	obputs(ob, "\n   Lat    Long");
+	for (i = 1; i < nsta; i++) {
+		obputs(ob, "      TD ");
+		obputc(ob, tag[i]);
+	}
+	obputs(ob, "   GDOP\n");
+	TSTOP(ST_OUT);
+	n = (int)((lat2 - lat1) / step + 1e-9) + 1;
+	for (i = 0; i < n; i++)
+		lrow(ob, &lb, lat1 + i * step, lon1, step);
+	return (obflush(ob) < 0);
+}
+
+/*
+ * lrole(sp, role, delay) - parse role letter and emission delay
+ *
+ * The role letter is removed from the front of the name and, for a
+ * station, the emission delay from the end. Returns 0 if ok, -1 if the
+ * site line is bad.
+ */
+static int
+lrole(
+	struct site *sp,	/* site */
+	int *role,		/* role letter */
+	double *delay		/* emission delay (us) */
+	)
+{
+	char buf[40];		/* emission delay text */
+	char *cp, *ep;		/* character pointers */
+	int n;
+
+	cp = sp->name;
+	ep = sp->name + sp->namelen;
+	while (cp < ep && isspace((unsigned char)*cp))
+		cp++;
+	if (ep - cp < 2 || !isalpha((unsigned char)cp[0]) ||
+	    !isspace((unsigned char)cp[1])) {
+		fprintf(stderr, "minimuf: line %d: bad Loran role\n",
+		    sp->line);
+		return (-1);
+	}
+	*role = tolower((unsigned char)*cp++);
+	while (cp < ep && isspace((unsigned char)*cp))
+		cp++;
+	sp->name = cp;
+	sp->namelen = ep - cp;
+	*delay = 0;
+	if (*role == 'r')
+		return (0);
+
+	/*
+	 * Station. The emission delay is the last word.
+	 */
+	while (ep > cp && isspace((unsigned char)ep[-1]))
+		ep--;
+	n = 0;
+	while (ep > cp && !isspace((unsigned char)ep[-1])) {
+		ep--;
+		n++;
+	}
+	if (n == 0 || n >= (int)sizeof(buf)) {
+		fprintf(stderr, "minimuf: line %d: bad emission delay\n",
+		    sp->line);
+		return (-1);
+	}
+	memcpy(buf, ep, n);
+	buf[n] = '\0';
+	*delay = strtod(buf, &cp);
+	if (*cp != '\0') {
+		fprintf(stderr, "minimuf: line %d: bad emission delay\n",
+		    sp->line);
+		return (-1);
+	}
+	while (ep > sp->name && isspace((unsigned char)ep[-1]))
+		ep--;
+	sp->namelen = ep - sp->name;
+	return (0);
+}
+
+/*
+ * lalloc(lb, n) - allocate batch of n points
+ *
+ * The arrays are carved from one block. Returns 0 if ok, -1 if no
+ * memory.
+ */
+static int
+lalloc(
+	struct lbatch *lb,	/* batch */
+	int n			/* number of points */
+	)
+{
+	double *dp;		/* array pointer */
+	int i;
+
+	dp = malloc(((size_t)8 + 3 * nsta) * (n > 0 ? n : 1) *
+	    sizeof(double));
+	if (dp == NULL) {
+		fprintf(stderr, "minimuf: no memory for Loran batch\n");
+		return (-1);
+	}
+	lb->n = n;
+	lb->x = dp; dp += n;
+	lb->y = dp; dp += n;
+	lb->z = dp; dp += n;
+	lb->ex = dp; dp += n;
+	lb->ey = dp; dp += n;
+	lb->nx = dp; dp += n;
+	lb->ny = dp; dp += n;
+	lb->nz = dp; dp += n;
+	for (i = 0; i < nsta; i++) {
+		lb->dist[i] = dp; dp += n;
+		lb->ge[i] = dp; dp += n;
+		lb->gn[i] = dp; dp += n;
+	}
+	return (0);
+}
+
+/*
+ * lpoint(lb, k, lat, lon) - set point k of batch
+ */
+static void
+lpoint(
+	struct lbatch *lb,	/* batch */
+	int k,			/* point index */
+	double lat,		/* latitude (deg N) */
+	double lon		/* longitude (deg E) */
+	)
+{
+	double slat, clat, slon, clon; /* sines and cosines */
+
+	slat = sin(lat * D2R);
+	clat = cos(lat * D2R);
+	slon = sin(lon * D2R);
+	clon = cos(lon * D2R);
+	lb->x[k] = clat * clon;
+	lb->y[k] = clat * slon;
+	lb->z[k] = slat;
+	lb->ex[k] = -slon;
+	lb->ey[k] = clon;
+	lb->nx[k] = -slat * clon;
+	lb->ny[k] = -slat * slon;
+	lb->nz[k] = clat;
+}
+
+/*
+ * lgeom(lb) - distances and distance gradients for batch
+ *
+ * The distance is R atan2(|p x s|, p . s) for point p and station s.
+ * The direction from the point toward the station is s - (p . s) p,
+ * normalized by |p x s|, and the gradient of the distance is minus
+ * this, resolved east and north.
+ */
+static void
+lgeom(
+	struct lbatch *lb	/* batch */
+	)
+{
+	double dot;		/* cosine of angle */
+	double tx, ty, tz;	/* direction toward station */
+	double sn;		/* sine of angle */
+	double f;		/* gradient scale */
+	int i, k;
+
+	for (i = 0; i < nsta; i++) {
+		for (k = 0; k < lb->n; k++) {
+			dot = lb->x[k] * sx[i] + lb->y[k] * sy[i] +
+			    lb->z[k] * sz[i];
+			tx = sx[i] - dot * lb->x[k];
+			ty = sy[i] - dot * lb->y[k];
+			tz = sz[i] - dot * lb->z[k];
+			sn = sqrt(tx * tx + ty * ty + tz * tz);
+			lb->dist[i][k] = R * atan2(sn, dot);
+			f = sn > 0 ? -1. / sn : 0;
+			lb->ge[i][k] = f * (tx * lb->ex[k] + ty * lb->ey[k]);
+			lb->gn[i][k] = f * (tx * lb->nx[k] + ty * lb->ny[k] +
+			    tz * lb->nz[k]);
+		}
+	}
+}
+
+/*
+ * lgdop(lb, k) - GDOP at point k of batch
+ *
+ * Returns -1 if there are fewer than two secondaries or the geometry is
+ * degenerate.
+ */
+static double
+lgdop(
+	struct lbatch *lb,	/* batch */
+	int k			/* point index */
+	)
+{
+	double a11, a12, a22;	/* normal matrix */
+	double s1, s2;		/* column sums of H */
+	double h1, h2;		/* row of H */
+	double det;		/* determinant */
+	int i;
+
+	if (nsta < 3)
+		return (-1);
+	a11 = a12 = a22 = s1 = s2 = 0;
+	for (i = 1; i < nsta; i++) {
+		h1 = lb->ge[i][k] - lb->ge[0][k];
+		h2 = lb->gn[i][k] - lb->gn[0][k];
+		a11 += h1 * h1;
+		a12 += h1 * h2;
+		a22 += h2 * h2;
+		s1 += h1;
+		s2 += h2;
+	}
+	a11 -= s1 * s1 / nsta;
+	a12 -= s1 * s2 / nsta;
+	a22 -= s2 * s2 / nsta;
+	det = a11 * a22 - a12 * a12;
+	if (det <= 1e-9 * (a11 + a22) * (a11 + a22))
+		return (-1);
+	return (sqrt((a11 + a22) / det));
+}
+
+/*
+ * lprint(ob, lb, k, site) - display point k of batch for receiver
+ *
+ * The columns are station, distance (km), TOA (us) and TD (us).
+ */
+static void
+lprint(
+	struct obuf *ob,	/* output buffer */
+	struct lbatch *lb,	/* batch */
+	int k,			/* point index */
+	struct site *sp		/* receiver */
+	)
+{
+	double toa0, toa;	/* TOA of master, station (us) */
+	double gdop;		/* GDOP */
+	int i;
+
+	obputs(ob, "\nReceiver");
+	obfix(ob, sp->lat, 8, 2);
+	obputs(ob, "N ");
+	obfix(ob, -sp->lon, 7, 2);
+	obputs(ob, "W ");
+	obname(ob, sp->name, sp->namelen, 0);
+	obputs(ob, "\nStation                    Dist  TOA (us)   TD (us)\n");
+	toa0 = lb->dist[0][k] * 1e9 / VOFL * NREFR;
+	for (i = 0; i < nsta; i++) {
+		toa = lb->dist[i][k] * 1e9 / VOFL * NREFR;
+		obputc(ob, tag[i]);
+		obputc(ob, ' ');
+		obname(ob, sta[i].name, sta[i].namelen, 20);
+		obfix(ob, lb->dist[i][k], 9, 0);
+		obfix(ob, toa, 10, 2);
+		if (i > 0)
+			obfix(ob, ed[i] + toa - toa0, 10, 2);
+		obputc(ob, '\n');
+	}
+	gdop = lgdop(lb, k);
+	obputs(ob, "GDOP");
+	if (gdop < 0)
+		obputs(ob, " -");
+	else
+		obfix(ob, gdop, 6, 2);
+	obputc(ob, '\n');
+}
+
+/*
+ * lrow(ob, lb, lat, lon1, step) - display grid row
+ *
+ * The columns are latitude, longitude (deg N/E), the TD (us) of each
+ * secondary and the GDOP.
+ */
+static void
+lrow(
+	struct obuf *ob,	/* output buffer */
+	struct lbatch *lb,	/* batch */
+	double lat,		/* latitude (deg N) */
+	double lon1,		/* first longitude (deg E) */
+	double step		/* longitude step (deg) */
+	)
+{
+	double toa0;		/* TOA of master (us) */
+	double gdop;		/* GDOP */
+	int i, k;
+
+	TSTART(ST_GEOM);
+	for (k = 0; k < lb->n; k++)
+		lpoint(lb, k, lat, lon1 + k * step);
+	lgeom(lb);
+	TSTOP(ST_GEOM);
+	TSTART(ST_OUT);
+	for (k = 0; k < lb->n; k++) {
+		obfix(ob, lat, 6, 2);
+		obfix(ob, lon1 + k * step, 8, 2);
+		toa0 = lb->dist[0][k] * 1e9 / VOFL * NREFR;
+		for (i = 1; i < nsta; i++)
+			obfix(ob, ed[i] + lb->dist[i][k] * 1e9 / VOFL * NREFR -
+			    toa0, 10, 2);
+		gdop = lgdop(lb, k);
+		if (gdop < 0)
+			obputs(ob, "      -");
+		else
+			obfix(ob, gdop, 7, 2);
+		obputc(ob, '\n');
+	}
+	TSTOP(ST_OUT);
+}
+#endif /* _WIN32 */
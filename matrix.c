@@ -0,0 +1,327 @@
+/*
+ * Transmitter-receiver matrix mode
+ *
+ * When enabled by the -x option, the program computes every path from
+ * a list of M transmitters to the list of N receivers in the input
+ * data and displays the MUF and signal-to-noise ratio of each path as
+ * an M x N matrix for each hour. The transmitter in the input data is
+ * the first transmitter, followed by those in the named file, which
+ * has one site per line in the same format as the receiver lines.
+ *
+ * The receivers are kept in a catalog (see catalog.c), so the path
+ * geometry for each transmitter and the receivers of a tile is
+ * computed by the batch kernel. The matrix is divided into square
+ * tiles of TILE stations on a side, which are handed out to the worker
+ * threads in turn, so each thread works on a small set of stations at
+ * a time. The results are saved in memory and displayed when all tiles
+ * are complete.
+ *
+ * The signal-to-noise ratio is the receive power of the best frequency
+ * relative to the thermal noise; a dash means no frequency is usable.
+ *
+ * With the -f option, the batch geometry is computed in single
+ * precision (see catalog.c) and the matrices are kept in single
+ * precision, which halves their size. The values are displayed with
+ * one decimal or none, so they are rounded the same way except where
+ * they fall within roundoff of a rounding boundary.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+
+#define TILE	16		/* stations per tile side */
+#define NTHREAD	64		/* max worker threads */
+
+/*
+ * Matrix data, shared by the worker threads. None of these are changed
+ * while the workers are running, except for the next tile number.
+ */
+static struct param *mpar;	/* prediction parameters */
+static struct station *txs;	/* transmitters */
+static struct station *rxs;	/* receivers */
+static struct catalog rcat;	/* receiver catalog */
+static int fast;		/* batch geometry usable */
+static int ntx, nrx;		/* number of transmitters, receivers */
+static int hr1, nhour;		/* first hour, number of hours */
+static double *mmuf;		/* MUF [hour][tx][rx] (MHz) */
+static double *msnr;		/* SNR [hour][tx][rx] (dB) */
+static float *fmuf, *fsnr;	/* single-precision MUF, SNR (-f) */
+static int nrtile;		/* tiles per row */
+static int ntile;		/* number of tiles */
+static int tnext;		/* next tile */
+
+/*
+ * Local function declarations
+ */
+static void *mworker(void *);
+static void mtile(int, struct gbatch *);
+static void mlist(struct obuf *, char *, struct station *, int);
+static void mprint(struct obuf *, char *, double *, float *, size_t, int,
+    int);
+
+/*
+ * matrix(par, ip, tx, txfile, nthread, h1, h2, ob) - matrix mode
+ *
+ * The input data have been read up to and including the transmitter.
+ * Returns the program exit status.
+ */
+int
+matrix(
+	struct param *pp,	/* prediction parameters */
+	struct input *ip,	/* input data */
+	struct site *tx,	/* transmitter in input data */
+	char *txfile,		/* transmitter file */
+	int nthread,		/* number of worker threads */
+	int h1,			/* first hour */
+	int h2,			/* last hour */
+	struct obuf *ob		/* output buffer */
+	)
+{
+	struct input txin;	/* transmitter file */
+	pthread_t tid[NTHREAD];	/* worker threads */
+	size_t n;		/* matrix size */
+	double t_mat;		/* matrix span start */
+	int i, h;		/* int temps */
+
+	/*
+	 * Read the stations. The transmitter file must stay open,
+	 * since the site names point into it.
+	 */
+	mpar = pp;
+	ntx = 1;
+	txs = malloc(sizeof(struct station));
+	if (txs == NULL) {
+		fprintf(stderr, "minimuf: no memory for matrix\n");
+		return (1);
+	}
+	instation(&txs[0], tx);
+	if (inopen(&txin, txfile) < 0) {
+		fprintf(stderr, "minimuf: cannot open %s\n", txfile);
+		return (1);
+	}
+	if (inlist(&txin, &txs, &ntx) < 0 || inlist(ip, &rxs, &nrx) < 0)
+		return (1);
+	if (nrx == 0)
+		return (0);
+	for (i = 0; i < nrx; i++) {
+		if (catadd(&rcat, rxs[i].lat, rxs[i].lon) < 0)
+			return (1);
+	}
+	fast = pp->minbeta > 0 && pp->minbeta < PIH;
+
+	/*
+	 * Allocate the matrices and start the workers.
+	 */
+	hr1 = h1;
+	nhour = h2 - h1 + 1;
+	n = (size_t)nhour * ntx * nrx;
+	if (pp->options & H_FLOAT) {
+		fmuf = malloc(n * sizeof(float));
+		fsnr = malloc(n * sizeof(float));
+	} else {
+		mmuf = malloc(n * sizeof(double));
+		msnr = malloc(n * sizeof(double));
+	}
+	if ((mmuf == NULL || msnr == NULL) && (fmuf == NULL || fsnr ==
+	    NULL)) {
+		fprintf(stderr, "minimuf: no memory for matrix\n");
+		return (1);
+	}
+	nrtile = (nrx + TILE - 1) / TILE;
+	ntile = (ntx + TILE - 1) / TILE * nrtile;
+	tnext = 0;
+	if (nthread > ntile)
+		nthread = ntile;
+	if (nthread > NTHREAD)
+		nthread = NTHREAD;
+	t_mat = tbegin();
+	for (i = 1; i < nthread; i++) {
+		if (pthread_create(&tid[i], NULL, mworker, "worker") != 0) {
+			nthread = i;
+			break;
+		}
+	}
+	mworker(NULL);
+	for (i = 1; i < nthread; i++)
+		pthread_join(tid[i], NULL);
+	tend("matrix", "matrix", t_mat, (long)ntile);
+
+	/*
+	 * Display the station lists and the matrices for each hour.
+	 */
+	TSTART(ST_OUT);
+	obprintf(ob, "10-cm solar flux:%4.0lf   SN:%4.0lf   Month:%3.0lf   Day:%3.0lf   Power:%3.0f dBW\n",
+	    pp->flux, pp->ssn, pp->month, pp->day, pp->dB1);
+	mlist(ob, "Transmitters", txs, ntx);
+	mlist(ob, "Receivers", rxs, nrx);
+	for (h = 0; h < nhour; h++) {
+		n = (size_t)h * ntx * nrx;
+		mprint(ob, "MUF (MHz)", mmuf, fmuf, n, h + hr1, 1);
+		mprint(ob, "SNR (dB)", msnr, fsnr, n, h + hr1, 0);
+	}
+	TSTOP(ST_OUT);
+	if (obflush(ob) < 0)
+		return (1);
+	return (0);
+}
+
+/*
+ * mworker(name) - worker thread
+ *
+ * This takes the next tile until there are none left. The main thread
+ * also runs this, with a NULL name.
+ */
+static void *
+mworker(
+	void *name		/* thread name */
+	)
+{
+	struct gbatch gb;	/* tile geometry */
+	double t_tile;		/* tile span start */
+	int t;			/* tile number */
+
+	if (name != NULL)
+		trname(name);
+	if (gbinit(&gb, TILE) < 0)
+		return (NULL);
+	while ((t = __atomic_fetch_add(&tnext, 1, __ATOMIC_RELAXED)) <
+	    ntile) {
+		t_tile = tbegin();
+		mtile(t, &gb);
+		tend("tile", "matrix", t_tile, (long)t);
+	}
+	free(gb.theta);
+	free(gb.hop);
+	return (NULL);
+}
+
+/*
+ * mtile(t, gb) - compute one tile
+ */
+static void
+mtile(
+	int t,			/* tile number */
+	struct gbatch *gb	/* tile geometry */
+	)
+{
+	struct path path;	/* path state */
+	struct result res;	/* prediction for one hour */
+	struct station *tp, *rp; /* station pointers */
+	double snr;		/* signal-to-noise ratio (dB) */
+	size_t n;		/* matrix index */
+	int i, j, h;		/* int temps */
+	int i1, i2, j1, j2;	/* tile bounds */
+
+	i1 = t / nrtile * TILE;
+	i2 = i1 + TILE < ntx ? i1 + TILE : ntx;
+	j1 = t % nrtile * TILE;
+	j2 = j1 + TILE < nrx ? j1 + TILE : nrx;
+	for (i = i1; i < i2; i++) {
+		tp = &txs[i];
+		if (fast)
+			catgeom(mpar, tp, &rcat, j1, j2 - j1, gb);
+		for (j = j1; j < j2; j++) {
+			rp = &rxs[j];
+			memset(&path, 0, sizeof(path));
+			path.lat1 = tp->lat;
+			path.lon1 = tp->lon;
+			path.lat2 = rp->lat;
+			path.lon2 = rp->lon;
+			if (fast)
+				catpath(gb, j - j1, &path);
+			else
+				pathgeom(mpar, &path, tp->slat, tp->clat,
+				    rp->slat, rp->clat);
+			for (h = 0; h < nhour; h++) {
+				n = ((size_t)h * ntx + i) * nrx + j;
+				evaluate(mpar, &path, h + hr1, &res);
+				if (res.best >= 0)
+					snr = res.f[res.best].dB2 -
+					    mpar->noise;
+				else
+					snr = NAN;
+				if (fmuf != NULL) {
+					fmuf[n] = res.muf;
+					fsnr[n] = snr;
+				} else {
+					mmuf[n] = res.muf;
+					msnr[n] = snr;
+				}
+			}
+		}
+	}
+}
+
+/*
+ * mlist(ob, title, list, n) - display station list
+ */
+static void
+mlist(
+	struct obuf *ob,	/* output buffer */
+	char *title,		/* title */
+	struct station *list,	/* station list */
+	int n			/* number of stations */
+	)
+{
+	int i;
+
+	obprintf(ob, "\n%s\n", title);
+	for (i = 0; i < n; i++) {
+		obint(ob, i + 1, 6);
+		obfix(ob, list[i].lat * R2D, 8, 2);
+		obputs(ob, "N ");
+		obfix(ob, list[i].lon * R2D, 7, 2);
+		obputs(ob, "W ");
+		obname(ob, list[i].name, list[i].namelen, 0);
+		obputc(ob, '\n');
+	}
+}
+
+/*
+ * mprint(ob, title, m, fm, n, hour, prec) - display matrix for one hour
+ *
+ * The matrix starts at index n of the double or, if that is NULL, the
+ * single-precision array. Rows are transmitters and columns receivers,
+ * numbered as in the station lists.
+ */
+static void
+mprint(
+	struct obuf *ob,	/* output buffer */
+	char *title,		/* title */
+	double *m,		/* matrices */
+	float *fm,		/* single-precision matrices */
+	size_t n,		/* matrix index */
+	int hour,		/* hour of day (UTC) */
+	int prec		/* digits after decimal point */
+	)
+{
+	double ftemp;		/* double temp */
+	int i, j;
+
+	obprintf(ob, "\nUT %2d %s\n", hour, title);
+	obputs(ob, "      ");
+	for (j = 0; j < nrx; j++)
+		obint(ob, j + 1, 6);
+	obputc(ob, '\n');
+	for (i = 0; i < ntx; i++) {
+		obint(ob, i + 1, 6);
+		for (j = 0; j < nrx; j++) {
+			if (m != NULL)
+				ftemp = m[n + (size_t)i * nrx + j];
+			else
+				ftemp = fm[n + (size_t)i * nrx + j];
+			if (isnan(ftemp))
+				obputs(ob, "     -");
+			else
+				obfix(ob, ftemp, 6, prec);
+		}
+		obputc(ob, '\n');
+	}
+}
+#endif /* _WIN32 */
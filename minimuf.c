@@ -23,15 +23,15 @@
 #include <ctype.h>
 #include <math.h>
 
-#define PI 3.141592653589	/* the real thing */
-#define PIH (PI / 2.)		/* the real thing / 2 */
-#define PID (PI * 2.)		/* the real thing * 2 */
-#define SGN(x) ((x==0.)?0.:((x>0.)?1.:-1.)) /* BASIC SGN function */
+#include "minimuf.h"
 
-double spots(double);
+#define SGN(x) ((x==0.)?0.:((x>0.)?1.:-1.)) /* BASIC SGN function */
 
 /*
  * MINIMUF 3.5 (From QST December 1982, originally in BASIC)
+ *
+ * The seasonal terms are looked up in the ephemeris table (see
+ * ephem.c).
  */
 double
 minimuf(
@@ -46,11 +46,12 @@ minimuf(
 	)
 
 {
+	struct ephem eph, *ep;	/* seasonal terms */
 	double ssn;		/* sunspot number dervived from flux */
 	double muf;		/* maximum usable frequency */
 	double dist;		/* path angle (rad) */
 	double a, p, q;		/* unfathomable local variables */
-	double y1, y2, y3;
+	double y2, y3;
 	double t, t4, t9;
 	double g0, g8;
 	double k1, k6, k8, k9;
@@ -74,8 +75,8 @@ minimuf(
 	p = sin(lat2);
 	q = cos(lat2);
 	a = (sin(lat1) - p * cos(dist)) / (q * sin(dist));
-	y1 = .0172 * (10. + (month - 1.) * 30.4 + day);
-	y2 = .409 * cos(y1);
+	ep = ephem(month, day, &eph);
+	y2 = ep->y2;
 	ftemp = 2.5 * dist / k6;
 	if (ftemp > PIH)
 		ftemp = PIH;
@@ -106,15 +107,14 @@ minimuf(
 			ftemp += PID;
 		if (ftemp >= PID)
 			ftemp -= PID;
-		ftemp = 3.82 * ftemp + 12. + .13 * (sin(y1) + 1.2 *
-		    sin(2. * y1));
+		ftemp = 3.82 * ftemp + 12. + ep->eot;
 		k8 = ftemp - 12. * (1. + SGN(ftemp - 24.)) *
 		    SGN(fabs(ftemp - 24.));
 		if (cos(y3 + y2) <= -.26) {
 			k9 = 0.;
 			g0 = 0.;
 		} else {
-			ftemp = (-.26 + sin(y2) * sin(y3)) / (cos(y2) *
+			ftemp = (-.26 + ep->sy2 * sin(y3)) / (ep->cy2 *
 			    cos(y3) + .001);
 			k9 = 12. - atan(ftemp / sqrt(fabs(1. - ftemp *
 			    ftemp))) * 7.639437;
@@ -0,0 +1,470 @@
+/*
+ * Common definitions for the minimuf program
+ */
+#include <stddef.h>
+
+#define R 6371.2		/* radius of the Earth (km) */
+#define hE 110.			/* mean height of E layer (km) */
+#define hF 320.			/* mean height of F layer (km) */
+#define GAMMA 1.42		/* geomagnetic constant */
+#define LN10 2.302585		/* natural logarithm of 10 */
+#define PI 3.141592653589	/* the real thing */
+#define PIH (PI / 2.)		/* the real thing / 2 */
+#define PID (PI * 2.)		/* the real thing * 2 */
+#define VOFL 2.9979250e8	/* velocity of light (m/s) */
+#define D2R (PI / 180.)		/* degrees to radians */
+#define R2D (180. / PI)		/* radians to degrees */
+#define MINBETA (10. * D2R)	/* min elevation angle (rad) */
+#define BOLTZ 1.380622e-23	/* Boltzmann's constant */
+#define NTEMP 290.		/* receiver noise temperature (K) */
+#define DELTAF 2500.		/* communication bandwidth (Hz) */
+#define MPATH 3.		/* multipath threshold (dB) */
+#define GLOSS 3.		/* ground-reflection loss (dB) */
+#define SLOSS 10.		/* excess system loss */
+#define RSENS -123.		/* receiver sensitivity (dBm) */
+#define NGAIN 5			/* antenna gain frequencies */
+#define FMAX 10			/* max frequencies */
+#define HMAX 30			/* hops with leftover state (see struct path) */
+#define OBSIZE 65536		/* output buffer size */
+
+/*
+ * Program flags (flags)
+ */
+#define H_FMT	0x0001		/* output format */
+#define H_MONTH	0x0002		/* month of year */
+#define H_DAY	0x0004		/* day of month */
+#define H_HOUR	0x0008		/* hour of day */
+#define H_FLUX	0x0010		/* 10-cm solar flux */
+#define H_POWER	0x0020		/* transmitter power */
+#define H_BETA	0x0040		/* minimum elevation angle */
+#define H_GAIN	0x0080		/* antenna gain table present */
+#define H_LONG	0x0100		/* use long path (default is short) */
+#define H_FLOAT	0x0200		/* single-precision batch geometry */
+#define H_APPROX 0x0400		/* table power-law and exp kernels */
+
+/*
+ * Path flags (daynight)
+ */
+#define P_J 0x01		/* hop in daytime */
+#define P_N 0x02		/* hop in nighttime */
+#define P_S 0x04		/* signal below sensitivity */
+#define P_E 0x08		/* E-layer cutoff */
+#define P_M 0x10		/* multipath */
+
+/*
+ * Timing stages (see timing.c)
+ */
+#define ST_PARSE 0		/* input parsing */
+#define ST_GEOM	1		/* path geometry */
+#define ST_MUF	2		/* minimuf() */
+#define ST_ION	3		/* ion() and zenith() */
+#define ST_LOSS	4		/* pathloss() and antgain() */
+#define ST_OUT	5		/* output formatting */
+#define NSTAGE	6		/* number of stages */
+
+#ifdef TIMING
+#define TSTART(s)	do { if (timing) tstart(s); } while (0)
+#define TSTOP(s)	do { if (timing) tstop(s); } while (0)
+#else /* TIMING */
+#define TSTART(s)
+#define TSTOP(s)
+#endif /* TIMING */
+
+/*
+ * Antenna gain table
+ */
+struct antenna {
+	double freq[NGAIN];	/* antenna gain frequencies (MHz) */
+	double gain[46][NGAIN];	/* antenna gain (main lobe) (dB) */
+};
+
+/*
+ * Prediction parameters. These are common to all paths in a run and
+ * are not changed once the input data have been read, except by a
+ * reload between batches of receivers (see reload.c).
+ */
+struct param {
+	double month;		/* month of year (1 - 12) */
+	double day;		/* day of month */
+	double flux;		/* 10-cm solar flux */
+	double ssn;		/* sunspot number (derived from flux) */
+	double dB1;		/* transmitter output power (dBW) */
+	double noise;		/* thermal noise (dBm) */
+	double minbeta;		/* minimum elevation angle (rad) */
+	int options;		/* option flags */
+	int nfreq;		/* number of frequencies */
+	double freq[FMAX];	/* working frequencies (MHz) */
+	struct antenna *ant;	/* antenna gain table (if H_GAIN) */
+};
+
+/*
+ * Site coordinates and name. The name is a view into the input data
+ * and is not terminated.
+ */
+struct site {
+	double lat, lon;	/* coordinates (deg N/E as read) */
+	char *name;		/* site name */
+	int namelen;		/* length of site name */
+	int line;		/* input line number */
+};
+
+/*
+ * Station data for modes with many paths. The sine and cosine of the
+ * latitude are computed once for each station.
+ */
+struct station {
+	double lat, lon;	/* coordinates (rad N/W) */
+	double slat, clat;	/* sine, cosine of latitude */
+	double slon, clon;	/* sine, cosine of longitude */
+	char *name;		/* site name */
+	int namelen;		/* length of site name */
+};
+
+/*
+ * Station catalog, one array for each quantity (see catalog.c)
+ */
+struct catalog {
+	int n;			/* number of stations */
+	int size;		/* allocated size */
+	double *lat, *lon;	/* coordinates (rad N/W) */
+	double *slat, *clat;	/* sine, cosine of latitude */
+	double *slon, *clon;	/* sine, cosine of longitude */
+};
+
+/*
+ * Path geometry for a batch of paths, one array for each quantity of
+ * struct path computed by pathgeom() (see catalog.c)
+ */
+struct gbatch {
+	int size;		/* max paths */
+	double *theta;		/* path angle (rad) */
+	double *d;		/* great-circle distance (rad) */
+	double *b1, *b2;	/* transmitter/receiver bearing (rad) */
+	double *dhop;		/* hop great-circle distance (rad) */
+	double *beta1;		/* min-hop elevation angle (rad) */
+	double *phiF;		/* F-layer angle of incidence (rad) */
+	double *delay;		/* path delay (ms) */
+	int *hop;		/* number of ray hops */
+};
+
+/*
+ * Input data (see input.c)
+ */
+struct input {
+	char *name;		/* file name for messages */
+	char *buf;		/* input data */
+	size_t len;		/* length of input data */
+	char *cp;		/* current position */
+	char *end;		/* end of input data */
+	int line;		/* current line number */
+	int mapped;		/* data are mapped */
+	int fd;			/* stream descriptor, -1 if not streaming */
+	int eof;		/* stream has ended */
+	size_t size;		/* stream buffer size */
+	char *tail;		/* end of data read from stream */
+	char *keep;		/* oldest stream data in use */
+	char *retired;		/* stream buffers to free on release */
+	struct image *img;	/* startup image, NULL if text */
+};
+
+/*
+ * Sites in a startup image (see image.c)
+ */
+struct image {
+	int n;			/* number of sites */
+	int next;		/* next site */
+	double *lat, *lon;	/* coordinates as read (deg N/E) */
+	int *line;		/* input line numbers */
+	int *name;		/* name offsets */
+	char *names;		/* names */
+	struct catalog cat;	/* coordinates and trig (rad N/W) */
+};
+
+/*
+ * Spatial index (see index.c)
+ */
+struct kdtree {
+	int n;			/* number of stations */
+	double (*v)[3];		/* unit vectors */
+	int *idx;		/* station permutation */
+	char *axis;		/* split axis */
+};
+
+/*
+ * Output buffer (see output.c)
+ */
+struct obuf {
+	int fd;			/* file descriptor */
+	int tty;		/* write each line */
+	int len;		/* bytes in buffer */
+	double mark;		/* time first block was buffered (s) */
+	char buf[OBSIZE];	/* buffer */
+};
+
+/*
+ * Solar ephemeris for one date (see ephem.c)
+ */
+struct ephem {
+	double lats;		/* subsolar latitude (rad) */
+	double slats, clats;	/* sine, cosine of subsolar latitude */
+	double y2;		/* MINIMUF solar declination (rad) */
+	double sy2, cy2;	/* sine, cosine of y2 */
+	double eot;		/* MINIMUF equation-of-time term (hours) */
+};
+
+/*
+ * Snapshot of the data that can be reloaded while running (see
+ * reload.c). A snapshot is not changed once published.
+ */
+struct snap {
+	struct snap *next;	/* next retired snapshot */
+	long gen;		/* generation */
+	long antgen;		/* generation of antenna table */
+	double flux;		/* 10-cm solar flux */
+	double ssn;		/* sunspot number (derived from flux) */
+	int gain;		/* antenna gain table present */
+	struct antenna ant;	/* antenna gain table */
+	struct site tx;		/* transmitter site (name follows) */
+};
+
+/*
+ * Lookup of one path and date in the precomputed tables (see table.c)
+ */
+struct tquery {
+	char *base;		/* hour records at lower flux level */
+	size_t stride;		/* bytes from one flux level to the next */
+	double w;		/* weight of upper flux level */
+	double d;		/* great-circle distance (rad) */
+};
+
+/*
+ * Bump arena for storage that lives as long as one query (see arena.c)
+ */
+struct arena {
+	struct ablock *head;	/* first block */
+	struct ablock *cur;	/* block in use (NULL if reset) */
+	char *next;		/* next free byte */
+	char *end;		/* end of block in use */
+	int warm;		/* arena has been reset after use */
+};
+
+/*
+ * Pool of fixed-size blocks (see arena.c)
+ */
+struct pool {
+	size_t size;		/* block size */
+	int nslab;		/* blocks per slab */
+	void *free;		/* free list */
+	int warm;		/* a block has been returned */
+};
+
+/*
+ * Hop state for the three hops considered by predict(), the min-hop
+ * path and the next two higher. Each quantity is an array indexed by
+ * hop number less the min hops, so the state for a path is a compact
+ * block that can be processed across the hops.
+ */
+struct hops {
+	double mufE[3];		/* maximum E-layer MUF (MHz) */
+	double mufF[3];		/* minimum F-layer MUF (MHz) */
+	double absorp[3];	/* ionospheric absorption coefficient */
+	double dB2[3];		/* receive power (dBm) */
+	double path[3];		/* path length (km) */
+	double beta[3];		/* elevation angle (rad) */
+	char daynight[3];	/* path flags */
+};
+
+/*
+ * Path state. The coordinates are set by the caller; everything else
+ * is computed by geometry() and predict(). The hop state for hops base
+ * to base + 2 is in hs. The original program kept the hop state in
+ * arrays indexed by absolute hop number, and the receive power, path
+ * length, elevation angle and flags left over in these arrays from
+ * earlier predictions show up in the multipath flag and output format
+ * 4. So that the results are the same, the hop state is copied to and
+ * from the leftover arrays below when the min hops change (see
+ * hopset()). These arrays are not used otherwise.
+ */
+struct path {
+	double lat1, lon1;	/* transmitter coordinates (rad N/W) */
+	double lat2, lon2;	/* receiver coordinates (rad N/W) */
+	double theta;		/* path angle (rad) */
+	double d;		/* great-circle distance (rad) */
+	double b1, b2;		/* transmitter/receiver bearing (rad) */
+	double dhop;		/* hop great-circle distance (rad) */
+	double beta1;		/* min-hop elevation angle (rad) */
+	double phiF;		/* F-layer angle of incidence (rad) */
+	double delay;		/* path delay (ms) */
+	int hop;		/* number of ray hops */
+	double lats, lons;	/* subsolar coordinates (rad) */
+	double slats, clats;	/* sine, cosine of subsolar latitude */
+	double psi;		/* sun zenith angle at midpoint (rad) */
+	int base;		/* min hops for hs (0 if none) */
+	struct hops hs;		/* hop state */
+	double dB2[HMAX];	/* leftover receive power (dBm) */
+	double path[HMAX];	/* leftover path length (km) */
+	double beta[HMAX];	/* leftover elevation angle (rad) */
+	char daynight[HMAX];	/* leftover path flags */
+};
+
+/*
+ * Path descriptor for one frequency
+ */
+struct cell {
+	int hop;		/* hop number (0 if no path) */
+	double dB2;		/* receive power (dBm) */
+	double beta;		/* elevation angle (rad) */
+	double path;		/* path length (km) */
+	int flags;		/* path flags */
+};
+
+/*
+ * Prediction for one hour
+ */
+struct result {
+	double hour;		/* hour of day (UTC) */
+	double muf;		/* F-layer MUF of min-hop path (MHz) */
+	double psi;		/* sun zenith angle at midpoint (rad) */
+	int hop;		/* number of ray hops */
+	int best;		/* best frequency index (-1 if none) */
+	int bhop;		/* hop number of best frequency */
+	struct cell f[FMAX];	/* path descriptor for each frequency */
+};
+
+/*
+ * Prediction kernel. Each kernel computes the geometry of the path
+ * given the coordinates and then the prediction for the given hour.
+ */
+struct kernel {
+	char *name;		/* kernel name */
+	void (*eval)(struct param *, struct path *, double,
+	    struct result *);	/* evaluation routine */
+	double tol[4];		/* default tolerances (see verify.c) */
+};
+
+/*
+ * Global function declarations
+ */
+extern double minimuf(double, double, double, double, double, double,
+    double, double);
+extern double spots(double);
+extern void ephinit(void);
+extern void xinit(void);
+extern double xpow25(double);
+extern double xpow13(double);
+extern double xpow198(double);
+extern double xexp(double);
+extern struct ephem *ephem(double, double, struct ephem *);
+extern void geometry(struct param *, struct path *);
+extern void pathgeom(struct param *, struct path *, double, double,
+    double, double);
+extern int catadd(struct catalog *, double, double);
+extern int gbinit(struct gbatch *, int);
+extern void catgeom(struct param *, struct station *, struct catalog *,
+    int, int, struct gbatch *);
+extern void catpath(struct gbatch *, int, struct path *);
+extern void subsolar(struct param *, struct path *, double);
+extern double pathzenith(struct path *, double);
+extern void hopset(struct path *);
+extern void hopcell(struct path *, int, struct cell *);
+extern void evaluate(struct param *, struct path *, double,
+    struct result *);
+extern void evalmuf(struct param *, struct path *, double, double,
+    struct result *);
+extern void evalsun(struct param *, struct path *, double, double,
+    struct result *);
+extern void dhead(struct obuf *, struct path *, struct site *);
+extern void dhour(struct obuf *, struct path *, struct result *,
+    struct cell *);
+extern void ref_evaluate(struct param *, struct path *, double,
+    struct result *);
+extern int verify(char *, char *);
+extern int cinit(char *);
+extern void cevaluate(struct param *, struct path *, double,
+    struct result *);
+extern void cflush(void);
+extern int rinit(char *, char *, struct param *, struct site *);
+extern struct snap *rpin(int);
+extern void runpin(int);
+extern int imbuild(struct param *, struct input *, struct site *, int,
+    char *);
+extern int imopen(struct input *, char *, struct param *, int *);
+extern int imsite(struct image *, struct site *);
+extern int tabbuild(struct param *, struct input *, struct site *,
+    char *);
+extern int tabopen(char *);
+extern int tabfind(struct param *, struct path *, struct tquery *);
+extern int tabget(struct tquery *, double, struct result *,
+    struct cell *);
+extern int matrix(struct param *, struct input *, struct site *,
+    char *, int, int, int, struct obuf *);
+extern int reverse(struct param *, struct input *, struct site *,
+    char *, int, int, struct obuf *);
+extern int search(struct param *, struct input *, struct site *, int,
+    int, int, int, struct obuf *);
+extern int dual(struct param *, struct input *, struct site *, int,
+    int, struct obuf *);
+extern int loran(struct input *, struct site *, char *, struct obuf *);
+extern int delta(struct param *, struct input *, struct site *, char *,
+    int, int, struct obuf *);
+extern int pipeline(struct param *, struct input *, struct site *, int,
+    int, int, int, int, struct obuf *);
+extern double bmuf(struct param *, struct path *);
+extern double bgain(struct param *);
+extern double babsorp(struct param *, struct path *, double);
+extern double bpower(struct param *, struct path *, double, double,
+    double);
+extern double bhour(struct param *, struct path *, double, double,
+    double);
+extern struct arena *athread(void);
+extern void *aalloc(struct arena *, size_t);
+extern void *arealloc(struct arena *, void *, size_t, size_t);
+extern void areset(struct arena *);
+extern int asort(struct arena *, void *, size_t, size_t,
+    int (*)(const void *, const void *));
+extern int pinit(struct pool *, size_t, int);
+extern void *pget(struct pool *);
+extern void pput(struct pool *, void *);
+extern void ainit(void);
+extern void tinit(int);
+extern void tstart(int);
+extern void tstop(int);
+extern int inopen(struct input *, char *);
+extern int instream(struct input *, char *);
+extern int inready(struct input *);
+extern void inrelease(struct input *);
+extern void inclose(struct input *);
+extern int indouble(struct input *, double *);
+extern int inint(struct input *, int *);
+extern int inname(struct input *, struct site *);
+extern int insite(struct input *, struct site *);
+extern int insave(struct site *);
+extern int inlist(struct input *, struct station **, int *);
+extern void instation(struct station *, struct site *);
+extern void inerr(struct input *, char *);
+extern int kdbuild(struct kdtree *, struct site *, int);
+extern int kdrange(struct kdtree *, double, double, double, double,
+    int *);
+extern int kdnear(struct kdtree *, double, double, int, int *);
+extern void obinit(struct obuf *, int);
+extern int obflush(struct obuf *);
+extern int obmark(struct obuf *, double);
+extern void obputc(struct obuf *, int);
+extern void obputs(struct obuf *, char *);
+extern void obname(struct obuf *, char *, int, int);
+extern void obint(struct obuf *, int, int);
+extern void obfix(struct obuf *, double, int, int);
+extern void obprintf(struct obuf *, char *, ...);
+extern void trinit(char *);
+extern void trname(char *);
+extern double tbegin(void);
+extern void tend(char *, char *, double, long);
+
+/*
+ * Global data
+ */
+extern __thread int timing;	/* timing level (0: off) */
+extern int tracing;		/* tracing enabled */
+extern int caching;		/* cache enabled */
+extern int stats;		/* display statistics at exit (-T) */
+extern struct antenna antenna;	/* antenna gain table from file */
@@ -0,0 +1,332 @@
+/*
+ * Buffered output writer
+ *
+ * The prediction tables are formatted into a large buffer and written
+ * with one write() call when the buffer fills, rather than with one
+ * printf() per column. Fixed-point numbers are formatted by obfix(),
+ * which produces the same text as printf("%*.*f") and is much faster
+ * for the small numbers found in the tables. Numbers near a rounding
+ * tie, large numbers, infinities and NaNs are passed to snprintf(), so
+ * the result is always the same as the library would produce.
+ *
+ * Each thread that writes output has its own buffer. When the output
+ * is a terminal, the buffer is written at the end of every line, as
+ * with the standard library. In stream mode, obmark() writes the buffer
+ * when it has held a complete block for long enough (see shell.c).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <time.h>
+#endif /* _WIN32 */
+
+#include "minimuf.h"
+
+#define OBMAX	400		/* longest single item (see obfix()) */
+
+/*
+ * Powers of ten for obfix()
+ */
+static const double scale[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6
+};
+
+/*
+ * Local function declarations
+ */
+static void obroom(struct obuf *, int);
+
+/*
+ * obinit(ob, fd) - initialize output buffer
+ */
+void
+obinit(
+	struct obuf *ob,	/* output buffer */
+	int fd			/* file descriptor */
+	)
+{
+	ob->fd = fd;
+	ob->len = 0;
+	ob->mark = 0;
+#ifndef _WIN32
+	ob->tty = isatty(fd);
+#else /* _WIN32 */
+	ob->tty = 0;
+#endif /* _WIN32 */
+}
+
+/*
+ * obflush(ob) - write buffer contents
+ *
+ * Returns 0 if all went well, -1 if the write failed.
+ */
+int
+obflush(
+	struct obuf *ob		/* output buffer */
+	)
+{
+	char *cp;		/* character pointer */
+	int len;		/* bytes remaining */
+	int n;			/* bytes written */
+
+	cp = ob->buf;
+	len = ob->len;
+	ob->len = 0;
+	ob->mark = 0;
+	while (len > 0) {
+#ifndef _WIN32
+		n = write(ob->fd, cp, len);
+#else /* _WIN32 */
+		n = fwrite(cp, 1, len, stdout);
+		fflush(stdout);
+#endif /* _WIN32 */
+		if (n <= 0)
+			return (-1);
+		cp += n;
+		len -= n;
+	}
+	return (0);
+}
+
+#ifndef _WIN32
+/*
+ * obmark(ob, bound) - end of output block
+ *
+ * The buffer is written when the oldest block in it was completed at
+ * least bound seconds ago, so with a bound of zero every block is
+ * written as soon as it is complete. Returns as obflush().
+ */
+int
+obmark(
+	struct obuf *ob,	/* output buffer */
+	double bound		/* latency bound (s) */
+	)
+{
+	struct timespec ts;
+	double now;		/* time (s) */
+
+	if (ob->len == 0)
+		return (0);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now = ts.tv_sec + ts.tv_nsec / 1e9;
+	if (ob->mark == 0)
+		ob->mark = now;
+	if (now - ob->mark >= bound)
+		return (obflush(ob));
+	return (0);
+}
+#endif /* _WIN32 */
+
+/*
+ * obputc(ob, c) - write character
+ */
+void
+obputc(
+	struct obuf *ob,	/* output buffer */
+	int c			/* character */
+	)
+{
+	obroom(ob, 1);
+	ob->buf[ob->len++] = c;
+	if (c == '\n' && ob->tty)
+		obflush(ob);
+}
+
+/*
+ * obputs(ob, s) - write string
+ */
+void
+obputs(
+	struct obuf *ob,	/* output buffer */
+	char *s			/* string */
+	)
+{
+	obname(ob, s, strlen(s), 0);
+	if (ob->tty && strchr(s, '\n') != NULL)
+		obflush(ob);
+}
+
+/*
+ * obname(ob, s, len, width) - write string left justified in field
+ *
+ * This is printf("%-*.*s", width, len, s), which is used for the site
+ * names. The string need not be terminated.
+ */
+void
+obname(
+	struct obuf *ob,	/* output buffer */
+	char *s,		/* string */
+	int len,		/* string length */
+	int width		/* field width */
+	)
+{
+	int n;			/* bytes this time */
+
+	while (len > 0) {
+		n = len < OBSIZE / 2 ? len : OBSIZE / 2;
+		obroom(ob, n);
+		memcpy(&ob->buf[ob->len], s, n);
+		ob->len += n;
+		s += n;
+		len -= n;
+		width -= n;
+	}
+	if (width > 0) {
+		obroom(ob, width);
+		memset(&ob->buf[ob->len], ' ', width);
+		ob->len += width;
+	}
+}
+
+/*
+ * obint(ob, n, width) - write integer
+ *
+ * This is printf("%*i", width, n).
+ */
+void
+obint(
+	struct obuf *ob,	/* output buffer */
+	int n,			/* number */
+	int width		/* field width */
+	)
+{
+	char digits[12];	/* digits (reversed) */
+	unsigned int u;		/* magnitude */
+	int ndig;		/* number of digits */
+	char *cp;		/* character pointer */
+
+	obroom(ob, OBMAX);
+	u = n < 0 ? -(unsigned int)n : (unsigned int)n;
+	ndig = 0;
+	do {
+		digits[ndig++] = '0' + u % 10;
+		u /= 10;
+	} while (u > 0);
+	cp = &ob->buf[ob->len];
+	for (width -= ndig + (n < 0); width > 0; width--)
+		*cp++ = ' ';
+	if (n < 0)
+		*cp++ = '-';
+	while (ndig > 0)
+		*cp++ = digits[--ndig];
+	ob->len = cp - ob->buf;
+}
+
+/*
+ * obfix(ob, x, width, prec) - write fixed-point number
+ *
+ * This is printf("%*.*f", width, prec, x). The number is scaled by
+ * 10^prec and rounded to an integer. The scaled value is in error by
+ * less than 1e-7 when it is less than 1e9, so unless the fraction is
+ * within 1e-6 of one-half, the rounding is the same as the library
+ * rounding of the exact value. Anything else goes to snprintf().
+ */
+void
+obfix(
+	struct obuf *ob,	/* output buffer */
+	double x,		/* number */
+	int width,		/* field width */
+	int prec		/* digits after decimal point */
+	)
+{
+	char digits[24];	/* digits (reversed) */
+	unsigned long n;	/* scaled value */
+	double y, frac;		/* double temps */
+	int i, ndig, neg;	/* int temps */
+	char *cp;		/* character pointer */
+
+	obroom(ob, OBMAX);
+	if (prec < 0 || prec > 6 || !isfinite(x))
+		goto slow;
+	y = fabs(x) * scale[prec];
+	if (y >= 1e9)
+		goto slow;
+	n = (unsigned long)y;
+	frac = y - n;
+	if (fabs(frac - .5) < 1e-6)
+		goto slow;
+	if (frac > .5)
+		n++;
+
+	/*
+	 * Generate the digits, least significant first, with at least
+	 * one digit before the decimal point.
+	 */
+	ndig = 0;
+	do {
+		digits[ndig++] = '0' + n % 10;
+		n /= 10;
+	} while (n > 0);
+	while (ndig <= prec)
+		digits[ndig++] = '0';
+	neg = signbit(x) != 0;
+	i = ndig + neg + (prec > 0);
+	cp = &ob->buf[ob->len];
+	for (; i < width; i++)
+		*cp++ = ' ';
+	if (neg)
+		*cp++ = '-';
+	while (ndig > prec)
+		*cp++ = digits[--ndig];
+	if (prec > 0) {
+		*cp++ = '.';
+		while (ndig > 0)
+			*cp++ = digits[--ndig];
+	}
+	ob->len = cp - ob->buf;
+	return;
+
+	/*
+	 * Hard cases
+	 */
+slow:
+	ob->len += snprintf(&ob->buf[ob->len], OBMAX, "%*.*f", width,
+	    prec, x);
+}
+
+/*
+ * obprintf(ob, fmt, ...) - write formatted text
+ *
+ * This is for headings and other things that are not in the inner
+ * loops. The text must be shorter than OBSIZE / 2.
+ */
+void
+obprintf(
+	struct obuf *ob,	/* output buffer */
+	char *fmt,		/* format */
+	...
+	)
+{
+	va_list ap;		/* argument pointer */
+	int n;			/* length */
+
+	obroom(ob, OBSIZE / 2);
+	va_start(ap, fmt);
+	n = vsnprintf(&ob->buf[ob->len], OBSIZE / 2, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return;
+	if (n >= OBSIZE / 2)
+		n = OBSIZE / 2 - 1;
+	ob->len += n;
+	if (ob->tty && memchr(&ob->buf[ob->len - n], '\n', n) != NULL)
+		obflush(ob);
+}
+
+/*
+ * obroom(ob, n) - make room for n more bytes
+ */
+static void
+obroom(
+	struct obuf *ob,	/* output buffer */
+	int n			/* bytes needed */
+	)
+{
+	if (ob->len + n > OBSIZE)
+		obflush(ob);
+}
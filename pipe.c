@@ -0,0 +1,561 @@
+/*
+ * Pipelined prediction tables
+ *
+ * When enabled by the -P option, the prediction tables are produced by
+ * three stages running at the same time: a parser thread reads the
+ * receivers from the input data, a pool of worker threads computes the
+ * path geometry and predictions, and the main thread formats the tables
+ * and writes them in input order. The run takes about as long as the
+ * slowest stage rather than the sum of all three.
+ *
+ * The stages pass chunks of PCHUNK receivers through a ring of slots,
+ * each of which holds the receivers of one chunk and their predictions.
+ * The ring is bounded and lock-free: a slot passes from the parser to a
+ * worker, to the writer and back to the parser by a state word, which
+ * is stored with release and loaded with acquire ordering, and the
+ * workers take the chunks in turn from an atomic counter. A stage with
+ * nothing to do spins for a while, then yields the processor.
+ *
+ * The original program carries the receive power of a hop over from
+ * the previous hour, and so from the previous receiver, into the
+ * multipath test when the hop is unusable at a frequency, and output
+ * format 4 carries the hop of the best path over from the previous
+ * line. A worker cannot know what was carried over. It saves the hop
+ * state of each line that uses the carried hop, so the writer can find
+ * the path descriptor, and notes each receiver whose multipath test
+ * could have used the carried receive power. The writer keeps the path
+ * state of the sequential program, updates it from each receiver and
+ * computes the noted receivers again with it, so the tables are the
+ * same as without -P.
+ *
+ * The prediction cache, the receiver queries and stream mode use the
+ * sequential program.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+
+#define PCHUNK	32		/* receivers per chunk */
+#define NTHREAD	64		/* max worker threads */
+#define NSPIN	1000		/* spins before yielding */
+
+/*
+ * Slot states
+ */
+#define Q_FREE	0		/* waiting for parser */
+#define Q_READY	1		/* waiting for worker */
+#define Q_DONE	2		/* waiting for writer */
+
+/*
+ * Receiver state after the last hour
+ */
+struct pstate {
+	struct path path;	/* path state */
+	int known;		/* hops with receive power known */
+	int j;			/* format 4 hop (-1 if carried over) */
+	int redo;		/* compute again with carried state */
+};
+
+/*
+ * Hop state for a format 4 line with the carried hop
+ */
+struct pline {
+	struct cell win[3];	/* path descriptors of the three hops */
+	int known;		/* hops with receive power known */
+};
+
+/*
+ * Ring slot
+ */
+struct slot {
+	int state;		/* slot state */
+	long seq;		/* chunk number */
+	int n;			/* number of receivers */
+	struct site site[PCHUNK]; /* receivers */
+	struct pstate ps[PCHUNK]; /* receiver states */
+	struct result *res;	/* predictions [PCHUNK][nhour] */
+	struct cell *cell;	/* format 4 descriptors [PCHUNK][nhour] */
+	struct pline *line;	/* format 4 hop states [PCHUNK][nhour] */
+};
+
+/*
+ * Worker scratch state
+ */
+struct pwork {
+	struct catalog cat;	/* chunk receivers */
+	struct gbatch gb;	/* chunk geometry */
+};
+
+/*
+ * Pipeline data, shared by the threads. None of these are changed
+ * while the threads are running, except for the slots, the next chunk
+ * number and the parser status.
+ */
+static struct param *ppar;	/* prediction parameters */
+static struct input *pin;	/* input data */
+static struct station ptx;	/* transmitter */
+static int fast;		/* batch geometry usable */
+static int hr1, nhour;		/* first hour, number of hours */
+static int pfmt;		/* output format */
+static struct slot *ring;	/* slots */
+static int nslot;		/* number of slots */
+static long pnext;		/* next chunk for workers */
+static long pend;		/* number of chunks */
+static int prval;		/* parser status */
+static int pdone;		/* parser done */
+
+static long nrx;		/* receivers */
+static long nchunk;		/* chunks */
+static long nredo;		/* receivers computed again */
+
+/*
+ * Local function declarations
+ */
+static void *pparse(void *);
+static void *pworker(void *);
+static void pchunk(struct slot *, struct pwork *);
+static void pwrite(struct obuf *, struct slot *, int, struct path *,
+    int *);
+static int prun(struct path *, int *, int *, struct result *,
+    struct cell *, struct pline *);
+static void pcopy(struct path *, struct path *);
+static void pspin(int *);
+static void pstats(void);
+
+/*
+ * pipeline(par, ip, tx, nthread, h1, h2, fmt, hop, ob) - pipeline mode
+ *
+ * The input data have been read up to and including the transmitter,
+ * and hop is the format 4 hop as the main program leaves it before the
+ * first receiver. Returns the program exit status.
+ */
+int
+pipeline(
+	struct param *pp,	/* prediction parameters */
+	struct input *ip,	/* input data */
+	struct site *tx,	/* transmitter in input data */
+	int nthread,		/* number of worker threads */
+	int h1,			/* first hour */
+	int h2,			/* last hour */
+	int fmt,		/* output format */
+	int hop,		/* format 4 hop before first receiver */
+	struct obuf *ob		/* output buffer */
+	)
+{
+	pthread_t tid[NTHREAD + 1]; /* parser and worker threads */
+	struct pool rpool, cpool, lpool; /* slot block pools */
+	struct pwork *work;	/* worker scratch */
+	struct slot *sp;	/* slot pointer */
+	struct path path;	/* sequential path state */
+	double t_out;		/* chunk span start */
+	long c;			/* chunk number */
+	int nwork;		/* worker threads started */
+	int i, j, k, spin;
+
+	ppar = pp;
+	pin = ip;
+	instation(&ptx, tx);
+	fast = pp->minbeta > 0 && pp->minbeta < PIH;
+	hr1 = h1;
+	nhour = h2 - h1 + 1;
+	pfmt = fmt;
+	if (nthread < 1)
+		nthread = 1;
+	if (nthread > NTHREAD)
+		nthread = NTHREAD;
+
+	/*
+	 * Allocate the slots and the worker scratch. The result blocks
+	 * of the slots come from pools with a slab of one block for each
+	 * slot, and the catalogs are grown to full size here, so the
+	 * workers never allocate.
+	 */
+	nslot = 4 * nthread;
+	ring = calloc(nslot, sizeof(struct slot));
+	work = calloc(nthread, sizeof(struct pwork));
+	if (ring == NULL || work == NULL) {
+		fprintf(stderr, "minimuf: no memory for pipeline\n");
+		return (1);
+	}
+	if (pinit(&rpool, (size_t)PCHUNK * nhour * sizeof(struct result),
+	    nslot) < 0 || pinit(&cpool, (size_t)PCHUNK * nhour *
+	    sizeof(struct cell), nslot) < 0 || pinit(&lpool, (size_t)PCHUNK *
+	    nhour * sizeof(struct pline), nslot) < 0) {
+		fprintf(stderr, "minimuf: no memory for pipeline\n");
+		return (1);
+	}
+	for (i = 0; i < nslot; i++) {
+		sp = &ring[i];
+		sp->res = pget(&rpool);
+		sp->cell = pget(&cpool);
+		sp->line = pget(&lpool);
+	}
+	for (i = 0; i < nthread; i++) {
+		if (catadd(&work[i].cat, 0, 0) < 0 || gbinit(&work[i].gb,
+		    PCHUNK) < 0)
+			return (1);
+	}
+	if (stats)
+		atexit(pstats);
+
+	/*
+	 * Start the parser and the workers.
+	 */
+	if (pthread_create(&tid[0], NULL, pparse, NULL) != 0) {
+		fprintf(stderr, "minimuf: cannot start parser\n");
+		return (1);
+	}
+	for (nwork = 0; nwork < nthread; nwork++) {
+		if (pthread_create(&tid[nwork + 1], NULL, pworker,
+		    &work[nwork]) != 0)
+			break;
+	}
+	if (nwork == 0) {
+		fprintf(stderr, "minimuf: cannot start workers\n");
+		return (1);
+	}
+
+	/*
+	 * Writer. The path state is that of the sequential program,
+	 * which is updated from each receiver in turn, and j is the
+	 * format 4 hop left over from the previous line.
+	 */
+	memset(&path, 0, sizeof(path));
+	j = hop;
+	for (c = 0; ; c++) {
+		sp = &ring[c % nslot];
+		spin = 0;
+		while (__atomic_load_n(&sp->state, __ATOMIC_ACQUIRE) !=
+		    Q_DONE || sp->seq != c) {
+			if (__atomic_load_n(&pdone, __ATOMIC_ACQUIRE) && c >=
+			    pend)
+				break;
+			pspin(&spin);
+		}
+		if (__atomic_load_n(&pdone, __ATOMIC_ACQUIRE) && c >= pend)
+			break;
+		t_out = tbegin();
+		TSTART(ST_OUT);
+		for (k = 0; k < sp->n; k++)
+			pwrite(ob, sp, k, &path, &j);
+		TSTOP(ST_OUT);
+		nrx += sp->n;
+		nchunk++;
+		__atomic_store_n(&sp->state, Q_FREE, __ATOMIC_RELEASE);
+		tend("output", "pipeline", t_out, c);
+	}
+	for (i = 0; i <= nwork; i++)
+		pthread_join(tid[i], NULL);
+	if (obflush(ob) < 0)
+		return (1);
+	return (prval < 0);
+}
+
+/*
+ * pwrite(ob, sp, k, p, j) - display one receiver
+ *
+ * The path state and format 4 hop are those of the sequential program
+ * before the receiver, and are updated as it would update them. The
+ * hop state after the move to the min hops of the receiver holds the
+ * carried receive power, which is kept for the hops the worker did
+ * not compute.
+ */
+static void
+pwrite(
+	struct obuf *ob,	/* output buffer */
+	struct slot *sp,	/* slot */
+	int k,			/* receiver in slot */
+	struct path *p,		/* sequential path state */
+	int *j			/* format 4 hop */
+	)
+{
+	struct pstate *ps;	/* receiver state */
+	struct path *wp;	/* worker path state */
+	struct result *res;	/* predictions */
+	struct cell *cell;	/* format 4 descriptors */
+	struct pline *line;	/* format 4 hop states */
+	double dB2[3];		/* carried receive power (dBm) */
+	int carried;		/* format 4 hop carried over */
+	int i, n;
+
+	ps = &sp->ps[k];
+	wp = &ps->path;
+	res = &sp->res[k * nhour];
+	cell = &sp->cell[k * nhour];
+	line = &sp->line[k * nhour];
+	pcopy(p, wp);
+	if (ps->redo) {
+		nredo++;
+		prun(p, j, NULL, res, cell, NULL);
+	} else {
+		hopset(p);
+		for (i = 0; i < 3; i++) {
+			dB2[i] = p->hs.dB2[i];
+			if (ps->known & 1 << i)
+				p->hs.dB2[i] = wp->hs.dB2[i];
+			p->hs.mufE[i] = wp->hs.mufE[i];
+			p->hs.mufF[i] = wp->hs.mufF[i];
+			p->hs.absorp[i] = wp->hs.absorp[i];
+			p->hs.path[i] = wp->hs.path[i];
+			p->hs.beta[i] = wp->hs.beta[i];
+			p->hs.daynight[i] = wp->hs.daynight[i];
+		}
+
+		/*
+		 * Until the first line with a usable frequency, format 4
+		 * shows the carried hop, which is one of the three hops of
+		 * the receiver or else one of the leftover hops, which
+		 * the receiver does not change.
+		 */
+		carried = 1;
+		for (n = 0; n < nhour && pfmt == 4; n++) {
+			if (res[n].best >= 0) {
+				carried = 0;
+				*j = res[n].bhop;
+			}
+			if (!carried)
+				continue;
+			i = *j - p->hop;
+			if (i >= 0 && i < 3) {
+				cell[n] = line[n].win[i];
+				if (~line[n].known & 1 << i)
+					cell[n].dB2 = dB2[i];
+			} else {
+				hopcell(p, *j, &cell[n]);
+			}
+		}
+	}
+	if (pfmt < 4)
+		dhead(ob, p, &sp->site[k]);
+	for (n = 0; n < nhour; n++)
+		dhour(ob, p, &res[n], &cell[n]);
+}
+
+/*
+ * pparse(arg) - parser thread
+ *
+ * This fills the slots in turn with chunks of receivers until the end
+ * of the input data.
+ */
+static void *
+pparse(
+	void *arg		/* not used */
+	)
+{
+	struct slot *sp;	/* slot pointer */
+	long c;			/* chunk number */
+	int rval, spin;
+
+	(void)arg;
+	trname("parser");
+	rval = 1;
+	for (c = 0; rval > 0; c++) {
+		sp = &ring[c % nslot];
+		spin = 0;
+		while (__atomic_load_n(&sp->state, __ATOMIC_ACQUIRE) !=
+		    Q_FREE)
+			pspin(&spin);
+		sp->n = 0;
+		while (sp->n < PCHUNK && (rval = insite(pin,
+		    &sp->site[sp->n])) > 0)
+			sp->n++;
+		if (sp->n == 0)
+			break;
+		sp->seq = c;
+		__atomic_store_n(&sp->state, Q_READY, __ATOMIC_RELEASE);
+	}
+	pend = c;
+	prval = rval;
+	__atomic_store_n(&pdone, 1, __ATOMIC_RELEASE);
+	return (NULL);
+}
+
+/*
+ * pworker(arg) - worker thread
+ *
+ * This takes the next chunk until there are none left.
+ */
+static void *
+pworker(
+	void *arg		/* worker scratch */
+	)
+{
+	struct slot *sp;	/* slot pointer */
+	double t_chunk;		/* chunk span start */
+	long c;			/* chunk number */
+	int spin;
+
+	trname("worker");
+	for (;;) {
+		c = __atomic_fetch_add(&pnext, 1, __ATOMIC_RELAXED);
+		sp = &ring[c % nslot];
+		spin = 0;
+		while (__atomic_load_n(&sp->state, __ATOMIC_ACQUIRE) !=
+		    Q_READY || sp->seq != c) {
+			if (__atomic_load_n(&pdone, __ATOMIC_ACQUIRE) && c >=
+			    pend)
+				return (NULL);
+			pspin(&spin);
+		}
+		t_chunk = tbegin();
+		pchunk(sp, arg);
+		tend("chunk", "pipeline", t_chunk, c);
+		__atomic_store_n(&sp->state, Q_DONE, __ATOMIC_RELEASE);
+	}
+}
+
+/*
+ * pchunk(sp, w) - compute one chunk
+ *
+ * Each receiver starts from a clean path state, with the carried-over
+ * receive power of every hop unknown.
+ */
+static void
+pchunk(
+	struct slot *sp,	/* slot */
+	struct pwork *w		/* worker scratch */
+	)
+{
+	struct pstate *ps;	/* receiver state */
+	struct path *p;		/* path state */
+	int k;
+
+	w->cat.n = 0;
+	for (k = 0; k < sp->n; k++)
+		catadd(&w->cat, sp->site[k].lat * D2R, -sp->site[k].lon *
+		    D2R);
+	if (fast)
+		catgeom(ppar, &ptx, &w->cat, 0, sp->n, &w->gb);
+	for (k = 0; k < sp->n; k++) {
+		ps = &sp->ps[k];
+		p = &ps->path;
+		memset(p, 0, sizeof(struct path));
+		p->lat1 = ptx.lat;
+		p->lon1 = ptx.lon;
+		p->lat2 = sp->site[k].lat * D2R;
+		p->lon2 = -sp->site[k].lon * D2R;
+		if (fast)
+			catpath(&w->gb, k, p);
+		else
+			geometry(ppar, p);
+		ps->known = 0;
+		ps->j = -1;
+		ps->redo = prun(p, &ps->j, &ps->known, &sp->res[k * nhour],
+		    &sp->cell[k * nhour], &sp->line[k * nhour]);
+	}
+}
+
+/*
+ * prun(p, j, known, res, cell, line) - compute the hours for one receiver
+ *
+ * If known is not NULL, it has a bit for each hop of the path state
+ * whose receive power has been computed for this receiver. The bits
+ * are updated as in pathloss(), which computes the receive power of
+ * the hops below the MUF for each frequency, then compares the best
+ * with the others. While the format 4 hop is carried over, the hop
+ * state of each line is saved instead of the path descriptor. Returns
+ * 1 if the multipath test used an unknown receive power, otherwise 0.
+ */
+static int
+prun(
+	struct path *p,		/* path state */
+	int *j,			/* format 4 hop (-1 if carried over) */
+	int *known,		/* hops with receive power known */
+	struct result *res,	/* predictions */
+	struct cell *cell,	/* format 4 descriptors */
+	struct pline *line	/* format 4 hop states */
+	)
+{
+	struct result *r;	/* prediction for one hour */
+	int use;		/* hops below the MUF */
+	int redo;		/* carried state used */
+	int i, k, n;
+
+	redo = 0;
+	for (n = 0; n < nhour; n++) {
+		r = &res[n];
+		evaluate(ppar, p, hr1 + n, r);
+		if (known != NULL) {
+			for (k = 0; k < ppar->nfreq; k++) {
+				use = 0;
+				for (i = 0; i < 3; i++) {
+					if (ppar->freq[k] < 0.85 *
+					    p->hs.mufF[i])
+						use |= 1 << i;
+				}
+				if (r->f[k].hop != 0 && ~use & ~*known & 7 &
+				    ~(1 << (r->f[k].hop - p->hop)))
+					redo = 1;
+				*known |= use;
+			}
+		}
+		if (pfmt == 4) {
+			if (r->best >= 0)
+				*j = r->bhop;
+			if (*j >= 0) {
+				hopcell(p, *j, &cell[n]);
+			} else {
+				for (i = 0; i < 3; i++)
+					hopcell(p, p->hop + i,
+					    &line[n].win[i]);
+				line[n].known = *known;
+			}
+		}
+	}
+	return (redo);
+}
+
+/*
+ * pcopy(dst, src) - copy path geometry
+ */
+static void
+pcopy(
+	struct path *dst,	/* path state */
+	struct path *src	/* path geometry */
+	)
+{
+	dst->lat1 = src->lat1;
+	dst->lon1 = src->lon1;
+	dst->lat2 = src->lat2;
+	dst->lon2 = src->lon2;
+	dst->theta = src->theta;
+	dst->d = src->d;
+	dst->b1 = src->b1;
+	dst->b2 = src->b2;
+	dst->dhop = src->dhop;
+	dst->beta1 = src->beta1;
+	dst->phiF = src->phiF;
+	dst->delay = src->delay;
+	dst->hop = src->hop;
+}
+
+/*
+ * pspin(n) - wait for another stage
+ */
+static void
+pspin(
+	int *n			/* spins so far */
+	)
+{
+	if (++*n > NSPIN)
+		sched_yield();
+}
+
+/*
+ * pstats() - display pipeline statistics on stderr
+ */
+static void
+pstats(void)
+{
+	fprintf(stderr,
+	    "pipeline: %ld receivers, %ld chunks, %ld computed again\n",
+	    nrx, nchunk, nredo);
+}
+#endif /* _WIN32 */
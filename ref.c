@@ -0,0 +1,520 @@
+/*
+ * Reference prediction kernel
+ *
+ * This is the original program logic, kept as it was before any
+ * performance work, using its own private copies of the global path
+ * variables and of minimuf(). It is used only by the verify mode to
+ * check the other kernels and should not be changed.
+ *
+ * The one departure is in antgain(), which searches the gain table
+ * frequencies only up to NGAIN. The original searched up to the number
+ * of prediction frequencies, which can be more, and so read past the
+ * end of the table. The reference includes this fix, so the verify
+ * mode does not check it.
+ */
+#include <math.h>
+
+#include "minimuf.h"
+
+#define SGN(x) ((x==0.)?0.:((x>0.)?1.:-1.)) /* BASIC SGN function */
+
+/*
+ * Local function declarations
+ */
+static double antgain(double, double);
+static void ion(int, double, double);
+static int pathloss(int, double);
+static double refmuf(double, double, double, double, double, double,
+    double, double);
+static double zenith(double);
+
+/*
+ * Reference data
+ */
+static double month;		/* month of year (1 - 12) */
+static double day;		/* day of month */
+static double flux;		/* 10-cm solar flux */
+static double ssn;		/* sunspot number (derived from flux) */
+static double lat1, lon1;	/* transmitter coordinates (rad N/W) */
+static double b1;		/* transmitter bearing (rad) */
+static double lat2, lon2;	/* receiver coordinates (rad N/W) */
+static double b2;		/* receiver bearing (rad) */
+static double theta;		/* path angle (rad) */
+static double lats, lons;	/* subsolar coordinates (rad) */
+static double noise;		/* thermal noise (dBm) */
+static double dB1;		/* transmitter output power (dBW) */
+static int options;		/* option flags */
+static int nfreq;		/* number of frequencies */
+static struct antenna *ant;	/* antenna gain table */
+
+/*
+ * Path variables
+ */
+static double mufE[HMAX];	/* maximum E-layer MUF (MHz) */
+static double mufF[HMAX];	/* minimum F-layer MUF (MHz) */
+static double absorp[HMAX];	/* ionospheric absorption coefficient */
+static double dB2[HMAX];	/* receive power (dBm) */
+static double path[HMAX];	/* path length (km) */
+static double beta[HMAX];	/* elevation angle (rad) */
+static char daynight[HMAX];	/* path flags */
+
+/*
+ * ref_evaluate(par, p, hour, r) - reference prediction for one hour
+ *
+ * This is the body of the receiver and hour loops of the original main
+ * program. Only the coordinates and receive power are used from the
+ * path state; the geometry is recomputed on every call. The receive
+ * power is needed because the multipath test in pathloss() includes
+ * hops that are not usable at the current frequency, the power of
+ * which is left over from a previous frequency or hour.
+ */
+void
+ref_evaluate(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	struct result *r	/* prediction */
+	)
+{
+	double psi;		/* sun zenith angle (rad) */
+	double ftemp, gtemp;	/* double temps */
+	int i, h, n;		/* int temps */
+	double fcF;		/* F-layer critical frequency (MHz) */
+	double phiF;		/* F-layer angle of incidence (rad) */
+	int hop;		/* number of ray hops */
+	double beta1;		/* elevation angle (rad) */
+	double d;		/* great-circle distance (rad) */
+	double dhop;		/* hop great-circle distance (rad) */
+	double height;		/* height of F layer (km) */
+
+	month = pp->month;
+	day = pp->day;
+	flux = pp->flux;
+	dB1 = pp->dB1;
+	options = pp->options;
+	nfreq = pp->nfreq;
+	ant = pp->ant;
+	lat1 = p->lat1;
+	lon1 = p->lon1;
+	lat2 = p->lat2;
+	lon2 = p->lon2;
+	ssn = spots(flux);
+	for (h = 0; h < HMAX; h++)
+		dB2[h] = p->dB2[h];
+
+	/*
+	 * Compute great-circle bearings, great-circle distance, min
+	 * hops, F-layer angle of incidence and path delay
+	 */
+	theta = lon1 - lon2;
+	if (theta >= PI)
+		theta -= PID;
+	if (theta <= -PI)
+		theta += PID;
+	d = acos(sin(lat1) * sin(lat2) + cos(lat1) * cos(lat2) *
+	    cos(theta));
+	if (d < 0.)
+		d += PI;
+	b1 = acos((sin(lat2) - sin(lat1) * cos(d)) / (cos(lat1) *
+	    sin(d)));
+	if (b1 < 0.)
+		b1 += PI;
+	if (theta < 0)
+		b1 = PID - b1;
+	b2 = acos((sin(lat1) - sin(lat2) * cos(d)) / (cos(lat2) *
+	    sin(d)));
+	if (b2 < 0.)
+		b2 += PI;
+	if (theta >= 0.)
+		b2 = PID - b2;
+	if (options & H_LONG) {
+		d = PID - d;
+		b1 += PI;
+		if (b1 >= PID)
+ 			b1 -= PID;
+		b2 += PI;
+		if (b2 >= PID)
+			b2 -= PID;
+	}
+	hop = (int)(d / (2. * acos(R / (R + hF))));
+	beta1 = 0.;
+	while (beta1 < pp->minbeta) {
+		hop++;
+		dhop = d / (hop * 2.);
+		beta1 = atan((cos(dhop) - R / (R + hF)) / sin(dhop));
+	}
+	ftemp = R * cos(beta1) / (R + hF);
+	phiF = atan(ftemp / sqrt(1. - ftemp * ftemp));
+
+	/*
+	 * Hour loop body
+	 */
+	noise = 10. * log10(BOLTZ * NTEMP * DELTAF) + 30.;
+	ftemp = refmuf(flux, month, day, hour, lat1, lon1, lat2, lon2);
+	fcF = ftemp * cos(phiF);
+	ftemp = (month - 1.) * 365.25 / 12. + day - 80.;
+	lats = 23.5 * D2R * sin(ftemp / 365.25 * PID);
+	lons = (hour * 15. - 180.) * D2R;
+	for (h = hop; h < hop + 3; h++) {
+		height = hF;
+		psi = zenith(d / 2.);
+		if (90. - psi * R2D < 0)
+			height += 70.;
+		else
+			height -= 30.;
+		dhop = d / (h * 2.);
+		beta[h] = atan((cos(dhop) - R / (R + height)) /
+		    sin(dhop));
+		path[h] = 2. * h * sin(dhop) * (R + height) /
+		    cos(beta[h]);
+		ion(h, d, fcF);
+	}
+	r->hour = hour;
+	r->muf = mufF[hop];
+	r->psi = psi;
+	r->hop = hop;
+	r->best = -1;
+	r->bhop = 0;
+	ftemp = noise;
+	for (i = 0; i < nfreq; i++) {
+		n = pathloss(hop, pp->freq[i]);
+		r->f[i].hop = n;
+		r->f[i].dB2 = dB2[n];
+		r->f[i].beta = beta[n];
+		r->f[i].path = path[n];
+		r->f[i].flags = daynight[n];
+		gtemp = dB2[n];
+		if (gtemp > ftemp && n > 0) {
+			ftemp = gtemp;
+			r->best = i;
+			r->bhop = n;
+		}
+	}
+}
+
+/*
+ * ion(d, h, fcF) - determine paratmeters for hop h
+ */
+static void
+ion(
+	int h,			/* hop index */
+	double d,		/* path angle (rad) */
+	double fcF		/* F-layer critical frequency */
+	)
+{
+	double beta;		/* elevation angle (rad) */
+	double psi;		/* sun zenith angle (rad) */
+	double dhop;		/* hop angle / 2 (rad) */
+	double dist;		/* path angle (rad) */
+	double phiF;		/* F-layer angle of incidence (rad) */
+	double phiE;		/* E-layer angle of incidence (rad) */
+	double fcE;		/* E-layer critical frequency (MHz) */
+	double ftemp;		/* double temp */
+
+	dhop = d / (h * 2.);
+	beta = atan((cos(dhop) - R / (R + hF)) / sin(dhop));
+	ftemp = R * cos(beta) / (R + hE);
+	phiE = atan(ftemp / sqrt(1. - ftemp * ftemp));
+	ftemp = R * cos(beta) / (R + hF);
+	phiF = atan(ftemp / sqrt(1. - ftemp * ftemp));
+	mufE[h] = 0;
+	mufF[h] = fcF / cos(phiF);
+	absorp[h] = 0.;
+	daynight[h] = 0;
+	for (dist = dhop; dist < d; dist += dhop * 2) {
+		fcE = 0.;
+		psi = zenith(dist);
+		ftemp = cos(psi);
+		if (ftemp > 0.)
+			fcE = .9 * pow((180. + 1.44 * ssn) * ftemp,
+			    .25);
+		if (fcE < .005 * ssn)
+			fcE = .005 * ssn;
+		ftemp = fcE / cos(phiE);
+		if (ftemp > mufE[h])
+			mufE[h] = ftemp;
+		ftemp = psi;
+		if (ftemp > 100.8 * D2R) {
+			ftemp = 100.8 * D2R;
+			daynight[h] |= P_N;
+		}
+		else
+			daynight[h] |= P_J;
+		ftemp = cos(90. / 100.8 * ftemp);
+		if (ftemp < 0.)
+			ftemp = 0.;
+		ftemp = (1. + .0037 * ssn) * pow(ftemp, 1.3);
+		if (ftemp < .1)
+			ftemp = .1;
+		absorp[h] += ftemp;
+	}
+}
+
+/*
+ * pathloss(freq, hop) - Compute receive power for given path.
+ */
+static int
+pathloss(
+	int hop,		/* minimum hops */
+	double freq		/* frequency */
+	)
+{
+	int h;			/* hop number */
+	double level;		/* max signal (dBm) */
+	double signal;		/* receive signal (dBm) */
+	double ftemp;		/* double temp */
+	int j;			/* index temp */
+
+	level = noise;
+	j = 0;
+	for (h = hop; h < hop + 3; h++) {
+		daynight[h] &= ~(P_E | P_S | P_M);
+		if (freq < 0.85 * mufF[h]) {
+			signal = dB1 + antgain(freq, beta[h]) + 30.;
+			signal -= 32.44 + 20. * log10(path[h] * freq) +
+			    SLOSS;
+			ftemp = R * cos(beta[h]) / (R + hE);
+			ftemp = atan(ftemp / sqrt(1. - ftemp * ftemp));
+			signal -= 677.2 * absorp[h] / cos(ftemp) /
+			    (pow((freq + GAMMA), 1.98) + 10.2);
+			signal -= h * GLOSS;
+			dB2[h] = signal;
+			if (signal < RSENS)
+				daynight[h] |= P_S;
+			if (freq < mufE[h]) {
+				daynight[h] |= P_E;
+				signal -= MPATH;
+			}
+			if (signal > level) {
+				level = signal;
+				j = h;
+			}
+		}
+	}
+	if (j == 0)
+		return (0);
+
+	ftemp = 0.;
+	for (h = hop; h < hop + 3; h++) {
+		if (h != j)
+			ftemp += exp(2. / 10. * dB2[h] * LN10);
+	}
+	ftemp = 10. / 2. * log10(ftemp);
+	if (level < ftemp + MPATH)
+		daynight[j] |= P_M;
+	return (j);
+}
+
+/*
+ * antgain(freq, beta) - Compute antenna gain from tables.
+ */
+static double
+antgain(
+	double freq,		/* frequency (MHz) */
+	double beta		/* elevation angle (rad) */
+	)
+{
+	double p, q, r, s;	/* double temps */
+	int i, j, n;		/* index temps */
+
+	if (~options & H_GAIN)
+		return (0);
+
+	r = beta * R2D / 2.;
+	i = (int)r;
+	r -= i;
+	s = 1. - r;
+	n = nfreq < NGAIN ? nfreq : NGAIN;
+	for (j = 0; j < n && ant->freq[j] < freq; j++);
+	if (j == 0) {
+		if (i == 44)
+			return (ant->gain[i][j]);
+		else
+			return(s * ant->gain[i][j] + r *
+			    ant->gain[i + 1][j]);
+	}
+	if (j == n) {
+		if (i == 44)
+			return (ant->gain[i][j - 1]);
+		else
+			return(s * ant->gain[i][j - 1] + r *
+			    ant->gain[i + 1][j - 1]);
+	}
+	p = (freq - ant->freq[j - 1]) / (ant->freq[j] - ant->freq[j - 1]);
+	q = 1. - p;
+	return(q * (s * ant->gain[i][j - 1] + r * ant->gain[i + 1][j - 1]) +
+	    p * (s * ant->gain[i][j] + r * ant->gain[i + 1][j]));
+}
+
+/*
+ * refmuf(flux, month, day, hour, lat1, lon1, lat2, lon2) - MINIMUF 3.5
+ *
+ * This is the original minimuf() routine, kept here so the verify mode
+ * checks the one in minimuf.c as well.
+ */
+static double
+refmuf(
+	double flux,		/* 10-cm solar flux */
+	double month,		/* month of year (1 - 12) */
+	double day,		/* day of month (1 - 31) */
+	double hour,		/* hour of day (utc) (0 - 23) */
+	double lat1,		/* transmitter latitude (deg n) */
+	double lon1,		/* transmitter longitude (deg w) */
+	double lat2,		/* receiver latitude (deg n) */
+	double lon2		/* receiver longitude (deg w) */
+	)
+
+{
+	double ssn;		/* sunspot number dervived from flux */
+	double muf;		/* maximum usable frequency */
+	double dist;		/* path angle (rad) */
+	double a, p, q;		/* unfathomable local variables */
+	double y1, y2, y3;
+	double t, t4, t9;
+	double g0, g8;
+	double k1, k6, k8, k9;
+	double m9, c0;
+	double ftemp, gtemp;	/* volatile temps */
+
+	/*
+	 * Determine geometry and invariant coefficients
+	 */
+	ssn = spots(flux);
+	ftemp = sin(lat1) * sin(lat2) + cos(lat1) * cos(lat2) *
+	    cos(lon2 - lon1);
+	if (ftemp < -1.)
+		ftemp = -1.;
+	if (ftemp > 1.)
+		ftemp = 1.;
+	dist = acos(ftemp);
+	k6 = 1.59 * dist;
+	if (k6 < 1.)
+		k6 = 1.;
+	p = sin(lat2);
+	q = cos(lat2);
+	a = (sin(lat1) - p * cos(dist)) / (q * sin(dist));
+	y1 = .0172 * (10. + (month - 1.) * 30.4 + day);
+	y2 = .409 * cos(y1);
+	ftemp = 2.5 * dist / k6;
+	if (ftemp > PIH)
+		ftemp = PIH;
+	ftemp = sin(ftemp);
+	m9 = 1. + 2.5 * ftemp * sqrt(ftemp);
+	muf = 100.;
+
+	/*
+	 * Loop along path
+	 */
+	for (k1 = 1. / (2. * k6); k1 <= 1. - 1. / (2. * k6);
+	    k1 += fabs(.9999 - 1. / k6)) {
+		gtemp = dist * k1;
+		ftemp = p * cos(gtemp) + q * sin(gtemp) * a;
+		if (ftemp < -1.)
+			ftemp = -1.;
+		if (ftemp > 1.)
+			ftemp = 1.;
+		y3 = PIH - acos(ftemp);
+		ftemp = (cos(gtemp) - ftemp * p) / (q * sqrt(1. - ftemp
+		    * ftemp));
+		if (ftemp < -1.)
+			ftemp = -1.;
+		if (ftemp > 1.)
+			ftemp = 1.;
+		ftemp = lon2 + SGN(sin(lon1 - lon2)) * acos(ftemp);
+		if (ftemp < 0.)
+			ftemp += PID;
+		if (ftemp >= PID)
+			ftemp -= PID;
+		ftemp = 3.82 * ftemp + 12. + .13 * (sin(y1) + 1.2 *
+		    sin(2. * y1));
+		k8 = ftemp - 12. * (1. + SGN(ftemp - 24.)) *
+		    SGN(fabs(ftemp - 24.));
+		if (cos(y3 + y2) <= -.26) {
+			k9 = 0.;
+			g0 = 0.;
+		} else {
+			ftemp = (-.26 + sin(y2) * sin(y3)) / (cos(y2) *
+			    cos(y3) + .001);
+			k9 = 12. - atan(ftemp / sqrt(fabs(1. - ftemp *
+			    ftemp))) * 7.639437;
+			t = k8 - k9 / 2. + 12. * (1. - SGN(k8 - k9 /
+			    2.)) * SGN(fabs(k8 - k9 / 2.));
+			t4 = k8 + k9 / 2. - 12. * (1. + SGN(k8 + k9 /
+			    2. - 24.)) * SGN(fabs(k8 + k9 / 2. - 24.));
+			c0 = fabs(cos(y3 + y2));
+			t9 = 9.7 * pow(c0, 9.6);
+			if (t9 < .1)
+				t9 = .1;
+			g8 = PI * t9 / k9;
+			if ((t4 < t && (hour - t4) * (t - hour) > 0.) ||
+			    (t4 >= t && (hour - t) * (t4 - hour) <= 0.))
+			    {
+				ftemp = hour + 12. * (1. + SGN(t4 -
+				    hour)) * SGN(fabs(t4 - hour));
+				ftemp = (t4 - ftemp) / 2.;
+				g0 = c0 * (g8 * (exp(-k9 / t9) + 1.)) *
+				    exp(ftemp) / (1. + g8 * g8);
+			} else {
+				ftemp = hour + 12. * (1. + SGN(t -
+				    hour)) * SGN(fabs(t - hour));
+				gtemp = PI * (ftemp - t) / k9;
+				ftemp = (t - ftemp) / t9;
+				g0 = c0 * (sin(gtemp) + g8 * (exp(ftemp)
+				    - cos(gtemp))) / (1. + g8 * g8);
+				ftemp = c0 * (g8 * (exp(-k9 / t9) + 1.))
+				    * exp((k9 - 24.) / 2.) / (1. + g8 *
+				    g8);
+				if (g0 < ftemp)
+					g0 = ftemp;
+			}
+		}
+		ftemp = (1. + ssn / 250.) * m9 * sqrt(6. + 58. *
+		    sqrt(g0));
+		ftemp *= 1. - .1 * exp((k9 - 24.) / 3.);
+		ftemp *= 1. + .1 * (1. - SGN(lat1) * SGN(lat2));
+		ftemp *= 1. - .1 * (1. + SGN(fabs(sin(y3)) - cos(y3)));
+		if (ftemp < muf)
+			muf = ftemp;
+	}
+	return (muf);
+}
+
+/*
+ * zenith(dist) - Determine sun zenith angle at reflection zone.
+ */
+static double
+zenith(
+	double dist		/* path angle */
+	)
+{
+	double latr, lonr;	/* reflection zone coordinates (rad) */
+	double thetar;		/* reflection zone angle (rad) */
+	double psi;		/* sun zenith angle (rad) */
+
+	latr = acos(cos(dist) * sin(lat1) + sin(dist) *
+	    cos(lat1) * cos(b1));
+	if (latr < 0.)
+		latr += PI;
+	latr = PIH - latr;
+	lonr = acos((cos(dist) - sin(latr) * sin(lat1)) /
+	    (cos(latr) * cos(lat1)));
+	if (lonr < 0.)
+		lonr += PI;
+	if (theta < 0.)
+		lonr = - lonr;
+	lonr = lon1 - lonr;
+	if (lonr >= PI)
+		lonr -= PID;
+	if (lonr <= -PI)
+		lonr += PID;
+	thetar = lons - lonr;
+	if (thetar > PI)
+		thetar = PID - thetar;
+	if (thetar < - PI)
+		thetar -= PID;
+	psi = acos(sin(latr) * sin(lats) + cos(latr) * cos(lats) *
+	    cos(thetar));
+	if (psi < 0.)
+		psi += PI;
+	return(psi);
+}
@@ -0,0 +1,408 @@
+/*
+ * Hot reload of station, antenna and flux data
+ *
+ * When enabled by the -F option, the solar flux, the transmitter and
+ * the antenna gain table can be changed while the program is running,
+ * as when it runs as a filter in stream mode (-S), without a restart
+ * and without holding up the receivers in progress. The flux and
+ * transmitter are read from the reload file named on the command line,
+ * which holds the flux, optionally followed on the next line by the
+ * transmitter coordinates and name as in the input data; the antenna
+ * gain table is read from the antenna file named on the command line,
+ * if there is one. Values not in the reload file are those of the input
+ * data and command line.
+ *
+ * The data are kept in snapshots, which are never changed once
+ * published. A watcher thread looks at the modification times of the
+ * two files every interval seconds and, when either changes, reads them
+ * into a new snapshot and publishes it by an atomic store of the
+ * current snapshot pointer. A file that cannot be read, or is read
+ * while it is being written, is ignored until it changes again.
+ *
+ * A reader pins the current snapshot with rpin() at the start of each
+ * batch of receivers and uses it until the next. Pinning takes no lock:
+ * the reader stores the snapshot pointer in its hazard slot, then checks
+ * that the snapshot is still the current one. The watcher keeps each
+ * replaced snapshot on the retired list until no hazard slot points to
+ * it, then frees it, so a snapshot in use is never freed and one no
+ * longer in use is freed at the next poll.
+ *
+ * The prediction cache is flushed when the antenna table changes. The
+ * flux and transmitter are in the cache key, so they need no flush.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minimuf.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#define RSLOT	16		/* hazard slots */
+#define RLINE	1024		/* longest reload file line */
+
+/*
+ * Watched file
+ */
+struct watch {
+	char *file;		/* file name (NULL if none) */
+	struct stat st;		/* status when last read */
+	int have;		/* file existed when last read */
+};
+
+static struct snap *current;	/* current snapshot */
+static struct snap *retired;	/* retired snapshots */
+static struct snap *hazard[RSLOT]; /* snapshots pinned by readers */
+static struct watch wreload;	/* reload file */
+static struct watch want;	/* antenna file */
+static double interval;		/* poll interval (s) */
+static long nsnap;		/* snapshots published */
+static long nfree;		/* snapshots freed */
+static long nerror;		/* files ignored */
+
+/*
+ * Local function declarations
+ */
+static struct snap *rcopy(struct snap *, char *, int);
+static int rchanged(struct watch *);
+static int rread(char *, struct snap **);
+static int rant(char *, struct antenna *);
+static void *rwatch(void *);
+static void rreclaim(void);
+static void rstats(void);
+
+/*
+ * rinit(spec, antfile, par, tx) - start hot reload
+ *
+ * The spec is the reload file name, optionally followed by a comma and
+ * the poll interval in seconds (default 1). The first snapshot is made
+ * from the prediction parameters and transmitter, with the reload file
+ * applied if it exists. Returns 0 if ok, -1 if error.
+ */
+int
+rinit(
+	char *spec,		/* reload file and interval */
+	char *antfile,		/* antenna file (NULL if none) */
+	struct param *pp,	/* prediction parameters */
+	struct site *tx		/* transmitter site */
+	)
+{
+	static char file[256];	/* reload file name */
+	struct snap *sp;	/* first snapshot */
+	pthread_t tid;		/* watcher thread */
+
+	interval = 1.;
+	file[0] = '\0';
+	sscanf(spec, "%255[^,],%lf", file, &interval);
+	if (file[0] == '\0' || interval <= 0) {
+		fprintf(stderr, "minimuf: bad reload file %s\n", spec);
+		return (-1);
+	}
+	wreload.file = file;
+	want.file = antfile;
+	sp = malloc(sizeof(struct snap) + tx->namelen);
+	if (sp == NULL)
+		return (-1);
+	memset(sp, 0, sizeof(struct snap));
+	sp->flux = pp->flux;
+	sp->ssn = pp->ssn;
+	sp->gain = (pp->options & H_GAIN) != 0;
+	sp->ant = *pp->ant;
+	sp->tx = *tx;
+	sp->tx.name = (char *)(sp + 1);
+	if (tx->namelen > 0)
+		memcpy(sp->tx.name, tx->name, tx->namelen);
+	rchanged(&want);
+	if (rchanged(&wreload) && rread(wreload.file, &sp) < 0)
+		return (-1);
+	current = sp;
+	nsnap++;
+	if (stats)
+		atexit(rstats);
+	if (pthread_create(&tid, NULL, rwatch, NULL) != 0) {
+		fprintf(stderr, "minimuf: cannot start reload thread\n");
+		return (-1);
+	}
+	pthread_detach(tid);
+	return (0);
+}
+
+/*
+ * rpin(slot) - pin current snapshot
+ *
+ * Any snapshot pinned before in the slot is released. Each reader
+ * thread has a slot of its own. Returns the snapshot, which stays valid
+ * until the slot is pinned again or released.
+ */
+struct snap *
+rpin(
+	int slot		/* hazard slot */
+	)
+{
+	struct snap *sp;	/* snapshot */
+
+	do {
+		sp = __atomic_load_n(&current, __ATOMIC_SEQ_CST);
+		__atomic_store_n(&hazard[slot], sp, __ATOMIC_SEQ_CST);
+	} while (__atomic_load_n(&current, __ATOMIC_SEQ_CST) != sp);
+	return (sp);
+}
+
+/*
+ * runpin(slot) - release snapshot pinned in slot
+ */
+void
+runpin(
+	int slot		/* hazard slot */
+	)
+{
+	__atomic_store_n(&hazard[slot], NULL, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * rwatch(arg) - watcher thread
+ */
+static void *
+rwatch(
+	void *arg		/* not used */
+	)
+{
+	struct snap *sp;	/* new snapshot */
+	struct timespec ts;	/* poll interval */
+	int a, r;		/* antenna, reload file changed */
+
+	(void)arg;
+	ts.tv_sec = (time_t)interval;
+	ts.tv_nsec = (long)((interval - ts.tv_sec) * 1e9);
+	for (;;) {
+		nanosleep(&ts, NULL);
+		a = rchanged(&want);
+		r = rchanged(&wreload);
+		if (a || r) {
+
+			/*
+			 * Start from a copy of the current snapshot, so a
+			 * file that has not changed, or has gone away,
+			 * keeps its values.
+			 */
+			sp = rcopy(current, NULL, 0);
+			if (sp == NULL)
+				continue;
+			sp->gen = current->gen + 1;
+			if (a && want.have) {
+				if (rant(want.file, &sp->ant) < 0) {
+					free(sp);
+					continue;
+				}
+				sp->gain = 1;
+				sp->antgen = sp->gen;
+			}
+			if (r && wreload.have && rread(wreload.file, &sp) <
+			    0) {
+				free(sp);
+				continue;
+			}
+			current->next = retired;
+			retired = current;
+			__atomic_store_n(&current, sp, __ATOMIC_SEQ_CST);
+			__atomic_add_fetch(&nsnap, 1, __ATOMIC_RELAXED);
+		}
+		rreclaim();
+	}
+	return (NULL);
+}
+
+/*
+ * rreclaim() - free retired snapshots not pinned by any reader
+ */
+static void
+rreclaim(void)
+{
+	struct snap **spp, *sp;	/* retired list pointers */
+	int i;
+
+	spp = &retired;
+	while ((sp = *spp) != NULL) {
+		for (i = 0; i < RSLOT; i++) {
+			if (__atomic_load_n(&hazard[i], __ATOMIC_SEQ_CST) ==
+			    sp)
+				break;
+		}
+		if (i < RSLOT) {
+			spp = &sp->next;
+			continue;
+		}
+		*spp = sp->next;
+		free(sp);
+		__atomic_add_fetch(&nfree, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/*
+ * rchanged(wp) - check whether watched file has changed
+ *
+ * A file changes when it is created, removed, replaced or written.
+ * Returns 1 if changed since last checked, 0 if not.
+ */
+static int
+rchanged(
+	struct watch *wp	/* watched file */
+	)
+{
+	struct stat st;		/* file status */
+	int have;		/* file exists */
+
+	if (wp->file == NULL)
+		return (0);
+	have = stat(wp->file, &st) == 0;
+	if (have == wp->have && (!have || (st.st_ino == wp->st.st_ino &&
+	    st.st_size == wp->st.st_size && st.st_mtim.tv_sec ==
+	    wp->st.st_mtim.tv_sec && st.st_mtim.tv_nsec ==
+	    wp->st.st_mtim.tv_nsec)))
+		return (0);
+	wp->have = have;
+	if (have)
+		wp->st = st;
+	return (1);
+}
+
+/*
+ * rcopy(sp, name, namelen) - copy snapshot
+ *
+ * The copy has the given transmitter name or, if name is NULL, that of
+ * the snapshot. Returns the copy or NULL if no memory.
+ */
+static struct snap *
+rcopy(
+	struct snap *sp,	/* snapshot */
+	char *name,		/* transmitter name */
+	int namelen		/* length of name */
+	)
+{
+	struct snap *np;	/* copy */
+
+	if (name == NULL) {
+		name = sp->tx.name;
+		namelen = sp->tx.namelen;
+	}
+	np = malloc(sizeof(struct snap) + namelen);
+	if (np == NULL)
+		return (NULL);
+	*np = *sp;
+	np->next = NULL;
+	np->tx.name = (char *)(np + 1);
+	np->tx.namelen = namelen;
+	memcpy(np->tx.name, name, namelen);
+	return (np);
+}
+
+/*
+ * rread(file, spp) - apply reload file to snapshot
+ *
+ * The snapshot is replaced by a copy if the transmitter name changes.
+ * Returns 0 if ok, -1 if the file cannot be read.
+ */
+static int
+rread(
+	char *file,		/* reload file */
+	struct snap **spp	/* snapshot */
+	)
+{
+	struct snap *sp, *np;	/* snapshot, copy */
+	FILE *fp;		/* reload file */
+	char line[RLINE];	/* input line */
+	double flux;		/* 10-cm solar flux */
+	double lat, lon;	/* transmitter coordinates (deg N/E) */
+	int n, len;		/* int temps */
+
+	sp = *spp;
+	fp = fopen(file, "r");
+	if (fp == NULL || fgets(line, RLINE, fp) == NULL || sscanf(line,
+	    "%lf", &flux) != 1 || flux <= 0) {
+		if (fp != NULL)
+			fclose(fp);
+		fprintf(stderr, "minimuf: bad reload file %s, ignored\n",
+		    file);
+		__atomic_add_fetch(&nerror, 1, __ATOMIC_RELAXED);
+		return (-1);
+	}
+	sp->flux = flux;
+	sp->ssn = spots(flux);
+
+	/*
+	 * The name extends from the end of the longitude to the end of
+	 * the line, as in the input data.
+	 */
+	if (fgets(line, RLINE, fp) != NULL && sscanf(line, "%lf%lf%n", &lat,
+	    &lon, &n) == 2) {
+		len = strcspn(line + n, "\r\n");
+		np = rcopy(sp, line + n, len);
+		if (np == NULL) {
+			fclose(fp);
+			return (-1);
+		}
+		np->tx.lat = lat;
+		np->tx.lon = lon;
+		free(sp);
+		*spp = np;
+	}
+	fclose(fp);
+	return (0);
+}
+
+/*
+ * rant(file, ap) - read antenna file
+ *
+ * Returns 0 if ok, -1 if the file cannot be read.
+ */
+static int
+rant(
+	char *file,		/* antenna file */
+	struct antenna *ap	/* antenna gain table */
+	)
+{
+	FILE *fp;		/* antenna file */
+	int i, j;
+
+	fp = fopen(file, "r");
+	if (fp == NULL)
+		goto bad;
+	for (j = 0; j < NGAIN; j++) {
+		if (fscanf(fp, "%lf", &ap->freq[j]) != 1)
+			goto bad;
+	}
+	for (i = 0; i < 46; i++) {
+		for (j = 0; j < NGAIN; j++) {
+			if (fscanf(fp, "%lf", &ap->gain[i][j]) != 1)
+				goto bad;
+		}
+	}
+	fclose(fp);
+	return (0);
+
+bad:
+	if (fp != NULL)
+		fclose(fp);
+	fprintf(stderr, "minimuf: bad antenna file %s, ignored\n", file);
+	__atomic_add_fetch(&nerror, 1, __ATOMIC_RELAXED);
+	return (-1);
+}
+
+/*
+ * rstats() - display reload statistics on stderr
+ */
+static void
+rstats(void)
+{
+	fprintf(stderr,
+	    "reload: %ld snapshots, %ld freed, %ld files ignored\n",
+	    __atomic_load_n(&nsnap, __ATOMIC_RELAXED),
+	    __atomic_load_n(&nfree, __ATOMIC_RELAXED),
+	    __atomic_load_n(&nerror, __ATOMIC_RELAXED));
+}
+#endif /* _WIN32 */
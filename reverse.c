@@ -0,0 +1,340 @@
+/*
+ * Reverse reachability query
+ *
+ * When enabled by the -q option, the program finds for each receiver
+ * in the input data, each hour and each frequency the transmitters in
+ * a station list that can be heard above the receiver sensitivity. The
+ * transmitter in the input data is the first transmitter, followed by
+ * those in the named file, which has one site per line in the same
+ * format as the receiver lines.
+ *
+ * Most paths can be rejected without a prediction. For each path and
+ * frequency, upper bounds on the MUF and receive power for any hour
+ * are computed from the geometry alone (see bound.c), which is cheap
+ * once the sines and cosines of the station latitudes are known. A
+ * frequency at or above 0.85 times the MUF bound, or where the power
+ * bound with the least absorption of 0.1 per hop is below the receiver
+ * sensitivity, is unusable for every hour. For a path with at least
+ * one frequency passing both tests, each hour is then bounded with the
+ * MINIMUF value and sun zenith angle for that hour, as in the search
+ * mode, and only the hours whose power bound reaches the receiver
+ * sensitivity are predicted with evalsun(). As with the search mode,
+ * the leftover hop state then differs from that of a prediction for
+ * every hour, which can show up only in the multipath flag.
+ *
+ * A transmitter is reachable when the prediction has a path not marked
+ * 's'. The results for each receiver are displayed by hour and
+ * frequency, strongest first. The reachable list and the scratch space
+ * for sorting it come from the arena of the thread, which is reset for
+ * each receiver. With -T, the pruning statistics are displayed on
+ * stderr at exit.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#ifndef _WIN32
+
+/*
+ * Reachable transmitter
+ */
+struct hit {
+	int hour;		/* hour of day (UTC) */
+	int freq;		/* frequency index */
+	int tx;			/* transmitter index */
+	struct cell cell;	/* path descriptor */
+};
+
+static long npath;		/* paths considered */
+static long nmuf;		/* paths rejected on MUF */
+static long npower;		/* paths rejected on power */
+static long neval;		/* paths bounded by hour */
+static long nhour;		/* path-hours bounded */
+static long nhpred;		/* path-hours predicted */
+static long nhit;		/* reachable transmitter-hours */
+
+/*
+ * Local function declarations
+ */
+static int rbound(struct param *, struct path *, double, int *);
+static void rprint(struct obuf *, struct station *, struct hit *, int,
+    struct param *);
+static int rcmp(const void *, const void *);
+static void rstats(void);
+
+/*
+ * reverse(par, ip, tx, txfile, h1, h2, ob) - reverse query mode
+ *
+ * The input data have been read up to and including the transmitter.
+ * Returns the program exit status.
+ */
+int
+reverse(
+	struct param *pp,	/* prediction parameters */
+	struct input *ip,	/* input data */
+	struct site *tx,	/* transmitter in input data */
+	char *txfile,		/* transmitter file */
+	int h1,			/* first hour */
+	int h2,			/* last hour */
+	struct obuf *ob		/* output buffer */
+	)
+{
+	struct arena *ap;	/* per-receiver storage */
+	struct input txin;	/* transmitter file */
+	struct station *txs;	/* transmitters */
+	struct station rxs;	/* receiver */
+	struct site site;	/* receiver site */
+	struct path path;	/* path state */
+	struct result res;	/* prediction for one hour */
+	struct hit *hits, *hp;	/* reachable list */
+	double gmax;		/* max antenna gain (dB) */
+	double muf;		/* MINIMUF (MHz) */
+	int ntx;		/* number of transmitters */
+	int nhits, size;	/* reachable list length, size */
+	int ok[FMAX];		/* frequency passes bounds */
+	int i, j, h, rval;	/* int temps */
+
+	/*
+	 * Read the transmitters. The transmitter file must stay open,
+	 * since the site names point into it.
+	 */
+	ntx = 1;
+	txs = malloc(sizeof(struct station));
+	if (txs == NULL) {
+		fprintf(stderr, "minimuf: no memory for query\n");
+		return (1);
+	}
+	instation(&txs[0], tx);
+	if (inopen(&txin, txfile) < 0) {
+		fprintf(stderr, "minimuf: cannot open %s\n", txfile);
+		return (1);
+	}
+	if (inlist(&txin, &txs, &ntx) < 0)
+		return (1);
+	if (stats)
+		atexit(rstats);
+	gmax = bgain(pp);
+	obprintf(ob, "10-cm solar flux:%4.0lf   SN:%4.0lf   Month:%3.0lf   Day:%3.0lf   Power:%3.0f dBW\n",
+	    pp->flux, pp->ssn, pp->month, pp->day, pp->dB1);
+
+	/*
+	 * Receiver loop
+	 */
+	ap = athread();
+	while ((rval = insite(ip, &site)) > 0) {
+		instation(&rxs, &site);
+		areset(ap);
+		hits = NULL;
+		nhits = size = 0;
+		for (i = 0; i < ntx; i++) {
+			npath++;
+			memset(&path, 0, sizeof(path));
+			path.lat1 = txs[i].lat;
+			path.lon1 = txs[i].lon;
+			path.lat2 = rxs.lat;
+			path.lon2 = rxs.lon;
+			pathgeom(pp, &path, txs[i].slat, txs[i].clat,
+			    rxs.slat, rxs.clat);
+			switch (rbound(pp, &path, gmax, ok)) {
+
+			case 1:
+				nmuf++;
+				continue;
+
+			case 2:
+				npower++;
+				continue;
+			}
+
+			/*
+			 * Some frequency may be usable. Bound each hour,
+			 * predict those that pass and save the reachable
+			 * frequencies.
+			 */
+			neval++;
+			for (h = h1; h <= h2; h++) {
+				nhour++;
+				TSTART(ST_MUF);
+				muf = minimuf(pp->flux, pp->month, pp->day, h,
+				    path.lat1, path.lon1, path.lat2,
+				    path.lon2);
+				TSTOP(ST_MUF);
+				subsolar(pp, &path, h);
+				if (bhour(pp, &path, gmax, muf, pathzenith(&path,
+				    path.d / 2.)) < RSENS - 1e-9)
+					continue;
+				nhpred++;
+				evalsun(pp, &path, h, muf, &res);
+				for (j = 0; j < pp->nfreq; j++) {
+					if (!ok[j] || res.f[j].hop == 0 ||
+					    res.f[j].flags & P_S)
+						continue;
+					if (nhits == size) {
+						hp = arealloc(ap, hits, size *
+						    sizeof(struct hit), (size * 2 +
+						    64) * sizeof(struct hit));
+						if (hp == NULL) {
+							fprintf(stderr,
+							    "minimuf: no memory for query\n");
+							return (1);
+						}
+						hits = hp;
+						size = size * 2 + 64;
+					}
+					hp = &hits[nhits++];
+					hp->hour = h;
+					hp->freq = j;
+					hp->tx = i;
+					hp->cell = res.f[j];
+				}
+			}
+		}
+		nhit += nhits;
+		TSTART(ST_OUT);
+		obprintf(ob, "\nReceiver");
+		obfix(ob, site.lat, 8, 2);
+		obputs(ob, "N ");
+		obfix(ob, -site.lon, 7, 2);
+		obputs(ob, "W ");
+		obname(ob, site.name, site.namelen, 0);
+		obputc(ob, '\n');
+		if (asort(ap, hits, nhits, sizeof(struct hit), rcmp) < 0) {
+			fprintf(stderr, "minimuf: no memory for query\n");
+			return (1);
+		}
+		rprint(ob, txs, hits, nhits, pp);
+		TSTOP(ST_OUT);
+	}
+	if (obflush(ob) < 0)
+		return (1);
+	return (rval < 0);
+}
+
+/*
+ * rbound(par, p, gmax, ok) - test frequencies against upper bounds
+ *
+ * The path geometry must have been computed by pathgeom(). For each
+ * frequency, ok is set if the frequency may be usable at some hour.
+ * Returns 0 if any frequency may be usable, 1 if all are rejected and
+ * at least one on MUF alone, 2 if all are rejected on power.
+ */
+static int
+rbound(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double gmax,		/* max antenna gain (dB) */
+	int *ok			/* frequency passes bounds */
+	)
+{
+	double mufmax;		/* MUF upper bound (MHz) */
+	double freq;		/* frequency (MHz) */
+	int i, n, rval;
+
+	mufmax = bmuf(pp, p);
+	n = 0;
+	rval = 2;
+	for (i = 0; i < pp->nfreq; i++) {
+		freq = pp->freq[i];
+		ok[i] = 0;
+		if (freq >= 0.85 * mufmax * (1. + 1e-9)) {
+			rval = 1;
+			continue;
+		}
+		if (bpower(pp, p, gmax, .1, freq) < RSENS - 1e-9)
+			continue;
+		ok[i] = 1;
+		n++;
+	}
+	if (n > 0)
+		return (0);
+	return (rval);
+}
+
+/*
+ * rprint(ob, txs, hits, n, par) - display reachable transmitters
+ *
+ * The columns are hour, frequency, receive power (dBm above threshold)
+ * with day/night flag and hop number, transmitter number and name.
+ */
+static void
+rprint(
+	struct obuf *ob,	/* output buffer */
+	struct station *txs,	/* transmitters */
+	struct hit *hits,	/* reachable list */
+	int n,			/* number reachable */
+	struct param *pp	/* prediction parameters */
+	)
+{
+	struct hit *hp;		/* hit pointer */
+	struct cell *cp;	/* path descriptor */
+	char c1, c2;		/* path flags */
+	int i;
+
+	if (n == 0) {
+		obputs(ob, "no transmitters reachable\n");
+		return;
+	}
+	obputs(ob, "UT   Freq    dBm      Tx Name\n");
+	for (i = 0; i < n; i++) {
+		hp = &hits[i];
+		cp = &hp->cell;
+		if (cp->flags & P_J && cp->flags & P_N)
+			c1 = 'x';
+		else if (cp->flags & P_J)
+			c1 = 'j';
+		else
+			c1 = 'n';
+		c2 = cp->flags & P_M ? 'm' : ' ';
+		obint(ob, hp->hour, 2);
+		obfix(ob, pp->freq[hp->freq], 7, 1);
+		obfix(ob, cp->dB2 - RSENS, 7, 0);
+		obputc(ob, c1);
+		obint(ob, cp->hop, 1);
+		obputc(ob, c2);
+		obint(ob, hp->tx + 1, 6);
+		obputc(ob, ' ');
+		obname(ob, txs[hp->tx].name, txs[hp->tx].namelen, 0);
+		obputc(ob, '\n');
+	}
+}
+
+/*
+ * rcmp(a, b) - compare hits for asort()
+ *
+ * The order is hour, frequency, then receive power, strongest first,
+ * then transmitter number.
+ */
+static int
+rcmp(
+	const void *a,		/* first hit */
+	const void *b		/* second hit */
+	)
+{
+	const struct hit *ha = a, *hb = b;
+
+	if (ha->hour != hb->hour)
+		return (ha->hour - hb->hour);
+	if (ha->freq != hb->freq)
+		return (ha->freq - hb->freq);
+	if (ha->cell.dB2 != hb->cell.dB2)
+		return (ha->cell.dB2 < hb->cell.dB2 ? 1 : -1);
+	return (ha->tx - hb->tx);
+}
+
+/*
+ * rstats() - display pruning statistics on stderr
+ */
+static void
+rstats(void)
+{
+	fprintf(stderr,
+	    "query: %ld paths, %ld rejected on MUF, %ld on power, %ld bounded by hour\n",
+	    npath, nmuf, npower, neval);
+	fprintf(stderr,
+	    "query: %ld path-hours, %ld predicted, %ld reachable\n", nhour,
+	    nhpred, nhit);
+}
+#endif /* _WIN32 */
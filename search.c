@@ -0,0 +1,383 @@
+/*
+ * Best time search
+ *
+ * When enabled by the -b option, the program finds for each receiver
+ * in the input data the count combinations of date, hour and frequency
+ * with the largest receive power above the receiver sensitivity, over
+ * a range of days starting at the date in the input data. This takes
+ * the place of sorting the prediction tables for the best hour.
+ *
+ * Each date and hour is given an upper bound on the receive power at
+ * any frequency below the MUF for that hour, using the MINIMUF value,
+ * the geometry of predict() and the least absorption for the sun zenith
+ * angle at the midpoint (see bound.c). This is much cheaper than a
+ * prediction and exact at night, when the absorption is the least.
+ * The dates and hours are predicted in decreasing order of the bound,
+ * and the search stops when the bound is no greater than the smallest
+ * of the best so far, to within 1e-6 dB, or is below the receiver
+ * sensitivity, so dates and hours that cannot make the list are never
+ * predicted, though the MINIMUF value is still computed for every date
+ * and hour. Hours with no frequency below the MUF are rejected without
+ * a bound. Paths below the receiver sensitivity, marked 's', are not
+ * listed.
+ *
+ * The date-hour list and the scratch space for sorting it and the best
+ * list come from the arena of the thread, which is reset for each
+ * receiver, so no memory is allocated once the first receiver is done.
+ *
+ * Since the dates and hours are not predicted in order, the multipath
+ * flag, which depends on the receive power left over from the previous
+ * prediction, can differ from that in the prediction tables.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#ifndef _WIN32
+
+/*
+ * Date and hour to be predicted
+ */
+struct cand {
+	int month;		/* month of year (1 - 12) */
+	int day;		/* day of month */
+	int hour;		/* hour of day (UTC) */
+	double muf;		/* MINIMUF (MHz) */
+	double bound;		/* receive power bound (dBm) */
+};
+
+/*
+ * Best combination so far
+ */
+struct best {
+	int month;		/* month of year (1 - 12) */
+	int day;		/* day of month */
+	int hour;		/* hour of day (UTC) */
+	int freq;		/* frequency index */
+	struct cell cell;	/* path descriptor */
+};
+
+/*
+ * Days in each month
+ */
+static const int mdays[] = {
+	31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+};
+
+static long ncand;		/* date-hours considered */
+static long nmuf;		/* date-hours rejected on MUF */
+static long nbound;		/* date-hours rejected on bound */
+static long neval;		/* date-hours predicted */
+
+/*
+ * Local function declarations
+ */
+static void sinsert(struct best *, int *, int, struct best *);
+static void sprint(struct obuf *, struct param *, struct best *, int);
+static int scmp(const void *, const void *);
+static int sbcmp(const void *, const void *);
+static void sstats(void);
+
+/*
+ * search(par, ip, tx, count, days, h1, h2, ob) - best time search mode
+ *
+ * The input data have been read up to and including the transmitter.
+ * Returns the program exit status.
+ */
+int
+search(
+	struct param *pp,	/* prediction parameters */
+	struct input *ip,	/* input data */
+	struct site *tx,	/* transmitter in input data */
+	int count,		/* number of results */
+	int days,		/* number of days */
+	int h1,			/* first hour */
+	int h2,			/* last hour */
+	struct obuf *ob		/* output buffer */
+	)
+{
+	struct arena *ap;	/* per-receiver storage */
+	struct param pd;	/* prediction parameters for date */
+	struct station txs, rxs; /* transmitter, receiver */
+	struct site site;	/* receiver site */
+	struct path path;	/* path state */
+	struct result res;	/* prediction for one hour */
+	struct cand *cands, *cp; /* date-hour list */
+	struct best *bests;	/* best so far (heap) */
+	struct best b;		/* candidate combination */
+	double gmax;		/* max antenna gain (dB) */
+	double muf;		/* MINIMUF (MHz) */
+	int nc, nb;		/* list lengths */
+	int month, day;		/* date */
+	int i, j, h, rval;	/* int temps */
+
+	if (count < 1)
+		count = 1;
+	if (days < 1)
+		days = 1;
+	bests = malloc(count * sizeof(struct best));
+	if (bests == NULL) {
+		fprintf(stderr, "minimuf: no memory for search\n");
+		return (1);
+	}
+	ap = athread();
+	if (stats)
+		atexit(sstats);
+	instation(&txs, tx);
+	gmax = bgain(pp);
+	obprintf(ob, "10-cm solar flux:%4.0lf   SN:%4.0lf   Month:%3.0lf   Day:%3.0lf   Power:%3.0f dBW\n",
+	    pp->flux, pp->ssn, pp->month, pp->day, pp->dB1);
+
+	/*
+	 * Receiver loop
+	 */
+	pd = *pp;
+	while ((rval = insite(ip, &site)) > 0) {
+		instation(&rxs, &site);
+		TSTART(ST_OUT);
+		obprintf(ob, "\nReceiver");
+		obfix(ob, site.lat, 8, 2);
+		obputs(ob, "N ");
+		obfix(ob, -site.lon, 7, 2);
+		obputs(ob, "W ");
+		obname(ob, site.name, site.namelen, 0);
+		obputc(ob, '\n');
+		TSTOP(ST_OUT);
+		memset(&path, 0, sizeof(path));
+		path.lat1 = txs.lat;
+		path.lon1 = txs.lon;
+		path.lat2 = rxs.lat;
+		path.lon2 = rxs.lon;
+		TSTART(ST_GEOM);
+		pathgeom(pp, &path, txs.slat, txs.clat, rxs.slat, rxs.clat);
+		TSTOP(ST_GEOM);
+
+		/*
+		 * Bound each date and hour.
+		 */
+		areset(ap);
+		cands = aalloc(ap, (size_t)days * (h2 - h1 + 1) *
+		    sizeof(struct cand));
+		if (cands == NULL) {
+			fprintf(stderr, "minimuf: no memory for search\n");
+			return (1);
+		}
+		nc = 0;
+		month = (int)pp->month;
+		day = (int)pp->day;
+		if (month < 1 || month > 12)
+			month = 1;
+		for (i = 0; i < days; i++) {
+			pd.month = month;
+			pd.day = day;
+			for (h = h1; h <= h2; h++) {
+				ncand++;
+				TSTART(ST_MUF);
+				muf = minimuf(pd.flux, pd.month, pd.day, h,
+				    path.lat1, path.lon1, path.lat2,
+				    path.lon2);
+				TSTOP(ST_MUF);
+				subsolar(&pd, &path, h);
+				cp = &cands[nc];
+				cp->bound = bhour(&pd, &path, gmax, muf,
+				    pathzenith(&path, path.d / 2.));
+				if (cp->bound == -HUGE_VAL) {
+					nmuf++;
+					continue;
+				}
+				cp->month = month;
+				cp->day = day;
+				cp->hour = h;
+				cp->muf = muf;
+				nc++;
+			}
+			if (++day > mdays[month - 1]) {
+				day = 1;
+				if (++month > 12)
+					month = 1;
+			}
+		}
+		if (asort(ap, cands, nc, sizeof(struct cand), scmp) < 0) {
+			fprintf(stderr, "minimuf: no memory for search\n");
+			return (1);
+		}
+
+		/*
+		 * Predict in order of decreasing bound until the bound
+		 * cannot beat the smallest of the best so far, which is at
+		 * the top of the heap, or reach the receiver sensitivity.
+		 */
+		nb = 0;
+		for (i = 0; i < nc; i++) {
+			cp = &cands[i];
+			if (cp->bound < RSENS - 1e-9 || (nb == count &&
+			    cp->bound <= bests[0].cell.dB2 + 1e-6)) {
+				nbound += nc - i;
+				break;
+			}
+			neval++;
+			pd.month = cp->month;
+			pd.day = cp->day;
+			evalmuf(&pd, &path, cp->hour, cp->muf, &res);
+			for (j = 0; j < pd.nfreq; j++) {
+				if (res.f[j].hop == 0 || res.f[j].flags & P_S)
+					continue;
+				b.month = cp->month;
+				b.day = cp->day;
+				b.hour = cp->hour;
+				b.freq = j;
+				b.cell = res.f[j];
+				sinsert(bests, &nb, count, &b);
+			}
+		}
+		if (asort(ap, bests, nb, sizeof(struct best), sbcmp) < 0) {
+			fprintf(stderr, "minimuf: no memory for search\n");
+			return (1);
+		}
+		TSTART(ST_OUT);
+		sprint(ob, pp, bests, nb);
+		TSTOP(ST_OUT);
+	}
+	if (obflush(ob) < 0)
+		return (1);
+	return (rval < 0);
+}
+
+/*
+ * sinsert(bests, n, count, b) - offer combination to best list
+ *
+ * The list is a min-heap on receive power of up to count entries. When
+ * it is full, the combination replaces the top if it is stronger.
+ */
+static void
+sinsert(
+	struct best *bests,	/* best list */
+	int *n,			/* list length */
+	int count,		/* max list length */
+	struct best *b		/* combination */
+	)
+{
+	int i, j;
+
+	if (*n < count) {
+		i = (*n)++;
+		while (i > 0 && bests[(i - 1) / 2].cell.dB2 > b->cell.dB2) {
+			bests[i] = bests[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+	} else {
+		if (b->cell.dB2 <= bests[0].cell.dB2)
+			return;
+		i = 0;
+		while ((j = 2 * i + 1) < *n) {
+			if (j + 1 < *n && bests[j + 1].cell.dB2 <
+			    bests[j].cell.dB2)
+				j++;
+			if (bests[j].cell.dB2 >= b->cell.dB2)
+				break;
+			bests[i] = bests[j];
+			i = j;
+		}
+	}
+	bests[i] = *b;
+}
+
+/*
+ * sprint(ob, par, bests, n) - display best list
+ *
+ * The columns are rank, month, day, hour, frequency and receive power
+ * (dBm above threshold) with day/night flag and hop number.
+ */
+static void
+sprint(
+	struct obuf *ob,	/* output buffer */
+	struct param *pp,	/* prediction parameters */
+	struct best *bests,	/* best list */
+	int n			/* list length */
+	)
+{
+	struct cell *cp;	/* path descriptor */
+	char c1, c2;		/* path flags */
+	int i;
+
+	if (n == 0) {
+		obputs(ob, "no usable frequency\n");
+		return;
+	}
+	obputs(ob, "Rank Month Day UT     Freq    dBm\n");
+	for (i = 0; i < n; i++) {
+		cp = &bests[i].cell;
+		if (cp->flags & P_J && cp->flags & P_N)
+			c1 = 'x';
+		else if (cp->flags & P_J)
+			c1 = 'j';
+		else
+			c1 = 'n';
+		c2 = cp->flags & P_M ? 'm' : ' ';
+		obint(ob, i + 1, 4);
+		obint(ob, bests[i].month, 6);
+		obint(ob, bests[i].day, 4);
+		obint(ob, bests[i].hour, 3);
+		obfix(ob, pp->freq[bests[i].freq], 9, 3);
+		obfix(ob, cp->dB2 - RSENS, 7, 0);
+		obputc(ob, c1);
+		obint(ob, cp->hop, 1);
+		obputc(ob, c2);
+		obputc(ob, '\n');
+	}
+}
+
+/*
+ * scmp(a, b) - compare date-hours for asort(), largest bound first
+ */
+static int
+scmp(
+	const void *a,		/* first date-hour */
+	const void *b		/* second date-hour */
+	)
+{
+	const struct cand *ca = a, *cb = b;
+
+	if (ca->bound != cb->bound)
+		return (ca->bound < cb->bound ? 1 : -1);
+	return (0);
+}
+
+/*
+ * sbcmp(a, b) - compare combinations for asort(), strongest first
+ *
+ * Ties are in date, hour and frequency order.
+ */
+static int
+sbcmp(
+	const void *a,		/* first combination */
+	const void *b		/* second combination */
+	)
+{
+	const struct best *ba = a, *bb = b;
+
+	if (ba->cell.dB2 != bb->cell.dB2)
+		return (ba->cell.dB2 < bb->cell.dB2 ? 1 : -1);
+	if (ba->month != bb->month)
+		return (ba->month - bb->month);
+	if (ba->day != bb->day)
+		return (ba->day - bb->day);
+	if (ba->hour != bb->hour)
+		return (ba->hour - bb->hour);
+	return (ba->freq - bb->freq);
+}
+
+/*
+ * sstats() - display search statistics on stderr
+ */
+static void
+sstats(void)
+{
+	fprintf(stderr,
+	    "search: %ld date-hours, %ld rejected on MUF, %ld on bound, %ld predicted\n",
+	    ncand, nmuf, nbound, neval);
+}
+#endif /* _WIN32 */
@@ -23,8 +23,12 @@
 /*
  * Command line:
  *
- *	minimuf [-mdhspoel] [infile] [antfile]
- * 		infile		input file
+ *	minimuf [-mdhspoefAlLT] [-r km | -a min,max | -k count] [-C cache]
+ *	    [-x txfile] [-q txfile] [-b count,days] [-g | -G grid]
+ *	    [-j threads] [-t file] [-D file] [-F file] [-W file | -Y file]
+ *	    [-c file] [-V count] [-K tol]
+ *	    [infile] [antfile]
+ * 		infile		input file or startup image
  *		antfile		antenna data file
  *
  * Command-line modifiers (Unix only):
@@ -32,18 +36,31 @@
  *	If any of these are specified, they override the corresponding
  *	data in the input file.
  *
+ *	-A
+ *		use the table-driven power-law and exponential kernels
+ *		in place of pow() and exp() (see approx.c)
+ *
  *	-d day
  *		day of month (1-31)
  *
  *	-e angle
  *		minimum takeoff angle (deg)
  *
+ *	-f
+ *		compute the batch path geometry in single precision
+ *		(see catalog.c)
+ *
  *	-h hour
  *		hour of day (0-23)
  *
  *	-l
  *		use long path (default is short path)
  *
+ *	-L
+ *		predict the short and long paths together and display
+ *		which is better for each hour and frequency (see
+ *		dual.c)
+ *
  *	-m month
  *		month of year (1-12)
  *
@@ -57,6 +74,106 @@
  *		10-cm solar flux (65-250)
  *		output format (1-4)
  *
+ * Command-line modes (Unix only):
+ *
+ *	-a min,max
+ *		display only receivers at great-circle distances from
+ *		min to max (km) from the transmitter (see index.c)
+ *
+ *	-b count[,days]
+ *		best time search: display the count best combinations
+ *		of date, hour and frequency for each receiver over days
+ *		days from the date in the input file (see search.c)
+ *
+ *	-D file[,dB[,MHz]]
+ *		delta output: display only the cells that changed by at
+ *		least dB (default 1) and the MUF values that changed by
+ *		at least MHz (default 0.1) since the run that wrote file,
+ *		then write file for the next run (see delta.c)
+ *
+ *	-F file[,secs]
+ *		hot reload: every secs seconds (default 1), check file
+ *		and the antenna file for changes and use the flux and
+ *		transmitter in file and the antenna gain table for the
+ *		receivers that follow (see reload.c)
+ *
+ *	-W file[,flux,...]
+ *		register the paths from the transmitter to each receiver
+ *		and write prediction tables for every day and hour of
+ *		the year at the given flux levels to file (see table.c)
+ *
+ *	-Y file
+ *		display the receivers whose paths are in the tables in
+ *		file from the tables, interpolated in flux
+ *
+ *	-c file
+ *		write the input data as parsed, with the antenna gain
+ *		table, to the startup image file, which can be given as
+ *		the input file of later runs (see image.c)
+ *
+ *	-C size[,grid[,policy]]
+ *		cache predictions for up to size path-hours, with
+ *		coordinates quantized to grid (deg) and policy lru or
+ *		fifo (see cache.c)
+ *
+ *	-g
+ *		Loran-C mode: the input file describes a Loran-C chain
+ *		and receivers; display the time of arrival and time
+ *		difference of each station for each receiver (see
+ *		loran.c)
+ *
+ *	-G lat1,lat2,lon1,lon2,step
+ *		Loran-C mode: display the time differences and GDOP
+ *		over a grid (deg N/E)
+ *
+ *	-j threads
+ *		number of worker threads in matrix and pipeline modes
+ *		(default is the number of processors)
+ *
+ *	-k count
+ *		display only the count receivers nearest the
+ *		transmitter, nearest first
+ *
+ *	-P
+ *		pipeline mode: parse, compute and write the prediction
+ *		tables in separate threads (see pipe.c)
+ *
+ *	-q txfile
+ *		reverse query: for each receiver, hour and frequency,
+ *		list the transmitters in the input file and txfile
+ *		that can be heard above the receiver sensitivity (see
+ *		reverse.c)
+ *
+ *	-r km
+ *		display only receivers within km of the transmitter
+ *
+ *	-S ms
+ *		stream mode: read the receivers as they arrive and write
+ *		each table no more than ms milliseconds after it is
+ *		complete (see input.c)
+ *
+ *	-T
+ *		display per-stage timing on stderr at exit; -TT also
+ *		displays hardware counters (compile with -DTIMING); the
+ *		arena and pool allocation counters and the statistics of
+ *		the modes in use are always displayed
+ *
+ *	-t file
+ *		write a Chrome trace-event JSON file with a span for
+ *		each receiver, day and hour (see trace.c)
+ *
+ *	-x txfile
+ *		matrix mode: compute all paths from the transmitter
+ *		in the input file and those in txfile to all receivers
+ *		and display MUF and SNR matrices (see matrix.c)
+ *
+ *	-V count[,seed]
+ *		verify the prediction kernels against the reference
+ *		kernel on a randomized corpus (see verify.c)
+ *
+ *	-K muf,dB,hop,flags
+ *		verify tolerances
+ *
  * Input file format:
  *
  *	first line contains six numbers:
@@ -108,65 +225,24 @@
  * MSF Rugby		60 kHz			52:22N 1:11W
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 #include <math.h>
 
 #ifndef _WIN32
 #include <sys/types.h>
+#include <unistd.h>
 #endif /* _WIN32 */
 
-#define R 6371.2		/* radius of the Earth (km) */
-#define hE 110.			/* mean height of E layer (km) */
-#define hF 320.			/* mean height of F layer (km) */
-#define GAMMA 1.42		/* geomagnetic constant */
-#define LN10 2.302585		/* natural logarithm of 10 */
-#define PI 3.141592653589	/* the real thing */
-#define PIH (PI / 2.)		/* the real thing / 2 */
-#define PID (PI * 2.)		/* the real thing * 2 */
-#define VOFL 2.9979250e8	/* velocity of light (m/s) */
-#define D2R (PI / 180.)		/* degrees to radians */
-#define R2D (180. / PI)		/* radians to degrees */
-#define MINBETA (10. * D2R)	/* min elevation angle (rad) */
-#define BOLTZ 1.380622e-23	/* Boltzmann's constant */
-#define NTEMP 290.		/* receiver noise temperature (K) */
-#define DELTAF 2500.		/* communication bandwidth (Hz) */
-#define MPATH 3.		/* multipath threshold (dB) */
-#define GLOSS 3.		/* ground-reflection loss (dB) */
-#define SLOSS 10.		/* excess system loss */
-#define RSENS -123.		/* receiver sensitivity (dBm) */
-#define NGAIN 5			/* antenna gain frequencies */
-#define FMAX 10			/* max frequencies */
-#define HMAX 30			/* max hops */
+#include "minimuf.h"
 
-/*
- * Program flags (flags)
- */
-#define H_FMT	0x0001		/* output format */
-#define H_MONTH	0x0002		/* month of year */
-#define H_DAY	0x0004		/* day of month */
-#define H_HOUR	0x0008		/* hour of day */
-#define H_FLUX	0x0010		/* 10-cm solar flux */
-#define H_POWER	0x0020		/* transmitter power */
-#define H_BETA	0x0040		/* minimum elevation angle */
-#define H_GAIN	0x0080		/* antenna gain table present */
-#define H_LONG	0x0100		/* use long path (default is short) */
-
-/*
- * Path flags (daynight)
- */
-#define P_J 0x01		/* hop in daytime */
-#define P_N 0x02		/* hop in nighttime */
-#define P_S 0x04		/* signal below sensitivity */
-#define P_E 0x08		/* E-layer cutoff */
-#define P_M 0x10		/* multipath */
+#define NBATCH	1024		/* receivers per geometry batch */
 
 /*
  * Global function declarations
  */
 extern FILE *fopen();
-extern double minimuf(double, double, double, double, double, double,
-    double, double);
-extern double spots(double);
 
 #ifndef _WIN32
 extern char *optarg;		/* pointer to option string */
@@ -176,56 +252,93 @@ extern int optind;		/* argv index of next argument */
 int optind;			/* argv index of next argument */
 #endif /* _WIN32 */
 
+/*
+ * Evaluation variants. The options tested in the inner loops of ion(),
+ * pathloss() and dsx() are passed as constants down through the whole
+ * hour evaluation and the whole display line, and the wrappers below
+ * instantiate one copy of each for every combination, compiled with
+ * the tests resolved and everything inlined. The evaluation variant is
+ * looked up from the options once for each hour, since the callers may
+ * change the options between hours; the output format variant is chosen
+ * once at startup.
+ */
+#define V_GAIN	0x1		/* antenna gain table present */
+#define V_APPROX 0x2		/* approximate kernels */
+#define VARIANT(pp) (((pp)->options & H_GAIN ? V_GAIN : 0) | \
+	((pp)->options & H_APPROX ? V_APPROX : 0))
+
+#ifdef __GNUC__
+#define INLINE	static inline __attribute__((always_inline))
+#else
+#define INLINE	static
+#endif /* __GNUC__ */
+
 /*
  * Local function declarations
  */
-static double antgain(double, double);
-static void ion(int, double, double);
-static int pathloss(int, double);
-static double zenith(double);
-static void dsx(int);
+static double antgain(struct param *, double, double);
+INLINE void predict(struct param *, struct path *, double, double, int);
+INLINE void evalhour(struct param *, struct path *, double, double,
+    struct result *, int);
+INLINE void ion(struct param *, struct path *, int, double, int);
+INLINE int pathloss(struct param *, struct path *, int, double, int);
+INLINE void dline(struct obuf *, struct path *, struct result *,
+    struct cell *, int);
+INLINE void dsx(struct obuf *, struct cell *, int);
+static void eval0(struct param *, struct path *, double, double,
+    struct result *);
+static void eval1(struct param *, struct path *, double, double,
+    struct result *);
+static void eval2(struct param *, struct path *, double, double,
+    struct result *);
+static void eval3(struct param *, struct path *, double, double,
+    struct result *);
+static void dline0(struct obuf *, struct path *, struct result *,
+    struct cell *);
+static void dline1(struct obuf *, struct path *, struct result *,
+    struct cell *);
+static void dline2(struct obuf *, struct path *, struct result *,
+    struct cell *);
+static void dline3(struct obuf *, struct path *, struct result *,
+    struct cell *);
+static void dline4(struct obuf *, struct path *, struct result *,
+    struct cell *);
+static int rxselect(int, double, double, int, struct site **, int **);
 
 /*
  * Global data
  */
-double month;			/* month of year (1 - 12) */
-double day;			/* day of month */
-double hour;			/* hour of day (UTC) */
-double flux;			/* 10-cm solar flux */
-double ssn;			/* sunspot number (derived from flux) */
-double lat1, lon1;		/* transmitter coordinates (deg N/W) */
-double b1;			/* transmitter bearing (rad) */
-char site1[30];			/* transmitter site name */
-double lat2, lon2;		/* receiver coordinates (deg N/W) */
-double b2;			/* receiver bearing (rad) */
-char site2[30];			/* receiver site name */
-double theta;			/* path angle (rad) */
-double lats, lons;		/* subsolar coordinates (rad) */
-double noise;			/* thermal noise (dBm) */
-FILE *fp_in, *fp_an;		/* file handles */
+struct param par;		/* prediction parameters */
+struct input in;		/* input data */
+struct obuf out;		/* standard output */
+struct site tx;			/* transmitter site */
+struct site rx;			/* receiver site */
+FILE *fp_an;			/* antenna file handle */
 char antfile[25];		/* antenna file name */
 int flag;			/* output format */
-double dB1;			/* transmitter output power (dBW) */
-int options;			/* option flags */
+int stats;			/* display statistics at exit (-T) */
 
 /*
- * Antenna gain data
+ * Variant tables, indexed by VARIANT() and output format
  */
-int nfreq;			/* number of frequencies */
-double freq[FMAX];		/* working frequencies (MHz) */
-double gainfreq[NGAIN];		/* antenna gain frequencies (MHz) */
-double gain[46][NGAIN];		/* antenna gain (main lobe) (dB) */
+static void (*evaltab[])(struct param *, struct path *, double, double,
+    struct result *) = {
+	eval0,			/* isotropic */
+	eval1,			/* gain table */
+	eval2,			/* isotropic, approximate kernels */
+	eval3			/* gain table, approximate kernels */
+};
+static void (*dlinetab[])(struct obuf *, struct path *, struct result *,
+    struct cell *) = {
+	dline0, dline1, dline2, dline3, dline4
+};
+static void (*dlinef)(struct obuf *, struct path *, struct result *,
+    struct cell *) = dline0;	/* output format */
 
 /*
- * Path variables
+ * Antenna gain data
  */
-double mufE[HMAX];		/* maximum E-layer MUF (MHz) */
-double mufF[HMAX];		/* minimum F-layer MUF (MHz) */
-double absorp[HMAX];		/* ionospheric absorption coefficient */
-double dB2[HMAX];		/* receive power (dBm) */
-double path[HMAX];		/* path length (km) */
-double beta[HMAX];		/* elevation angle (rad) */
-char daynight[HMAX];		/* path flags */
+struct antenna antenna;		/* antenna gain table from file */
 
 /*
  * Main program
@@ -240,20 +353,26 @@ main(
 	/*
 	 * Path variables
 	 */
-	double delay;		/* path delay (ms) */
-	double psi;		/* sun zenith angle (rad) */
-	double ftemp, gtemp;	/* double temps */
-	int i, j, h, n;		/* int temps */
-	double offset;		/* offset for local time (hours) */
-	double fcF;		/* F-layer critical frequency (MHz) */
-	double phiF;		/* F-layer angle of incidence (rad) */
-	int hop;		/* number of ray hops */
-	double beta1;		/* elevation angle (rad) */
-	double minbeta;		/* minimum elevation angle (rad) */
-	double d;		/* great-circle distance (rad) */
-	double dhop;		/* hop great-circle distance (rad) */
-	double height;		/* height of F layer (km) */
-	double time;		/* time of day (hour) */
+	struct path path;	/* path state */
+	struct result res;	/* prediction for one hour */
+	struct cell cell;	/* path descriptor */
+	double t_rx, t_day;	/* receiver, day span start */
+	double t_hour, t_phase;	/* hour, phase span start */
+	long nrx;		/* receiver number */
+	double hour;		/* hour of day (UTC) */
+	int i, j;		/* int temps */
+	struct site *sites;	/* receivers (query) */
+	int *sel;		/* selected receivers (query) */
+	int nsel, isel;		/* number selected, next selected */
+	struct station txs;	/* transmitter */
+	struct catalog rxcat;	/* receiver batch */
+	struct gbatch geom;	/* receiver batch geometry */
+	struct site *batch;	/* receiver batch sites */
+	int nbatch, ibatch;	/* batch length, next in batch */
+	int rval;		/* input status */
+	int fast;		/* batch geometry usable */
+	int tabled;		/* hour from prediction tables */
+	int image;		/* input is startup image */
 
 	double hr1, hr2;	/* hour span */
 
@@ -264,37 +383,233 @@ main(
 	double opt_dB1;		/* transmitter output power (dBW) */
 	int opt_flag;		/* output format */
 	int temp;		/* int temp */
+	char *opt_verify;	/* verify corpus size */
+	char *opt_tol;		/* verify tolerances */
+	int opt_timing;		/* timing level */
+	char *opt_trace;	/* trace file name */
+	char *opt_cache;	/* cache size */
+	char *opt_matrix;	/* matrix transmitter file */
+	char *opt_reverse;	/* reverse query transmitter file */
+	int opt_best;		/* best time search results */
+	int opt_days;		/* best time search days */
+	int opt_dual;		/* short and long path together */
+	int opt_loran;		/* Loran-C mode */
+	char *opt_grid;		/* Loran-C grid */
+	int opt_threads;	/* worker threads */
+	int opt_query;		/* receiver query (a, k or r) */
+	double opt_dmin, opt_dmax; /* query distances (km) */
+	int opt_near;		/* query receivers */
+	double opt_stream;	/* stream latency bound (ms) */
+	int opt_pipe;		/* pipelined tables */
+	char *opt_delta;	/* delta output file */
+	char *opt_reload;	/* reload file */
+	char *opt_build;	/* table file to write */
+	char *opt_table;	/* table file to read */
+	char *opt_image;	/* image file to write */
+	struct tquery tq;	/* table lookup */
+	int tfound;		/* receiver in tables */
+	struct snap *sp;	/* current snapshot */
+	long sgen, sant;	/* generations of snapshot in use */
 #endif /* _WIN32 */
 
-	fp_in = stdin;
+	sites = NULL;
+	sel = NULL;
+	nsel = isel = 0;
 	hr1 = 0;
 	hr2 = 23;
+	j = 0;
+	nrx = 0;
+	image = 0;
 	optind = 1;
-	options = 0;
-	minbeta = MINBETA;
+	par.options = 0;
+	par.minbeta = MINBETA;
+	par.ant = &antenna;
+	ephinit();
+	xinit();
 
 #ifndef _WIN32
+	opt_verify = NULL;
+	opt_tol = NULL;
+	opt_timing = 0;
+	opt_trace = NULL;
+	opt_cache = NULL;
+	opt_matrix = NULL;
+	opt_reverse = NULL;
+	opt_best = 0;
+	opt_days = 1;
+	opt_dual = 0;
+	opt_loran = 0;
+	opt_grid = NULL;
+	opt_query = 0;
+	opt_stream = -1;
+	opt_pipe = 0;
+	opt_delta = NULL;
+	opt_reload = NULL;
+	opt_build = opt_table = NULL;
+	opt_image = NULL;
+	tfound = 0;
+	sgen = sant = -1;
+	opt_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
 	/*
 	 * Process command-line arguments
 	 */
-	while ((temp = getopt(argc, argv, "d:e:h:lm:o:p:s:")) != -1) {
+	while ((temp = getopt(argc, argv, "AC:D:F:G:K:LPS:TV:W:Y:a:b:c:d:e:fgh:j:k:lm:o:p:q:r:s:t:x:")) != -1)
+	    {
 		switch (temp) {
 
+		/*
+		 * Approximate kernels
+		 */
+		case 'A':
+			par.options |= H_APPROX;
+			break;
+
+		/*
+		 * Prediction cache
+		 */
+		case 'C':
+			opt_cache = optarg;
+			break;
+
+		/*
+		 * Delta output
+		 */
+		case 'D':
+			opt_delta = optarg;
+			break;
+
+		/*
+		 * Hot reload
+		 */
+		case 'F':
+			opt_reload = optarg;
+			break;
+
+		/*
+		 * Prediction tables
+		 */
+		case 'W':
+			opt_build = optarg;
+			break;
+
+		case 'Y':
+			opt_table = optarg;
+			break;
+
+		/*
+		 * Loran-C grid
+		 */
+		case 'G':
+			opt_grid = optarg;
+			opt_loran = 1;
+			break;
+
+		/*
+		 * Verify tolerances
+		 */
+		case 'K':
+			opt_tol = optarg;
+			break;
+
+		/*
+		 * Short and long path together
+		 */
+		case 'L':
+			opt_dual = 1;
+			break;
+
+		/*
+		 * Pipelined tables
+		 */
+		case 'P':
+			opt_pipe = 1;
+			break;
+
+		/*
+		 * Stream mode
+		 */
+		case 'S':
+			sscanf(optarg, "%lf", &opt_stream);
+			if (opt_stream < 0)
+				opt_stream = 0;
+			break;
+
+		/*
+		 * Per-stage timing
+		 */
+		case 'T':
+			opt_timing++;
+			break;
+
+		/*
+		 * Verify prediction kernels against the reference
+		 */
+		case 'V':
+			opt_verify = optarg;
+			break;
+
+		/*
+		 * Receivers in annulus
+		 */
+		case 'a':
+			if (sscanf(optarg, "%lf,%lf", &opt_dmin,
+			    &opt_dmax) != 2) {
+				fprintf(stderr,
+				    "minimuf: bad annulus %s\n", optarg);
+				return (1);
+			}
+			opt_query = 'a';
+			break;
+
+		/*
+		 * Best time search
+		 */
+		case 'b':
+			if (sscanf(optarg, "%d,%d", &opt_best, &opt_days) <
+			    1 || opt_best < 1 || opt_days < 1) {
+				fprintf(stderr,
+				    "minimuf: bad search %s\n", optarg);
+				return (1);
+			}
+			break;
+
+		/*
+		 * Startup image
+		 */
+		case 'c':
+			opt_image = optarg;
+			break;
+
 		/*
 		 * Day
 		 */
 		case 'd':
 			sscanf(optarg, "%lf", &opt_day);
-			options |= H_DAY;
+			par.options |= H_DAY;
 			break;
 
 		/*
 		 * Minimum elevation angle
 		 */
 		case 'e':
-			sscanf(optarg, "%lf", &minbeta);
-			minbeta *= R2D;
-			options |= H_BETA;
+			sscanf(optarg, "%lf", &par.minbeta);
+			par.minbeta *= R2D;
+			par.options |= H_BETA;
+			break;
+
+		/*
+		 * Single-precision geometry
+		 */
+		case 'f':
+			par.options |= H_FLOAT;
+			break;
+
+		/*
+		 * Loran-C receivers
+		 */
+		case 'g':
+			opt_loran = 1;
 			break;
 
 		/*
@@ -303,14 +618,29 @@ main(
 		case 'h':
 			sscanf(optarg, "%lf", &hr1);
 			hr2 = hr1;
-			options |= H_HOUR;
+			par.options |= H_HOUR;
+			break;
+
+		/*
+		 * Worker threads
+		 */
+		case 'j':
+			sscanf(optarg, "%d", &opt_threads);
+			break;
+
+		/*
+		 * Nearest receivers
+		 */
+		case 'k':
+			sscanf(optarg, "%d", &opt_near);
+			opt_query = 'k';
 			break;
 
 		/*
 		 * Use long path (default is short path)
 		 */
 		case 'l':
-			options |= H_LONG;
+			par.options |= H_LONG;
 			break;
 
 		/*
@@ -318,7 +648,7 @@ main(
 		 */
 		case 'm':
 			sscanf(optarg, "%lf", &opt_month);
-			options |= H_MONTH;
+			par.options |= H_MONTH;
 			break;
 
 		/*
@@ -326,7 +656,7 @@ main(
 		 */
 		case 'o':
 			sscanf(optarg, "%d", &opt_flag);
-			options |= H_FMT;
+			par.options |= H_FMT;
 			break;
 
 		/*
@@ -334,7 +664,23 @@ main(
 		 */
 		case 'p':
 			sscanf(optarg, "%lf", &opt_dB1);
-			options |= H_POWER;
+			par.options |= H_POWER;
+			break;
+
+		/*
+		 * Transmitter list for reverse query
+		 */
+		case 'q':
+			opt_reverse = optarg;
+			break;
+
+		/*
+		 * Receivers in range
+		 */
+		case 'r':
+			sscanf(optarg, "%lf", &opt_dmax);
+			opt_dmin = 0;
+			opt_query = 'r';
 			break;
 
 		/*
@@ -342,46 +688,107 @@ main(
 		 */
 		case 's':
 			sscanf(optarg, "%lf", &opt_flux);
-			options |= H_FLUX;
+			par.options |= H_FLUX;
+			break;
+
+		/*
+		 * Trace file
+		 */
+		case 't':
+			opt_trace = optarg;
+			break;
+
+		/*
+		 * Transmitter list for matrix mode
+		 */
+		case 'x':
+			opt_matrix = optarg;
 			break;
 		}
 	}
+
+	/*
+	 * The verify mode runs on its own randomized corpus and does
+	 * not read any input data.
+	 */
+	if (opt_verify != NULL)
+		return (verify(opt_verify, opt_tol));
+	if (opt_timing > 0) {
+		stats = 1;
+		ainit();
+#ifdef TIMING
+		tinit(opt_timing);
+#else /* TIMING */
+		fprintf(stderr, "minimuf: timing not configured\n");
+#endif /* TIMING */
+	}
+	if (opt_trace != NULL)
+		trinit(opt_trace);
+	if (opt_cache != NULL && cinit(opt_cache) < 0)
+		return (1);
 #endif /* _WIN32 */
 
 	/*
 	 * Read data and frequency list.
 	 */
-	if (argc > optind)
-		fp_in = fopen (argv[optind], "r");
-	if (fp_in == NULL)
+	obinit(&out, 1);
+#ifndef _WIN32
+
+	/*
+	 * A startup image holds the header and sites already parsed.
+	 */
+	if (opt_stream < 0 && argc > optind) {
+		image = imopen(&in, argv[optind], &par, &flag);
+		if (image < 0)
+			return (1);
+	}
+	if (opt_stream >= 0) {
+		if (instream(&in, argc > optind ? argv[optind] : NULL) < 0)
+			return (1);
+	} else
+#endif /* _WIN32 */
+	if (!image && inopen(&in, argc > optind ? argv[optind] : NULL) < 0)
 		return(1);
-	fscanf(fp_in, "%i%lf%lf%lf%lf%i", &flag, &month, &day, &flux,
-	    &dB1, &nfreq);
-	if (nfreq <= 0) {
-		nfreq = NGAIN;
-		for (i = 0; i < nfreq; i++)
-			freq[i] = gainfreq[i];
-	} else {
-		if (nfreq > FMAX)
-			nfreq = FMAX;
-		for (i = 0; i < nfreq; i++) {
-			if (fscanf(fp_in, "%lf", &freq[i]) != 1)
-				return(1);
+	if (!image) {
+		TSTART(ST_PARSE);
+		if (inint(&in, &flag) != 1 || indouble(&in, &par.month) !=
+		    1 || indouble(&in, &par.day) != 1 || indouble(&in,
+		    &par.flux) != 1 || indouble(&in, &par.dB1) != 1 ||
+		    inint(&in, &par.nfreq) != 1) {
+			inerr(&in, "bad header");
+			return (1);
+		}
+		if (par.nfreq <= 0) {
+			par.nfreq = NGAIN;
+			for (i = 0; i < par.nfreq; i++)
+				par.freq[i] = antenna.freq[i];
+		} else {
+			if (par.nfreq > FMAX)
+				par.nfreq = FMAX;
+			for (i = 0; i < par.nfreq; i++) {
+				if (indouble(&in, &par.freq[i]) != 1) {
+					inerr(&in, "bad frequency");
+					return(1);
+				}
+			}
 		}
+		TSTOP(ST_PARSE);
 	}
 
 #ifndef _WIN32
-	if (options & H_MONTH)
-		month = opt_month;
-	if (options & H_DAY)
-		day = opt_day;
-	if (options & H_FLUX)
-		flux = opt_flux;
-	if (options & H_POWER)
-		dB1 = opt_dB1;
-	if (options & H_FMT)
+	if (par.options & H_MONTH)
+		par.month = opt_month;
+	if (par.options & H_DAY)
+		par.day = opt_day;
+	if (par.options & H_FLUX)
+		par.flux = opt_flux;
+	if (par.options & H_POWER)
+		par.dB1 = opt_dB1;
+	if (par.options & H_FMT)
 		flag = opt_flag;
 #endif /* _WIN32 */
+	if (flag >= 1 && flag <= 4)
+		dlinef = dlinetab[flag];
 
 	/*
 	 * Read in optional frequency and antenna gain tables.
@@ -392,190 +799,662 @@ main(
 		if (fp_an == NULL)
 			 (1);
 		for (j = 0; j < NGAIN; j++) {
-			if (fscanf(fp_an, "%lf", &gainfreq[j]) != 1)
+			if (fscanf(fp_an, "%lf", &antenna.freq[j]) != 1)
 				return (1);
 		}
 		for (i = 0; i < 46; i++) {
 			for (j = 0; j < NGAIN; j++) {
-				if (fscanf(fp_an, "%lf", &gain[i][j]) !=
+				if (fscanf(fp_an, "%lf", &antenna.gain[i][j]) !=
 				    1)
 					return (1);
 			}
 		}
-		options |= H_GAIN;
+		par.options |= H_GAIN;
 	}
 
 	/*
 	 * Get transmitter coordinates and site name.
 	 */
-	fscanf(fp_in, "%lf%lf%[^\n]", &lat1, &lon1, site1);
-	lat1 = lat1 * D2R;
-	lon1 = - lon1 * D2R;
+	TSTART(ST_PARSE);
+	if (insite(&in, &tx) < 0)
+		return (1);
+	TSTOP(ST_PARSE);
+	if (in.fd >= 0 && insave(&tx) < 0)
+		return (1);
+	path.lat1 = tx.lat * D2R;
+	path.lon1 = - tx.lon * D2R;
 
 	/*
 	 * Main loop. Get receiver coordinates and site name.
 	 */
-	ssn = spots(flux);
-L1:	if (fscanf(fp_in, "%lf%lf%[^\n]", &lat2, &lon2, site2) != 3)
-		return (0);
-
-	lat2 = lat2 * D2R;
-	lon2 = -lon2 * D2R;
+	par.ssn = spots(par.flux);
+	par.noise = 10. * log10(BOLTZ * NTEMP * DELTAF) + 30.;
+#ifndef _WIN32
+	if (opt_image != NULL)
+		return (imbuild(&par, &in, &tx, flag, opt_image));
+	if (opt_loran)
+		return (loran(&in, &tx, opt_grid, &out));
+	if (opt_matrix != NULL)
+		return (matrix(&par, &in, &tx, opt_matrix, opt_threads,
+		    (int)hr1, (int)hr2, &out));
+	if (opt_reverse != NULL)
+		return (reverse(&par, &in, &tx, opt_reverse, (int)hr1,
+		    (int)hr2, &out));
+	if (opt_best > 0)
+		return (search(&par, &in, &tx, opt_best, opt_days, (int)hr1,
+		    (int)hr2, &out));
+	if (opt_dual)
+		return (dual(&par, &in, &tx, (int)hr1, (int)hr2, &out));
+	if (opt_delta != NULL)
+		return (delta(&par, &in, &tx, opt_delta, (int)hr1, (int)hr2,
+		    &out));
+	if (opt_build != NULL)
+		return (tabbuild(&par, &in, &tx, opt_build));
+	if (opt_pipe && opt_query == 0 && opt_cache == NULL && opt_stream < 0)
+		return (pipeline(&par, &in, &tx, opt_threads, (int)hr1,
+		    (int)hr2, flag, j, &out));
 
 	/*
-	 * Compute great-circle bearings, great-circle distance, min
-	 * hops, F-layer angle of incidence and path delay
+	 * If a receiver query is specified, read all the receivers and
+	 * select those wanted using the spatial index.
 	 */
-	theta = lon1 - lon2;
-	if (theta >= PI)
-		theta -= PID;
-	if (theta <= -PI)
-		theta += PID;
-	d = acos(sin(lat1) * sin(lat2) + cos(lat1) * cos(lat2) *
-	    cos(theta));
-	if (d < 0.)
-		d += PI;
-	b1 = acos((sin(lat2) - sin(lat1) * cos(d)) / (cos(lat1) *
-	    sin(d)));
-	if (b1 < 0.)
-		b1 += PI;
-	if (theta < 0)
-		b1 = PID - b1;
-	b2 = acos((sin(lat1) - sin(lat2) * cos(d)) / (cos(lat2) *
-	    sin(d)));
-	if (b2 < 0.)
-		b2 += PI;
-	if (theta >= 0.)
-		b2 = PID - b2;
-	if (options & H_LONG) {
-		d = PID - d;
-		b1 += PI;
-		if (b1 >= PID)
- 			b1 -= PID;
-		b2 += PI;
-		if (b2 >= PID)
-			b2 -= PID;
+	if (opt_query != 0) {
+		TSTART(ST_PARSE);
+		nsel = rxselect(opt_query, opt_dmin, opt_dmax, opt_near,
+		    &sites, &sel);
+		TSTOP(ST_PARSE);
+		if (nsel < 0)
+			return (1);
 	}
-	hop = (int)(d / (2. * acos(R / (R + hF))));
-	beta1 = 0.;
-	while (beta1 < minbeta) {
-		hop++;
-		dhop = d / (hop * 2.);
-		beta1 = atan((cos(dhop) - R / (R + hF)) / sin(dhop));
+	if (opt_reload != NULL && rinit(opt_reload, argc > optind ?
+	    argv[optind] : NULL, &par, &tx) < 0)
+		return (1);
+	if (opt_table != NULL && tabopen(opt_table) < 0)
+		return (1);
+#endif /* _WIN32 */
+	instation(&txs, &tx);
+	memset(&rxcat, 0, sizeof(rxcat));
+	batch = malloc(NBATCH * sizeof(struct site));
+	if (batch == NULL || gbinit(&geom, NBATCH) < 0)
+		return (1);
+	nbatch = ibatch = 0;
+	rval = 1;
+	fast = par.minbeta > 0 && par.minbeta < PIH;
+L1:	t_rx = tbegin();
+	if (ibatch == nbatch) {
+
+		/*
+		 * Read the next batch of receivers and compute the path
+		 * geometry for all of them together.
+		 */
+		TSTART(ST_PARSE);
+		nbatch = ibatch = 0;
+		rxcat.n = 0;
+#ifndef _WIN32
+
+		/*
+		 * In stream mode, the output is written before waiting
+		 * for more input, and the batch holds only the receivers
+		 * that have already arrived, so a receiver never waits
+		 * for a later one.
+		 */
+		if (in.fd >= 0) {
+			if (!inready(&in) && obflush(&out) < 0)
+				return (1);
+			inrelease(&in);
+		}
+#endif /* _WIN32 */
+		while (rval > 0 && nbatch < NBATCH) {
+			if (sel != NULL) {
+				rval = isel < nsel;
+				if (rval)
+					rx = sites[sel[isel++]];
+			} else {
+#ifndef _WIN32
+				if (nbatch > 0 && in.fd >= 0 &&
+				    !inready(&in))
+					break;
+#endif /* _WIN32 */
+				rval = insite(&in, &rx);
+			}
+			if (rval <= 0)
+				break;
+			batch[nbatch++] = rx;
+			if (image && sel == NULL)
+				continue;
+			if (catadd(&rxcat, rx.lat * D2R, -rx.lon * D2R) < 0)
+				return (1);
+		}
+		TSTOP(ST_PARSE);
+#ifndef _WIN32
+
+		/*
+		 * With hot reload, each batch uses the snapshot current
+		 * when it was read. The cache is flushed when the
+		 * antenna table changes. Pinning releases the snapshot
+		 * in use, which may then be freed, so it is known only
+		 * by its generations.
+		 */
+		if (opt_reload != NULL && (sp = rpin(0))->gen != sgen) {
+			if (sgen >= 0 && sp->antgen != sant)
+				cflush();
+			par.flux = sp->flux;
+			par.ssn = sp->ssn;
+			par.ant = &sp->ant;
+			if (sp->gain)
+				par.options |= H_GAIN;
+			else
+				par.options &= ~H_GAIN;
+			tx = sp->tx;
+			instation(&txs, &tx);
+			path.lat1 = tx.lat * D2R;
+			path.lon1 = -tx.lon * D2R;
+			sgen = sp->gen;
+			sant = sp->antgen;
+		}
+#endif /* _WIN32 */
+
+		/*
+		 * The receivers read from a startup image are already in
+		 * the catalog in the image.
+		 */
+		TSTART(ST_GEOM);
+#ifndef _WIN32
+		if (fast && image && sel == NULL)
+			catgeom(&par, &txs, &in.img->cat, in.img->next -
+			    nbatch, nbatch, &geom);
+		else
+#endif /* _WIN32 */
+		if (fast)
+			catgeom(&par, &txs, &rxcat, 0, nbatch, &geom);
+		TSTOP(ST_GEOM);
 	}
-	ftemp = R * cos(beta1) / (R + hF);
-	phiF = atan(ftemp / sqrt(1. - ftemp * ftemp));
-	delay = 2. * hop * sin(dhop) * (R + hF) / cos(beta1) / VOFL *
-	    1e6;
-
-	if (flag < 4) {
-		printf("\n10-cm solar flux:%4.0lf   SN:%4.0lf   Month:%3.0lf   Day:%3.0lf\n",
-		    flux, ssn, month, day);
-		printf("Power:%3.0f dBW    Distance:%6.0f km    Delay:%5.1f ms\n",
-		    dB1, d * R, delay);
-		printf("Location                        Lat      Long    Azim\n");
-		printf("%-27s %7.2fN  %7.2fW    %3.0f\n",
-		    site1, lat1 * R2D, lon1 * R2D, b1 * R2D);
-		printf("%-27s %7.2fN  %7.2fW    %3.0f\n",
-		    site2, lat2 * R2D, lon2 * R2D, b2 * R2D);
-		printf("UT LT  MUF Zen");
-		for (i = 0; i < nfreq; i++)
-			printf("%7.1f", freq[i]);
-		printf("\n");
+	if (ibatch == nbatch) {
+		if (obflush(&out) < 0)
+			return (1);
+		return (rval < 0);
 	}
 
+	rx = batch[ibatch];
+	path.lat2 = rx.lat * D2R;
+	path.lon2 = -rx.lon * D2R;
+	TSTART(ST_GEOM);
+	if (fast)
+		catpath(&geom, ibatch, &path);
+	else
+		geometry(&par, &path);
+	TSTOP(ST_GEOM);
+	ibatch++;
+
+	TSTART(ST_OUT);
+	if (flag < 4)
+		dhead(&out, &path, &rx);
+	TSTOP(ST_OUT);
+
+#ifndef _WIN32
+	if (opt_table != NULL)
+		tfound = tabfind(&par, &path, &tq) == 0;
+#endif /* _WIN32 */
+
 	/*
-	 * Hour loop: This loop determines the min-hop path and next two
-	 * higher-hop paths. It selects the most likely path for each
-	 * frequency and calculates the receive power. The F-layer
-	 * critical frequency is computed directly from MINIMUF 3.5 and
-	 * the secant law.
+	 * Hour loop: Display one line for each hour. For format 4, the
+	 * hop index is left over from the previous line when no
+	 * frequency is usable. A registered path is looked up in the
+	 * prediction tables, which hold the format 4 path descriptor.
 	 */
-	noise = 10. * log10(BOLTZ * NTEMP * DELTAF) + 30.;
-	offset = (lon2 * 24. / PID);
+	t_day = tbegin();
 	for (hour = hr1; hour <= hr2; hour++) {
-		time = hour - offset;
-		if (time < 0.)
-			time += 24.;
-		if (time >= 24.)
-			time -= 24.;
-		printf("%2.0f %2.0f", hour, time);
-		ftemp = minimuf(flux, month, day, hour, lat1, lon1,
-		    lat2, lon2);
-		fcF = ftemp * cos(phiF);
+		t_hour = tbegin();
+		tabled = 0;
+#ifndef _WIN32
+		if (tfound)
+			tabled = tabget(&tq, hour, &res, &cell) == 0;
+#endif /* _WIN32 */
+		if (!tabled)
+			cevaluate(&par, &path, hour, &res);
+		tend("compute", "phase", t_hour, (long)hour);
+		t_phase = tbegin();
+		TSTART(ST_OUT);
+		if (flag == 4) {
+			if (res.best >= 0)
+				j = res.bhop;
+			if (!tabled)
+				hopcell(&path, j, &cell);
+		}
+		dhour(&out, &path, &res, &cell);
+		TSTOP(ST_OUT);
+		tend("output", "phase", t_phase, (long)hour);
+		tend("hour", "hour", t_hour, (long)hour);
+	}
+	tend("day", "day", t_day, (long)par.day);
+	tend("receiver", "receiver", t_rx, nrx++);
+#ifndef _WIN32
+	if (in.fd >= 0 && obmark(&out, opt_stream / 1000.) < 0)
+		return (1);
+#endif /* _WIN32 */
+	goto L1;
+}
 
-		/*
-		 * Calculate subsolar coordinates.
-		 */
-		ftemp = (month - 1.) * 365.25 / 12. + day - 80.;
-		lats = 23.5 * D2R * sin(ftemp / 365.25 * PID);
-		lons = (hour * 15. - 180.) * D2R;
+/*
+ * rxselect(query, dmin, dmax, k, sites, sel) - select receivers
+ *
+ * This reads the rest of the input data and selects the receivers in
+ * the annulus from dmin to dmax (km) around the transmitter, or the k
+ * nearest the transmitter. Returns the number of receivers selected or
+ * -1 if an error occurs.
+ */
+static int
+rxselect(
+	int query,		/* query (a, k or r) */
+	double dmin,		/* min distance (km) */
+	double dmax,		/* max distance (km) */
+	int k,			/* number of receivers */
+	struct site **sites,	/* receivers */
+	int **sel		/* selected receivers */
+	)
+{
+	struct kdtree kd;	/* spatial index */
+	struct site *sp;	/* site pointer */
+	int n, size, rval;
+
+	n = size = 0;
+	while ((rval = insite(&in, &rx)) > 0) {
+		if (n == size) {
+			size = size * 2 + 1024;
+			sp = realloc(*sites, size * sizeof(struct site));
+			if (sp == NULL) {
+				fprintf(stderr,
+				    "minimuf: no memory for receivers\n");
+				return (-1);
+			}
+			*sites = sp;
+		}
+		(*sites)[n++] = rx;
+	}
+	if (rval < 0)
+		return (-1);
+	*sel = malloc((n + 1) * sizeof(int));
+	if (*sel == NULL || kdbuild(&kd, *sites, n) < 0)
+		return (-1);
+	if (query == 'k')
+		return (kdnear(&kd, tx.lat, tx.lon, k, *sel));
+	return (kdrange(&kd, tx.lat, tx.lon, dmin, dmax, *sel));
+}
+
+/*
+ * geometry(par, p) - compute path geometry
+ *
+ * This routine computes the great-circle bearings, great-circle
+ * distance, min hops, F-layer angle of incidence and path delay.
+ */
+void
+geometry(
+	struct param *pp,	/* prediction parameters */
+	struct path *p		/* path state */
+	)
+{
+	pathgeom(pp, p, sin(p->lat1), cos(p->lat1), sin(p->lat2),
+	    cos(p->lat2));
+}
+
+/*
+ * pathgeom(par, p, s1, c1, s2, c2) - compute path geometry
+ *
+ * This is geometry() with the sines and cosines of the latitudes
+ * supplied by the caller, so they can be computed once per station
+ * when there are many paths.
+ */
+void
+pathgeom(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double s1,		/* sine of transmitter latitude */
+	double c1,		/* cosine of transmitter latitude */
+	double s2,		/* sine of receiver latitude */
+	double c2		/* cosine of receiver latitude */
+	)
+{
+	double ftemp;		/* double temp */
+
+	p->theta = p->lon1 - p->lon2;
+	if (p->theta >= PI)
+		p->theta -= PID;
+	if (p->theta <= -PI)
+		p->theta += PID;
+	p->d = acos(s1 * s2 + c1 * c2 * cos(p->theta));
+	if (p->d < 0.)
+		p->d += PI;
+	p->b1 = acos((s2 - s1 * cos(p->d)) / (c1 * sin(p->d)));
+	if (p->b1 < 0.)
+		p->b1 += PI;
+	if (p->theta < 0)
+		p->b1 = PID - p->b1;
+	p->b2 = acos((s1 - s2 * cos(p->d)) / (c2 * sin(p->d)));
+	if (p->b2 < 0.)
+		p->b2 += PI;
+	if (p->theta >= 0.)
+		p->b2 = PID - p->b2;
+	if (pp->options & H_LONG) {
+		p->d = PID - p->d;
+		p->b1 += PI;
+		if (p->b1 >= PID)
+ 			p->b1 -= PID;
+		p->b2 += PI;
+		if (p->b2 >= PID)
+			p->b2 -= PID;
+	}
+	p->hop = (int)(p->d / (2. * acos(R / (R + hF))));
+	p->beta1 = 0.;
+	while (p->beta1 < pp->minbeta) {
+		p->hop++;
+		p->dhop = p->d / (p->hop * 2.);
+		p->beta1 = atan((cos(p->dhop) - R / (R + hF)) /
+		    sin(p->dhop));
+	}
+	ftemp = R * cos(p->beta1) / (R + hF);
+	p->phiF = atan(ftemp / sqrt(1. - ftemp * ftemp));
+	p->delay = 2. * p->hop * sin(p->dhop) * (R + hF) / cos(p->beta1) /
+	    VOFL * 1e6;
+}
+
+/*
+ * predict(par, p, hour, muf, v) - determine the paths for one hour
+ *
+ * This routine determines the min-hop path and next two higher-hop
+ * paths. The F-layer critical frequency is computed directly from
+ * MINIMUF 3.5 and the secant law. The MINIMUF value is computed by the
+ * caller, since it depends only on the endpoints and is the same for
+ * the short and long paths.
+ */
+INLINE void
+predict(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	double muf,		/* MINIMUF (MHz) */
+	int v			/* variant */
+	)
+{
+	double fcF;		/* F-layer critical frequency (MHz) */
+	double dhop;		/* hop great-circle distance (rad) */
+	double height;		/* height of F layer (km) */
+	int h;			/* hop number */
+
+	fcF = muf * cos(p->phiF);
+	hopset(p);
+
+	/*
+	 * Path loop: This loop determines the geometry of the min-hop
+	 * path and the next two higher-hop paths. It calculates the
+	 * minimum F-layer MUF, maximum E-layer MUF and ionospheric
+	 * absorption factor for each geometry.
+	 */
+	TSTART(ST_ION);
+	for (h = p->hop; h < p->hop + 3; h++) {
 
 		/*
-		 * Path loop: This loop determines the geometry of the
-		 * min-hop path and the next two higher-hop paths. It
-		 * calculates the minimum F-layer MUF, maximum E-layer
-		 * MUF and ionospheric absorption factor for each
-		 * geometry.
+		 * We assume the F layer height decreases during the day
+		 * and increases at night, as determined at the midpoint
+		 * of the path.
 		 */
-		for (h = hop; h < hop + 3; h++) {
+		height = hF;
+		p->psi = pathzenith(p, p->d / 2.);
+		if (90. - p->psi * R2D < 0)
+			height += 70.;
+		else
+			height -= 30.;
+		dhop = p->d / (h * 2.);
+		p->hs.beta[h - p->hop] = atan((cos(dhop) - R / (R +
+		    height)) / sin(dhop));
+		p->hs.path[h - p->hop] = 2. * h * sin(dhop) * (R +
+		    height) / cos(p->hs.beta[h - p->hop]);
+		ion(pp, p, h, fcF, v);
+	}
+	TSTOP(ST_ION);
+}
 
-			/*
-			 * We assume the F layer height decreases during
-			 * the day and increases at night, as determined
-			 * at the midpoint of the path.
-			 */
-			height = hF;
-			psi = zenith(d / 2.);
-			if (90. - psi * R2D < 0)
-				height += 70.;
-			else
-				height -= 30.;
-			dhop = d / (h * 2.);
-			beta[h] = atan((cos(dhop) - R / (R + height)) /
-			    sin(dhop));
-			path[h] = 2. * h * sin(dhop) * (R + height) /
-			    cos(beta[h]);
-			ion(h, d, fcF);
+/*
+ * evaluate(par, p, hour, r) - compute prediction for one hour
+ *
+ * This is the prediction kernel used by the main program. It selects
+ * the most likely path for each frequency and calculates the receive
+ * power. It also selects the best of all frequencies for format 4.
+ */
+void
+evaluate(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	struct result *r	/* prediction */
+	)
+{
+	double muf;		/* MINIMUF (MHz) */
+
+	TSTART(ST_MUF);
+	muf = minimuf(pp->flux, pp->month, pp->day, hour, p->lat1,
+	    p->lon1, p->lat2, p->lon2);
+	TSTOP(ST_MUF);
+	evalmuf(pp, p, hour, muf, r);
+}
+
+/*
+ * evalmuf(par, p, hour, muf, r) - compute prediction given MINIMUF
+ */
+void
+evalmuf(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	double muf,		/* MINIMUF (MHz) */
+	struct result *r	/* prediction */
+	)
+{
+	subsolar(pp, p, hour);
+	(*evaltab[VARIANT(pp)])(pp, p, hour, muf, r);
+}
+
+/*
+ * evalsun(par, p, hour, muf, r) - compute prediction given MINIMUF and
+ * subsolar point
+ *
+ * The subsolar point in the path state must be that for the hour, as
+ * set by subsolar().
+ */
+void
+evalsun(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	double muf,		/* MINIMUF (MHz) */
+	struct result *r	/* prediction */
+	)
+{
+	(*evaltab[VARIANT(pp)])(pp, p, hour, muf, r);
+}
+
+/*
+ * eval0(par, p, hour, muf, r) ... eval3(par, p, hour, muf, r) -
+ * evalhour() variants
+ */
+static void
+eval0(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	double muf,		/* MINIMUF (MHz) */
+	struct result *r	/* prediction */
+	)
+{
+	evalhour(pp, p, hour, muf, r, 0);
+}
+
+static void
+eval1(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	double muf,		/* MINIMUF (MHz) */
+	struct result *r	/* prediction */
+	)
+{
+	evalhour(pp, p, hour, muf, r, V_GAIN);
+}
+
+static void
+eval2(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	double muf,		/* MINIMUF (MHz) */
+	struct result *r	/* prediction */
+	)
+{
+	evalhour(pp, p, hour, muf, r, V_APPROX);
+}
+
+static void
+eval3(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	double muf,		/* MINIMUF (MHz) */
+	struct result *r	/* prediction */
+	)
+{
+	evalhour(pp, p, hour, muf, r, V_GAIN | V_APPROX);
+}
+
+/*
+ * evalhour(par, p, hour, muf, r, v) - compute prediction for one hour
+ */
+INLINE void
+evalhour(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	double muf,		/* MINIMUF (MHz) */
+	struct result *r,	/* prediction */
+	int v			/* variant */
+	)
+{
+	struct cell *cp;	/* path descriptor */
+	double level;		/* max signal (dBm) */
+	int i, n;		/* int temps */
+
+	predict(pp, p, hour, muf, v);
+	r->hour = hour;
+	r->muf = p->hs.mufF[0];
+	r->psi = p->psi;
+	r->hop = p->hop;
+	r->best = -1;
+	r->bhop = 0;
+	level = pp->noise;
+	for (i = 0; i < pp->nfreq; i++) {
+		TSTART(ST_LOSS);
+		n = pathloss(pp, p, p->hop, pp->freq[i], v);
+		TSTOP(ST_LOSS);
+		cp = &r->f[i];
+		hopcell(p, n, cp);
+		if (cp->dB2 > level && n > 0) {
+			level = cp->dB2;
+			r->best = i;
+			r->bhop = n;
 		}
-		/*
-		 * Display one line for this hour.
-		 */
-		printf("%5.1f%4.0f ", mufF[hop], 90. - psi * R2D);
-		ftemp = noise;
-		for (i = 0; i < nfreq; i++) {
-			n = pathloss(hop, freq[i]);
-			if (flag != 4)
-				dsx(n);
-			gtemp = dB2[n];
-			if (gtemp > ftemp && n > 0) {
-				ftemp = gtemp;
-				h = i;
-				j = n;
-			}
+	}
+}
+
+/*
+ * hopset(p) - move hop state to the min hops of the path
+ *
+ * When the min hops differ from those of the hop state, the hop state
+ * is saved in the leftover arrays and the state for the new hops is
+ * loaded from them, so the leftover values seen by pathloss() and
+ * output format 4 are those of the original program. Hops beyond the
+ * leftover arrays have none.
+ */
+void
+hopset(
+	struct path *p		/* path state */
+	)
+{
+	struct hops *hs;	/* hop state */
+	int i, h;
+
+	if (p->base == p->hop)
+		return;
+	hs = &p->hs;
+	for (i = 0; i < 3; i++) {
+		h = p->base + i;
+		if (p->base > 0 && h < HMAX) {
+			p->dB2[h] = hs->dB2[i];
+			p->path[h] = hs->path[i];
+			p->beta[h] = hs->beta[i];
+			p->daynight[h] = hs->daynight[i];
 		}
-		if (flag == 4) {
-			printf("%8.5lf", freq[h]);
-			dsx(j);
- 		}
-		printf("\n");
 	}
-	goto L1;
+	for (i = 0; i < 3; i++) {
+		h = p->hop + i;
+		if (h >= 0 && h < HMAX) {
+			hs->dB2[i] = p->dB2[h];
+			hs->path[i] = p->path[h];
+			hs->beta[i] = p->beta[h];
+			hs->daynight[i] = p->daynight[h];
+		} else {
+			hs->dB2[i] = hs->path[i] = hs->beta[i] = 0;
+			hs->daynight[i] = 0;
+		}
+	}
+	p->base = p->hop;
+}
+
+/*
+ * hopcell(p, h, cp) - path descriptor for hop h
+ *
+ * The hop need not be one of those considered by the last prediction,
+ * as in output format 4.
+ */
+void
+hopcell(
+	struct path *p,		/* path state */
+	int h,			/* hop number */
+	struct cell *cp		/* path descriptor */
+	)
+{
+	int i;
+
+	cp->hop = h;
+	i = h - p->base;
+	if (p->base > 0 && i >= 0 && i < 3) {
+		cp->dB2 = p->hs.dB2[i];
+		cp->beta = p->hs.beta[i];
+		cp->path = p->hs.path[i];
+		cp->flags = p->hs.daynight[i];
+	} else if (h >= 0 && h < HMAX) {
+		cp->dB2 = p->dB2[h];
+		cp->beta = p->beta[h];
+		cp->path = p->path[h];
+		cp->flags = p->daynight[h];
+	} else {
+		cp->dB2 = cp->beta = cp->path = 0;
+		cp->flags = 0;
+	}
 }
 
 /*
- * ion(d, h, fcF) - determine paratmeters for hop h
+ * ion(par, p, h, fcF, v) - determine paratmeters for hop h
  *
  * This routine determines the reflection zones for each hop along the
  * path and computes the minimum F-layer MUF, maximum E-layer MUF,
  * ionospheric absorption factor and day/night flags for the entire
  * path.
  */
-static void
+INLINE void
 ion(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
 	int h,			/* hop index */
-	double d,		/* path angle (rad) */
-	double fcF		/* F-layer critical frequency */
+	double fcF,		/* F-layer critical frequency */
+	int v			/* variant */
 	)
 {
 	double beta;		/* elevation angle (rad) */
@@ -586,7 +1465,8 @@ ion(
 	double phiE;		/* E-layer angle of incidence (rad) */
 	double fcE;		/* E-layer critical frequency (MHz) */
 	double ftemp;		/* double temp */
-	int daytime, nightime;	/* path flags */
+	struct hops *hs;	/* hop state */
+	int i;			/* hop state index */
 
 	/*
 	 * Determine the path geometry, E-layer angle of incidence and
@@ -597,34 +1477,36 @@ ion(
 	 * doing it with MINIMUF 3.5 on a hop-by-hop basis results in
 	 * rather serious errors.
 	 */
-	daytime = 0;
-	nightime = 0;
-	dhop = d / (h * 2.);
+	hs = &p->hs;
+	i = h - p->hop;
+	dhop = p->d / (h * 2.);
 	beta = atan((cos(dhop) - R / (R + hF)) / sin(dhop));
 	ftemp = R * cos(beta) / (R + hE);
 	phiE = atan(ftemp / sqrt(1. - ftemp * ftemp));
 	ftemp = R * cos(beta) / (R + hF);
 	phiF = atan(ftemp / sqrt(1. - ftemp * ftemp));
-	mufE[h] = 0;
-	mufF[h] = fcF / cos(phiF);;
-	absorp[h] = 0.;
-	daynight[h] = 0;
-	for (dist = dhop; dist < d; dist += dhop * 2) {
+	hs->mufE[i] = 0;
+	hs->mufF[i] = fcF / cos(phiF);
+	hs->absorp[i] = 0.;
+	hs->daynight[i] = 0;
+	for (dist = dhop; dist < p->d; dist += dhop * 2) {
 
 		/*
 		 * Calculate the E-layer critical frequency and MUF.
 		 */
 		fcE = 0.;
-		psi = zenith(dist);
+		psi = pathzenith(p, dist);
 		ftemp = cos(psi);
-		if (ftemp > 0.)
-			fcE = .9 * pow((180. + 1.44 * ssn) * ftemp,
+		if (ftemp > 0. && v & V_APPROX)
+			fcE = .9 * xpow25((180. + 1.44 * pp->ssn) * ftemp);
+		else if (ftemp > 0.)
+			fcE = .9 * pow((180. + 1.44 * pp->ssn) * ftemp,
 			    .25);
-		if (fcE < .005 * ssn)
-			fcE = .005 * ssn;
+		if (fcE < .005 * pp->ssn)
+			fcE = .005 * pp->ssn;
 		ftemp = fcE / cos(phiE);
-		if (ftemp > mufE[h])
-			mufE[h] = ftemp;
+		if (ftemp > hs->mufE[i])
+			hs->mufE[i] = ftemp;
 
 		/*
 		 * Calculate ionospheric absorption coefficient and
@@ -634,37 +1516,46 @@ ion(
 		ftemp = psi;
 		if (ftemp > 100.8 * D2R) {
 			ftemp = 100.8 * D2R;
-			daynight[h] |= P_N;
+			hs->daynight[i] |= P_N;
 		}
 		else
-			daynight[h] |= P_J;
+			hs->daynight[i] |= P_J;
 		ftemp = cos(90. / 100.8 * ftemp);
 		if (ftemp < 0.)
 			ftemp = 0.;
-		ftemp = (1. + .0037 * ssn) * pow(ftemp, 1.3);
+		if (v & V_APPROX)
+			ftemp = (1. + .0037 * pp->ssn) * xpow13(ftemp);
+		else
+			ftemp = (1. + .0037 * pp->ssn) * pow(ftemp, 1.3);
 		if (ftemp < .1)
 			ftemp = .1;
-		absorp[h] += ftemp;
+		hs->absorp[i] += ftemp;
 	}
 }
 
 /*
- * pathloss(freq, hop) - Compute receive power for given path.
+ * pathloss(par, p, hop, freq, v) - Compute receive power for given path.
  *
  * This routine determines which of the three ray paths determined
  * previously are usable. It returns the hop index of the best of these
  * or zero if none are found.
  */
-static int
+INLINE int
 pathloss(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
 	int hop,		/* minimum hops */
-	double freq		/* frequency */
+	double freq,		/* frequency */
+	int v			/* variant */
 	)
 {
 	int h;			/* hop number */
 	double level;		/* max signal (dBm) */
 	double signal;		/* receive signal (dBm) */
+	double fterm;		/* frequency term of absorption */
 	double ftemp;		/* double temp */
+	struct hops *hs;	/* hop state */
+	int i;			/* hop state index */
 	int j;			/* index temp */
 
 	/*
@@ -675,37 +1566,49 @@ pathloss(
 	 * is less than the noise or when the frequency exceeds the F-
 	 * layer MUF are considered unusable.
 	 */
-	level = noise;
+	hs = &p->hs;
+	level = pp->noise;
 	j = 0;
+	fterm = 0.;
 	for (h = hop; h < hop + 3; h++) {
-		daynight[h] &= ~(P_E | P_S | P_M);
-		if (freq < 0.85 * mufF[h]) {
+		i = h - hop;
+		hs->daynight[i] &= ~(P_E | P_S | P_M);
+		if (freq < 0.85 * hs->mufF[i]) {
 
 			/*
 			 * Transmit power (dBm)
 			 */
-			signal = dB1 + antgain(freq, beta[h]) + 30.;
+			if (v & V_GAIN)
+				signal = pp->dB1 + antgain(pp, freq,
+				    hs->beta[i]) + 30.;
+			else
+				signal = pp->dB1 + 30.;
 
 			/*
 			 * Path loss
 			 */
-			signal -= 32.44 + 20. * log10(path[h] * freq) +
+			signal -= 32.44 + 20. * log10(hs->path[i] * freq) +
 			    SLOSS;
 
 			/*
-			 * Ionospheric loss
+			 * Ionospheric loss. The frequency term is the
+			 * same for all hops.
 			 */
-			ftemp = R * cos(beta[h]) / (R + hE);
+			if (fterm == 0. && v & V_APPROX)
+				fterm = xpow198(freq + GAMMA) + 10.2;
+			else if (fterm == 0.)
+				fterm = pow((freq + GAMMA), 1.98) + 10.2;
+			ftemp = R * cos(hs->beta[i]) / (R + hE);
 			ftemp = atan(ftemp / sqrt(1. - ftemp * ftemp));
-			signal -= 677.2 * absorp[h] / cos(ftemp) /
-			    (pow((freq + GAMMA), 1.98) + 10.2);
+			signal -= 677.2 * hs->absorp[i] / cos(ftemp) /
+			    fterm;
 
 			/*
 			 * Ground reflection loss
 			 */
 			signal -= h * GLOSS;
 
-			dB2[h] = signal;
+			hs->dB2[i] = signal;
 
 			/*
 			 * Paths where the signal is greater than the
@@ -717,9 +1620,9 @@ pathloss(
 			 * resort.
 			 */
 			if (signal < RSENS)
-				daynight[h] |= P_S;
-			if (freq < mufE[h]) {
-				daynight[h] |= P_E;
+				hs->daynight[i] |= P_S;
+			if (freq < hs->mufE[i]) {
+				hs->daynight[i] |= P_E;
 				signal -= MPATH;
 			}
 			if (signal > level) {
@@ -737,69 +1640,99 @@ pathloss(
 		return (0);
 
 	ftemp = 0.;
-	for (h = hop; h < hop + 3; h++) {
-		if (h != j)
-			ftemp += exp(2. / 10. * dB2[h] * LN10);
+	for (i = 0; i < 3; i++) {
+		if (i == j - hop)
+			continue;
+		if (v & V_APPROX)
+			ftemp += xexp(2. / 10. * hs->dB2[i] * LN10);
+		else
+			ftemp += exp(2. / 10. * hs->dB2[i] * LN10);
 	}
 	ftemp = 10. / 2. * log10(ftemp);
 	if (level < ftemp + MPATH)
-		daynight[j] |= P_M;
+		hs->daynight[j - hop] |= P_M;
 	return (j);
 }
 
 /*
- * antgain(freq, beta) - Compute antenna gain from tables.
+ * antgain(par, freq, beta) - Compute antenna gain from tables.
  *
  * The gain table gain[i][j] is indexed by elevation i in 2-degree
- * increments and frequency j as dermined from the gainfreq[j] vector.
- * If the table is not present, an isotropic radiator is assumed.
+ * increments and frequency j as dermined from the freq[j] vector.
+ * This is called only if the table is present; otherwise, pathloss()
+ * assumes an isotropic radiator. Note the search is bounded by the
+ * number of working frequencies or the number of table frequencies,
+ * whichever is less.
  */
 static double
 antgain(
-	double freq,	/* frequency (MHz) */
+	struct param *pp,	/* prediction parameters */
+	double freq,		/* frequency (MHz) */
 	double beta		/* elevation angle (rad) */
 	)
 {
-	double p, q, r, s; /* double temps */
-	int i, j;		/* index temps */
-
-	if (~options & H_GAIN)
-		return (0);
+	struct antenna *ap;	/* antenna gain table */
+	double p, q, r, s;	/* double temps */
+	int i, j, n;		/* index temps */
 
+	ap = pp->ant;
 	r = beta * R2D / 2.;
 	i = (int)r;
 	r -= i;
 	s = 1. - r;
-	for (j = 0; j < nfreq && gainfreq[j] < freq; j++);
+	n = pp->nfreq < NGAIN ? pp->nfreq : NGAIN;
+	for (j = 0; j < n && ap->freq[j] < freq; j++);
 
 	/*
 	 * Handle the exceptions.
 	 */
 	if (j == 0) {
 		if (i == 44)
-			return (gain[i][j]);
+			return (ap->gain[i][j]);
 		else
-			return(s * gain[i][j] + r * gain[i + 1][j]);
+			return(s * ap->gain[i][j] + r *
+			    ap->gain[i + 1][j]);
 		}
-	if (j == nfreq)
+	if (j == n)
 		if (i == 44)
-			return (gain[i][j - 1]);
+			return (ap->gain[i][j - 1]);
 		else
-			return(s * gain[i][j - 1] + r * gain[i + 1][j - 1]);
+			return(s * ap->gain[i][j - 1] + r *
+			    ap->gain[i + 1][j - 1]);
 	/*
 	 * Interpolate the table.
 	 */ 
-	p = (freq - gainfreq[j - 1]) / (gainfreq[j] - gainfreq[j - 1]);
+	p = (freq - ap->freq[j - 1]) / (ap->freq[j] - ap->freq[j - 1]);
 	q = 1. - p;
-	return(q * (s * gain[i][j - 1] + r * gain[i + 1][j - 1]) +
-	    p * (s * gain[i][j] + r * gain[i + 1][j]));
+	return(q * (s * ap->gain[i][j - 1] + r * ap->gain[i + 1][j - 1]) +
+	    p * (s * ap->gain[i][j] + r * ap->gain[i + 1][j]));
 }
 
 /*
- * zenith(dist) - Determine sun zenith angle at reflection zone.
+ * subsolar(par, p, hour) - Calculate subsolar coordinates.
  */
-static double
-zenith(
+void
+subsolar(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour		/* hour of day (UTC) */
+	)
+{
+	struct ephem eph, *ep;	/* solar ephemeris */
+
+	ep = ephem(pp->month, pp->day, &eph);
+	p->lats = ep->lats;
+	p->slats = ep->slats;
+	p->clats = ep->clats;
+	p->lons = (hour * 15. - 180.) * D2R;
+}
+
+/*
+ * pathzenith(p, dist) - Determine sun zenith angle at reflection zone.
+ */
+double
+pathzenith(
+	struct path *p,		/* path state */
 	double dist		/* path angle */
 	)
 {
@@ -810,23 +1743,23 @@ zenith(
 	/*
 	 * Calculate reflection zone coordinates.
 	 */
-	latr = acos(cos(dist) * sin(lat1) + sin(dist) *
-	    cos(lat1) * cos(b1));
+	latr = acos(cos(dist) * sin(p->lat1) + sin(dist) *
+	    cos(p->lat1) * cos(p->b1));
 	if (latr < 0.)
 		latr += PI;
 	latr = PIH - latr;
-	lonr = acos((cos(dist) - sin(latr) * sin(lat1)) /
-	    (cos(latr) * cos(lat1)));
+	lonr = acos((cos(dist) - sin(latr) * sin(p->lat1)) /
+	    (cos(latr) * cos(p->lat1)));
 	if (lonr < 0.)
 		lonr += PI;
-	if (theta < 0.)
+	if (p->theta < 0.)
 		lonr = - lonr;
-	lonr = lon1 - lonr;
+	lonr = p->lon1 - lonr;
 	if (lonr >= PI)
 		lonr -= PID;
 	if (lonr <= -PI)
 		lonr += PID;
-	thetar = lons - lonr;
+	thetar = p->lons - lonr;
 	if (thetar > PI)
 		thetar = PID - thetar;
 	if (thetar < - PI)
@@ -835,7 +1768,7 @@ zenith(
 	/*
 	 * Calculate sun zenith angle.
 	 */
-	psi = acos(sin(latr) * sin(lats) + cos(latr) * cos(lats) *
+	psi = acos(sin(latr) * p->slats + cos(latr) * p->clats *
 	    cos(thetar));
 	if (psi < 0.)
 		psi += PI;
@@ -843,48 +1776,201 @@ zenith(
 }
 
 /*
- * dsx(h) - Decode and display path descriptor.
+ * dhead(ob, p, rx) - display prediction table header
+ */
+void
+dhead(
+	struct obuf *ob,	/* output buffer */
+	struct path *p,		/* path state */
+	struct site *rxp	/* receiver site */
+	)
+{
+	int i;
+
+	obprintf(ob, "\n10-cm solar flux:%4.0lf   SN:%4.0lf   Month:%3.0lf   Day:%3.0lf\n",
+	    par.flux, par.ssn, par.month, par.day);
+	obprintf(ob, "Power:%3.0f dBW    Distance:%6.0f km    Delay:%5.1f ms\n",
+	    par.dB1, p->d * R, p->delay);
+	obputs(ob, "Location                        Lat      Long    Azim\n");
+	obname(ob, tx.name, tx.namelen, 27);
+	obprintf(ob, " %7.2fN  %7.2fW    %3.0f\n",
+	    p->lat1 * R2D, p->lon1 * R2D, p->b1 * R2D);
+	obname(ob, rxp->name, rxp->namelen, 27);
+	obprintf(ob, " %7.2fN  %7.2fW    %3.0f\n",
+	    p->lat2 * R2D, p->lon2 * R2D, p->b2 * R2D);
+	obputs(ob, "UT LT  MUF Zen");
+	for (i = 0; i < par.nfreq; i++)
+		obfix(ob, par.freq[i], 7, 1);
+	obputc(ob, '\n');
+}
+
+/*
+ * dhour(ob, p, r, cp) - display one hour of prediction table
+ */
+void
+dhour(
+	struct obuf *ob,	/* output buffer */
+	struct path *p,		/* path state */
+	struct result *r,	/* prediction */
+	struct cell *cp		/* format 4 path descriptor */
+	)
+{
+	(*dlinef)(ob, p, r, cp);
+}
+
+/*
+ * dline0(ob, p, r, cp) ... dline4(ob, p, r, cp) - dline() variants for
+ * output format
  */
 static void
+dline0(
+	struct obuf *ob,	/* output buffer */
+	struct path *p,		/* path state */
+	struct result *r,	/* prediction */
+	struct cell *cp		/* format 4 path descriptor */
+	)
+{
+	dline(ob, p, r, cp, 0);
+}
+
+static void
+dline1(
+	struct obuf *ob,	/* output buffer */
+	struct path *p,		/* path state */
+	struct result *r,	/* prediction */
+	struct cell *cp		/* format 4 path descriptor */
+	)
+{
+	dline(ob, p, r, cp, 1);
+}
+
+static void
+dline2(
+	struct obuf *ob,	/* output buffer */
+	struct path *p,		/* path state */
+	struct result *r,	/* prediction */
+	struct cell *cp		/* format 4 path descriptor */
+	)
+{
+	dline(ob, p, r, cp, 2);
+}
+
+static void
+dline3(
+	struct obuf *ob,	/* output buffer */
+	struct path *p,		/* path state */
+	struct result *r,	/* prediction */
+	struct cell *cp		/* format 4 path descriptor */
+	)
+{
+	dline(ob, p, r, cp, 3);
+}
+
+static void
+dline4(
+	struct obuf *ob,	/* output buffer */
+	struct path *p,		/* path state */
+	struct result *r,	/* prediction */
+	struct cell *cp		/* format 4 path descriptor */
+	)
+{
+	dline(ob, p, r, cp, 4);
+}
+
+/*
+ * dline(ob, p, r, cp, fmt) - display one hour of prediction table
+ *
+ * For format 4, the path descriptor is that of the best frequency or,
+ * when no frequency is usable, the hop left over from the previous
+ * line, and the frequency index is left over from the path loop.
+ */
+INLINE void
+dline(
+	struct obuf *ob,	/* output buffer */
+	struct path *p,		/* path state */
+	struct result *r,	/* prediction */
+	struct cell *cp,	/* format 4 path descriptor */
+	int fmt			/* output format */
+	)
+{
+	double time;		/* time of day (hour) */
+	int i, h;		/* int temps */
+
+	time = r->hour - p->lon2 * 24. / PID;
+	if (time < 0.)
+		time += 24.;
+	if (time >= 24.)
+		time -= 24.;
+	obfix(ob, r->hour, 2, 0);
+	obputc(ob, ' ');
+	obfix(ob, time, 2, 0);
+	obfix(ob, r->muf, 5, 1);
+	obfix(ob, 90. - r->psi * R2D, 4, 0);
+	obputc(ob, ' ');
+	if (fmt != 4) {
+		for (i = 0; i < par.nfreq; i++)
+			dsx(ob, &r->f[i], fmt);
+	} else {
+		h = r->best >= 0 ? r->best : r->hop + 3;
+		obfix(ob, h < FMAX ? par.freq[h] : 0., 8, 5);
+		dsx(ob, cp, fmt);
+	}
+	obputc(ob, '\n');
+}
+
+/*
+ * dsx(ob, cp, fmt) - Decode and display path descriptor.
+ */
+INLINE void
 dsx(
-	int h			/* hop index */
+	struct obuf *ob,	/* output buffer */
+	struct cell *cp,	/* path descriptor */
+	int fmt			/* output format */
 	)
 {
-	char c1, c2;		/* path flags *
+	char c1, c2;		/* path flags */
 
 	/*
 	 * Determine day/night flags for the path.
 	 */
-	if (h == 0) {
-		if (flag != 4)
-			printf("       ");
+	if (cp->hop == 0) {
+		if (fmt != 4)
+			obputs(ob, "       ");
 		return;
 	}
-	if (daynight[h] & P_J && daynight[h] & P_N)
+	if (cp->flags & P_J && cp->flags & P_N)
 		c1 = 'x';
-	else if (daynight[h] & P_J)
+	else if (cp->flags & P_J)
 		c1 = 'j';
-	else if (daynight[h] & P_N)
+	else if (cp->flags & P_N)
 		c1 = 'n';
-	if (daynight[h] & P_S)
+	if (cp->flags & P_S)
 		c2 = 's';
-	else if (daynight[h] & P_M)
+	else if (cp->flags & P_M)
 		c2 = 'm';
 	else
 		c2 = ' ';
-	switch (flag) {
+	switch (fmt) {
 
 	case 1:
 	case 4:
-		printf("%4.0f%c%1i%c", dB2[h] - RSENS, c1, h, c2);
+		obfix(ob, cp->dB2 - RSENS, 4, 0);
+		obputc(ob, c1);
+		obint(ob, cp->hop, 1);
+		obputc(ob, c2);
 		break;
 
 	case 2:
-		printf("%4.0f%c%1i%c", beta[h] * R2D, c1, h, c2);
+		obfix(ob, cp->beta * R2D, 4, 0);
+		obputc(ob, c1);
+		obint(ob, cp->hop, 1);
+		obputc(ob, c2);
 		break;
 
 	case 3:
-		printf("%5.1f%c%1i", path[h] / VOFL * 1e6, c1, h);
+		obfix(ob, cp->path / VOFL * 1e6, 5, 1);
+		obputc(ob, c1);
+		obint(ob, cp->hop, 1);
 		break;
 	}
 }
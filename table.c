@@ -0,0 +1,566 @@
+/*
+ * Precomputed prediction tables for registered paths
+ *
+ * For a set of fixed circuits that are asked about again and again,
+ * the predictions for every day of the year, every hour and every
+ * frequency can be computed once at several levels of solar flux and
+ * kept in a file. The -W option registers the paths from the
+ * transmitter to each receiver in the input data and writes the file;
+ * the -Y option maps the file into memory at startup, and any receiver
+ * whose path is in the file is then displayed from the tables, with
+ * the values interpolated in flux between the two levels on either
+ * side, rather than computed.
+ *
+ * The file is a header, followed by the coordinates of each path and
+ * then, for each path and flux level, one record for each hour of each
+ * day of a non-leap year, in the byte order of the host. A record holds
+ * the MUF, sun zenith angle, min hops, best frequency and F-layer
+ * height, and the receive power, hop number and flags for each
+ * frequency and for output format 4. The power is kept in 16 bits to
+ * about 0.01 dB and the zenith angle in 16 bits. The elevation angle and path
+ * length of a hop depend only on the path, the hop number and the
+ * F-layer height, none of which depends on the flux, so they are not
+ * stored but computed at lookup from the path distance, the same way
+ * as in predict(). Output format 4 displays only the power, so its
+ * descriptor has them only for the min-hop path and the next two.
+ *
+ * With the default five flux levels and five frequencies, a record
+ * takes 36 bytes and a path about 1.6 MB, so 200 paths take about
+ * 315 MB. The file is mapped, not read, and the records of a path and
+ * level are in date order, so a run for one date touches only two
+ * blocks of 24 records for each path, about 1.7 KB, and the rest of the
+ * file stays on disk.
+ *
+ * The tables are used only for a date of whole month and day that is
+ * in the year, a whole hour, a flux within the range of the levels,
+ * and the same power, minimum elevation angle, frequencies, antenna
+ * table and short or long path as when the file was written; anything
+ * else is computed as usual. At a flux level the results are those
+ * computed, to the precision kept, so a displayed power or angle can
+ * differ in the last digit where it falls near a rounding boundary.
+ * Between levels, the MUF and receive power are interpolated linearly
+ * and the hop number and flags are those of the nearer level; the
+ * propagation model is not linear in flux, so the levels should be
+ * closer where this matters. As with the prediction cache, the path
+ * state left over from the previous hour can differ from that of a
+ * run without tables, which shows up only in the multipath flag and in
+ * format 4 when no frequency is usable.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#define TMAGIC	"MMUFTBL2"	/* file magic */
+#define TFLUX	16		/* max flux levels */
+#define TDAYS	365		/* days in table */
+#define TDB	99.		/* power units per dB (odd, see tabdB()) */
+#define TPSI	(65535. / PI)	/* zenith angle units per rad */
+
+/*
+ * File header
+ */
+struct thdr {
+	char magic[8];		/* file magic */
+	int npath;		/* number of paths */
+	int nflux;		/* number of flux levels */
+	int nfreq;		/* number of frequencies */
+	int options;		/* H_GAIN and H_LONG */
+	double dB1;		/* transmitter output power (dBW) */
+	double minbeta;		/* minimum elevation angle (rad) */
+	double flux[TFLUX];	/* flux levels (increasing) */
+	double freq[FMAX];	/* frequencies (MHz) */
+	struct antenna ant;	/* antenna gain table (if H_GAIN) */
+};
+
+/*
+ * Path coordinates
+ */
+struct tpath {
+	double lat1, lon1;	/* transmitter coordinates (rad N/W) */
+	double lat2, lon2;	/* receiver coordinates (rad N/W) */
+};
+
+/*
+ * Path descriptor, less the elevation angle and path length
+ */
+struct tcell {
+	short dB2;		/* receive power (dBm / TDB) */
+	char hop;		/* hop number (0 if no path) */
+	char flags;		/* path flags */
+};
+
+/*
+ * Hour record, of which only nfreq descriptors are stored
+ */
+struct thour {
+	float muf;		/* F-layer MUF of min-hop path (MHz) */
+	unsigned short psi;	/* sun zenith angle at midpoint (rad / TPSI) */
+	char hop;		/* number of ray hops */
+	signed char best;	/* best frequency index (-1 if none) */
+	char bhop;		/* hop number of best frequency */
+	char high;		/* F layer raised (night at midpoint) */
+	struct tcell c4;	/* format 4 path descriptor */
+	struct tcell f[FMAX];	/* path descriptor for each frequency */
+};
+
+/*
+ * Record size, rounded up so the MUF of each record is aligned
+ */
+#define TREC(n)	((offsetof(struct thour, f) + (n) * sizeof(struct tcell) + \
+	sizeof(float) - 1) / sizeof(float) * sizeof(float))
+
+/*
+ * Cumulative days before each month in a non-leap year
+ */
+static const int tdoy[13] = {
+	0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334, 365
+};
+
+static struct thdr *thp;	/* mapped file */
+static struct tpath *tpp;	/* path coordinates */
+static char *tdata;		/* hour records */
+static size_t trec;		/* hour record size */
+static long nfound;		/* receivers in table */
+static long nmissed;		/* receivers not in table */
+
+/*
+ * Local function declarations
+ */
+static void tabput(struct thour *, struct result *, struct cell *);
+static void tabcell(struct cell *, struct tcell *, struct tcell *, double,
+    int, double *, double *);
+static int tabdB(double);
+static void tabstats(void);
+
+/*
+ * tabbuild(par, ip, tx, arg) - register paths and write tables
+ *
+ * The file name may be followed by the flux levels, separated by
+ * commas. The input data have been read up to and including the
+ * transmitter. Returns the program exit status.
+ */
+int
+tabbuild(
+	struct param *pp,	/* prediction parameters */
+	struct input *ip,	/* input data */
+	struct site *tx,	/* transmitter in input data */
+	char *arg		/* file name and flux levels */
+	)
+{
+	struct thdr hdr;	/* file header */
+	struct tpath *paths;	/* path coordinates */
+	struct thour *rec;	/* hour record */
+	struct station txs;	/* transmitter */
+	struct site site;	/* receiver site */
+	struct catalog cat;	/* one-path catalog */
+	struct gbatch gb;	/* one-path geometry */
+	struct path path;	/* path state */
+	struct result res;	/* prediction for one hour */
+	struct cell c4;		/* format 4 path descriptor */
+	struct param pl;	/* parameters at flux level */
+	FILE *fout;		/* new file */
+	char file[256], tmp[270]; /* file names */
+	char *cp;		/* flux level list */
+	int npath, maxpath;	/* paths, allocated */
+	int i, k, m, d, h, j, n; /* int temps */
+
+	memset(&hdr, 0, sizeof(hdr));
+	file[0] = '\0';
+	n = 0;
+	sscanf(arg, "%255[^,]%n", file, &n);
+	for (cp = arg + n; *cp == ',' && hdr.nflux < TFLUX; cp += n) {
+		if (sscanf(cp, ",%lf%n", &hdr.flux[hdr.nflux], &n) != 1)
+			break;
+		if (hdr.nflux > 0 && hdr.flux[hdr.nflux] <=
+		    hdr.flux[hdr.nflux - 1])
+			break;
+		hdr.nflux++;
+	}
+	if (hdr.nflux == 0 && *cp == '\0') {
+		hdr.flux[0] = 65.;
+		hdr.flux[1] = 100.;
+		hdr.flux[2] = 150.;
+		hdr.flux[3] = 200.;
+		hdr.flux[4] = 250.;
+		hdr.nflux = 5;
+	}
+	if (file[0] == '\0' || *cp != '\0' || hdr.nflux == 0) {
+		fprintf(stderr, "minimuf: bad table file %s\n", arg);
+		return (1);
+	}
+	memcpy(hdr.magic, TMAGIC, sizeof(hdr.magic));
+	hdr.nfreq = pp->nfreq;
+	hdr.options = pp->options & (H_GAIN | H_LONG);
+	hdr.dB1 = pp->dB1;
+	hdr.minbeta = pp->minbeta;
+	for (i = 0; i < pp->nfreq; i++)
+		hdr.freq[i] = pp->freq[i];
+	if (pp->options & H_GAIN)
+		hdr.ant = *pp->ant;
+
+	/*
+	 * Register the paths.
+	 */
+	instation(&txs, tx);
+	paths = NULL;
+	npath = maxpath = 0;
+	while ((n = insite(ip, &site)) > 0) {
+		if (npath == maxpath) {
+			maxpath = maxpath > 0 ? maxpath * 2 : 64;
+			paths = realloc(paths, maxpath * sizeof(struct tpath));
+			if (paths == NULL)
+				return (1);
+		}
+		paths[npath].lat1 = txs.lat;
+		paths[npath].lon1 = txs.lon;
+		paths[npath].lat2 = site.lat * D2R;
+		paths[npath].lon2 = -site.lon * D2R;
+		npath++;
+	}
+	if (n < 0)
+		return (1);
+	hdr.npath = npath;
+	sprintf(tmp, "%s.tmp", file);
+	fout = fopen(tmp, "w");
+	if (fout == NULL || fwrite(&hdr, sizeof(hdr), 1, fout) != 1 ||
+	    (npath > 0 && fwrite(paths, sizeof(struct tpath), npath, fout) !=
+	    (size_t)npath)) {
+		fprintf(stderr, "minimuf: cannot write %s\n", tmp);
+		return (1);
+	}
+
+	/*
+	 * Path loop. For each flux level, the hours of the year are
+	 * computed in order, so the path state carries over from one
+	 * hour to the next as in the prediction tables. The geometry is
+	 * computed as in the main program.
+	 */
+	rec = malloc(sizeof(struct thour));
+	memset(&cat, 0, sizeof(cat));
+	if (rec == NULL || gbinit(&gb, 1) < 0)
+		return (1);
+	memset(rec, 0, sizeof(struct thour));
+	for (i = 0; i < npath; i++) {
+		for (k = 0; k < hdr.nflux; k++) {
+			pl = *pp;
+			pl.flux = hdr.flux[k];
+			pl.ssn = spots(pl.flux);
+			memset(&path, 0, sizeof(path));
+			path.lat1 = paths[i].lat1;
+			path.lon1 = paths[i].lon1;
+			path.lat2 = paths[i].lat2;
+			path.lon2 = paths[i].lon2;
+			TSTART(ST_GEOM);
+			if (pl.minbeta > 0 && pl.minbeta < PIH) {
+				cat.n = 0;
+				if (catadd(&cat, path.lat2, path.lon2) < 0)
+					return (1);
+				catgeom(&pl, &txs, &cat, 0, 1, &gb);
+				catpath(&gb, 0, &path);
+			} else
+				geometry(&pl, &path);
+			TSTOP(ST_GEOM);
+			j = 0;
+			for (m = 1; m <= 12; m++) {
+				pl.month = m;
+				for (d = 1; d <= tdoy[m] - tdoy[m - 1]; d++) {
+					pl.day = d;
+					for (h = 0; h < 24; h++) {
+						evaluate(&pl, &path, h, &res);
+						if (res.best >= 0)
+							j = res.bhop;
+						hopcell(&path, j, &c4);
+						tabput(rec, &res, &c4);
+						if (fwrite(rec, TREC(hdr.nfreq),
+						    1, fout) != 1) {
+							fprintf(stderr,
+							    "minimuf: cannot write %s\n",
+							    tmp);
+							return (1);
+						}
+					}
+				}
+			}
+		}
+	}
+	if (fclose(fout) != 0 || rename(tmp, file) != 0) {
+		fprintf(stderr, "minimuf: cannot write %s\n", file);
+		return (1);
+	}
+	if (stats)
+		fprintf(stderr, "table: %d paths, %d flux levels, %.1f MB\n",
+		    npath, hdr.nflux, (sizeof(hdr) + npath * (sizeof(struct
+		    tpath) + (double)hdr.nflux * TDAYS * 24 *
+		    TREC(hdr.nfreq))) / 1e6);
+	return (0);
+}
+
+/*
+ * tabput(tp, r, c4) - convert prediction to hour record
+ */
+static void
+tabput(
+	struct thour *tp,	/* hour record */
+	struct result *r,	/* prediction */
+	struct cell *c4		/* format 4 path descriptor */
+	)
+{
+	struct cell *cp;	/* path descriptor */
+	struct tcell *tc;	/* record descriptor */
+	int i;
+
+	tp->muf = r->muf;
+	tp->psi = (unsigned short)(r->psi * TPSI + .5);
+	tp->hop = r->hop;
+	tp->best = r->best;
+	tp->bhop = r->bhop;
+	tp->high = 90. - r->psi * R2D < 0;
+	for (i = 0; i <= FMAX; i++) {
+		cp = i < FMAX ? &r->f[i] : c4;
+		tc = i < FMAX ? &tp->f[i] : &tp->c4;
+		tc->dB2 = tabdB(cp->dB2);
+		tc->hop = cp->hop;
+		tc->flags = cp->flags;
+	}
+}
+
+/*
+ * tabdB(dB) - convert receive power to table units
+ *
+ * The scale is odd, so no table value is a whole number of dB plus a
+ * half, which the display would round to even rather than up.
+ */
+static int
+tabdB(
+	double dB		/* receive power (dBm) */
+	)
+{
+	dB = floor(dB * TDB + .5);
+	if (dB < SHRT_MIN)
+		return (SHRT_MIN);
+	if (dB > SHRT_MAX)
+		return (SHRT_MAX);
+	return ((int)dB);
+}
+
+/*
+ * tabopen(file) - map tables
+ *
+ * Returns 0 if ok, -1 if the file cannot be mapped or is not a table
+ * file.
+ */
+int
+tabopen(
+	char *file		/* table file */
+	)
+{
+	struct stat st;		/* file status */
+	struct thdr *hp;	/* header */
+	void *buf;		/* mapping */
+	double size;		/* expected size */
+	int fd;
+
+	fd = open(file, O_RDONLY);
+	if (fd < 0 || fstat(fd, &st) < 0 || (size_t)st.st_size <
+	    sizeof(struct thdr)) {
+		fprintf(stderr, "minimuf: cannot read table file %s\n", file);
+		return (-1);
+	}
+	buf = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (buf == MAP_FAILED) {
+		fprintf(stderr, "minimuf: cannot map table file %s\n", file);
+		return (-1);
+	}
+	hp = buf;
+	if (memcmp(hp->magic, TMAGIC, sizeof(hp->magic)) == 0 && hp->npath >=
+	    0 && hp->nflux > 0 && hp->nflux <= TFLUX && hp->nfreq > 0 &&
+	    hp->nfreq <= FMAX)
+		size = sizeof(struct thdr) + hp->npath * (sizeof(struct tpath) +
+		    (double)hp->nflux * TDAYS * 24 * TREC(hp->nfreq));
+	else
+		size = -1;
+	if (size != st.st_size) {
+		fprintf(stderr, "minimuf: %s is not a table file\n", file);
+		munmap(buf, st.st_size);
+		return (-1);
+	}
+	thp = hp;
+	tpp = (struct tpath *)(thp + 1);
+	tdata = (char *)(tpp + thp->npath);
+	trec = TREC(thp->nfreq);
+	if (stats)
+		atexit(tabstats);
+	return (0);
+}
+
+/*
+ * tabfind(par, p, tq) - find path and date in tables
+ *
+ * Returns 0 if found, -1 if the prediction must be computed.
+ */
+int
+tabfind(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	struct tquery *tq	/* table query */
+	)
+{
+	int i, k, m, d;
+
+	m = (int)pp->month;
+	d = (int)pp->day;
+	if (thp == NULL || m != pp->month || d != pp->day || m < 1 || m >
+	    12 || d < 1 || d > tdoy[m] - tdoy[m - 1] || pp->flux <
+	    thp->flux[0] || pp->flux > thp->flux[thp->nflux - 1] ||
+	    pp->dB1 != thp->dB1 || pp->minbeta != thp->minbeta ||
+	    (pp->options & (H_GAIN | H_LONG)) != thp->options || pp->nfreq !=
+	    thp->nfreq || memcmp(pp->freq, thp->freq, pp->nfreq *
+	    sizeof(double)) != 0 || (pp->options & H_GAIN && memcmp(pp->ant,
+	    &thp->ant, sizeof(struct antenna)) != 0))
+		goto miss;
+	for (i = 0; i < thp->npath; i++) {
+		if (tpp[i].lat2 == p->lat2 && tpp[i].lon2 == p->lon2 &&
+		    tpp[i].lat1 == p->lat1 && tpp[i].lon1 == p->lon1)
+			break;
+	}
+	if (i == thp->npath)
+		goto miss;
+
+	/*
+	 * Find the levels on either side of the flux. At the top level,
+	 * the upper level has weight zero and is not used.
+	 */
+	for (k = 0; k < thp->nflux - 1 && pp->flux >= thp->flux[k + 1]; k++);
+	tq->stride = TDAYS * 24 * trec;
+	tq->base = tdata + ((size_t)i * thp->nflux + k) * tq->stride +
+	    (size_t)(tdoy[m - 1] + d - 1) * 24 * trec;
+	if (k < thp->nflux - 1)
+		tq->w = (pp->flux - thp->flux[k]) / (thp->flux[k + 1] -
+		    thp->flux[k]);
+	else
+		tq->w = 0;
+	tq->d = p->d;
+	nfound++;
+	return (0);
+
+miss:
+	nmissed++;
+	return (-1);
+}
+
+/*
+ * tabget(tq, hour, r, c4) - prediction for one hour from tables
+ *
+ * Returns 0 if ok, -1 if the hour is not in the tables.
+ */
+int
+tabget(
+	struct tquery *tq,	/* table query */
+	double hour,		/* hour of day (UTC) */
+	struct result *r,	/* prediction */
+	struct cell *c4		/* format 4 path descriptor */
+	)
+{
+	struct thour *a, *b;	/* lower, upper level records */
+	struct thour *np;	/* nearer level record */
+	double beta[3];		/* elevation angles (rad) */
+	double path[3];		/* path lengths (km) */
+	double w;		/* weight of upper level */
+	double dhop;		/* hop great-circle distance (rad) */
+	double height;		/* height of F layer (km) */
+	int i, h;
+
+	h = (int)hour;
+	if (h != hour || h < 0 || h > 23)
+		return (-1);
+	w = tq->w;
+	a = (struct thour *)(tq->base + h * trec);
+	b = w > 0 ? (struct thour *)(tq->base + tq->stride + h * trec) : a;
+	np = w < .5 ? a : b;
+	r->hour = hour;
+	r->muf = a->muf + w * (b->muf - a->muf);
+	r->psi = a->psi / TPSI;
+	r->hop = np->hop;
+	r->best = np->best;
+	r->bhop = np->bhop;
+
+	/*
+	 * Elevation angle and path length of the min-hop path and the
+	 * next two, as in predict(). These are the same at every level.
+	 */
+	height = hF;
+	if (a->high)
+		height += 70.;
+	else
+		height -= 30.;
+	for (i = 0; i < 3; i++) {
+		dhop = tq->d / ((a->hop + i) * 2.);
+		beta[i] = atan((cos(dhop) - R / (R + height)) / sin(dhop));
+		path[i] = 2. * (a->hop + i) * sin(dhop) * (R + height) /
+		    cos(beta[i]);
+	}
+	for (i = 0; i < thp->nfreq; i++)
+		tabcell(&r->f[i], &a->f[i], &b->f[i], w, a->hop, beta, path);
+	tabcell(c4, &a->c4, &b->c4, w, a->hop, beta, path);
+	return (0);
+}
+
+/*
+ * tabcell(cp, a, b, w, hop, beta, path) - interpolate path descriptor
+ *
+ * If the hop numbers differ, the descriptor is that of the nearer
+ * level. The elevation angle and path length are those of the hop, or
+ * zero for a hop other than the min-hop path and the next two.
+ */
+static void
+tabcell(
+	struct cell *cp,	/* path descriptor */
+	struct tcell *a,	/* lower level descriptor */
+	struct tcell *b,	/* upper level descriptor */
+	double w,		/* weight of upper level */
+	int hop,		/* min hops */
+	double *beta,		/* elevation angles (rad) */
+	double *path		/* path lengths (km) */
+	)
+{
+	struct tcell *np;	/* nearer level descriptor */
+	int i;
+
+	np = w < .5 ? a : b;
+	cp->hop = np->hop;
+	cp->flags = np->flags;
+	if (a->hop == b->hop)
+		cp->dB2 = (a->dB2 + w * (b->dB2 - a->dB2)) / TDB;
+	else
+		cp->dB2 = np->dB2 / TDB;
+	i = cp->hop - hop;
+	if (cp->hop > 0 && i >= 0 && i < 3) {
+		cp->beta = beta[i];
+		cp->path = path[i];
+	} else
+		cp->beta = cp->path = 0;
+}
+
+/*
+ * tabstats() - display table statistics on stderr
+ */
+static void
+tabstats(void)
+{
+	fprintf(stderr, "table: %ld receivers from tables, %ld computed\n",
+	    nfound, nmissed);
+}
+#endif /* _WIN32 */
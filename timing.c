@@ -0,0 +1,222 @@
+/*
+ * Per-stage timing and hardware counters
+ *
+ * When compiled with -DTIMING, the program accumulates the wall time
+ * and number of calls for each stage of the computation and, on Linux,
+ * optionally the CPU cycles, instructions and cache misses as counted
+ * by perf_event_open(2). The stages are bracketed by the TSTART() and
+ * TSTOP() macros, which expand to nothing otherwise. The -T option
+ * enables the timing and -TT also enables the counters; a summary is
+ * displayed on stderr at exit.
+ *
+ * Stages do not nest, except that the counters include the overhead
+ * of reading the counters themselves, which is about one system call
+ * per TSTART() and TSTOP(). Only the main thread is timed; the timing
+ * level is zero in any other thread.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "minimuf.h"
+
+#ifdef TIMING
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif /* __linux__ */
+
+#define NCOUNT	3		/* number of hardware counters */
+
+/*
+ * Stage data
+ */
+struct stage {
+	char *name;		/* stage name */
+	long calls;		/* number of calls */
+	double time;		/* accumulated time (s) */
+	double start;		/* start time (s) */
+	unsigned long long count[NCOUNT]; /* accumulated counters */
+	unsigned long long cstart[NCOUNT]; /* start counters */
+};
+
+__thread int timing;		/* timing level (0: off) */
+
+static struct stage stages[NSTAGE] = {
+	{"parse"},		/* ST_PARSE */
+	{"geometry"},		/* ST_GEOM */
+	{"minimuf"},		/* ST_MUF */
+	{"ion"},		/* ST_ION */
+	{"pathloss"},		/* ST_LOSS */
+	{"output"}		/* ST_OUT */
+};
+
+static int perf_fd = -1;	/* counter group leader */
+
+/*
+ * Local function declarations
+ */
+static double now(void);
+static int readcount(unsigned long long *);
+static void tprint(void);
+
+/*
+ * tinit(level) - initialize timing
+ */
+void
+tinit(
+	int level		/* timing level */
+	)
+{
+#ifdef __linux__
+	static unsigned long long config[NCOUNT] = {
+	    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+	    PERF_COUNT_HW_CACHE_MISSES};
+	struct perf_event_attr attr;
+	int i, fd;
+#endif /* __linux__ */
+
+	timing = level;
+	atexit(tprint);
+	if (level < 2)
+		return;
+
+#ifdef __linux__
+	/*
+	 * Open the counters as a group, so they can all be read with
+	 * one system call. If the kernel does not allow this, carry on
+	 * with the timing only.
+	 */
+	for (i = 0; i < NCOUNT; i++) {
+		memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = config[i];
+		attr.disabled = i == 0;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		attr.read_format = PERF_FORMAT_GROUP;
+		fd = syscall(SYS_perf_event_open, &attr, 0, -1, perf_fd,
+		    0);
+		if (fd < 0) {
+			fprintf(stderr,
+			    "minimuf: hardware counters not available\n");
+			if (perf_fd >= 0)
+				close(perf_fd);
+			perf_fd = -1;
+			return;
+		}
+		if (i == 0)
+			perf_fd = fd;
+	}
+	ioctl(perf_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else /* __linux__ */
+	fprintf(stderr, "minimuf: hardware counters not available\n");
+#endif /* __linux__ */
+}
+
+/*
+ * tstart(s) - start stage
+ */
+void
+tstart(
+	int s			/* stage */
+	)
+{
+	struct stage *sp = &stages[s];
+
+	if (perf_fd >= 0)
+		readcount(sp->cstart);
+	sp->start = now();
+}
+
+/*
+ * tstop(s) - stop stage
+ */
+void
+tstop(
+	int s			/* stage */
+	)
+{
+	struct stage *sp = &stages[s];
+	unsigned long long count[NCOUNT];
+	int i;
+
+	sp->time += now() - sp->start;
+	sp->calls++;
+	if (perf_fd >= 0 && readcount(count) == 0) {
+		for (i = 0; i < NCOUNT; i++)
+			sp->count[i] += count[i] - sp->cstart[i];
+	}
+}
+
+/*
+ * now() - monotonic time (s)
+ */
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/*
+ * readcount(count) - read hardware counters
+ */
+static int
+readcount(
+	unsigned long long *count /* counter values */
+	)
+{
+#ifdef __linux__
+	unsigned long long buf[NCOUNT + 1]; /* nr, values */
+	int i;
+
+	if (read(perf_fd, buf, sizeof(buf)) != sizeof(buf))
+		return (-1);
+	for (i = 0; i < NCOUNT; i++)
+		count[i] = buf[i + 1];
+	return (0);
+#else /* __linux__ */
+	return (-1);
+#endif /* __linux__ */
+}
+
+/*
+ * tprint() - display timing summary on stderr
+ */
+static void
+tprint(void)
+{
+	struct stage *sp;
+	double total;
+	int i;
+
+	if (timing == 0)
+		return;
+	total = 0;
+	for (i = 0; i < NSTAGE; i++)
+		total += stages[i].time;
+	fprintf(stderr, "stage         calls    time (s)     %%  ns/call");
+	if (perf_fd >= 0)
+		fprintf(stderr, "       cycles        instr  cache-miss");
+	fprintf(stderr, "\n");
+	for (i = 0; i < NSTAGE; i++) {
+		sp = &stages[i];
+		fprintf(stderr, "%-9s %9ld %11.6f %5.1f %8.0f", sp->name,
+		    sp->calls, sp->time, total > 0 ? sp->time / total *
+		    100. : 0., sp->calls > 0 ? sp->time / sp->calls *
+		    1e9 : 0.);
+		if (perf_fd >= 0)
+			fprintf(stderr, " %12llu %12llu %11llu",
+			    sp->count[0], sp->count[1], sp->count[2]);
+		fprintf(stderr, "\n");
+	}
+	fprintf(stderr, "total               %11.6f\n", total);
+}
+#endif /* TIMING */
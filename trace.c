@@ -0,0 +1,228 @@
+/*
+ * Timeline trace export
+ *
+ * When enabled by the -t option, the program records a span for each
+ * receiver, day, hour block and thread phase and writes them at exit
+ * as a Chrome trace-event JSON file, which can be displayed with
+ * chrome://tracing or Perfetto. Each thread records its spans in its
+ * own buffer, which is a list of fixed-size chunks, so recording a
+ * span needs no locks and no copying. The buffers are linked on a
+ * global list the first time a thread records a span.
+ *
+ * A span is recorded by saving the start time returned by tbegin() and
+ * passing it to tend() along with a name, category and integer
+ * argument. The name and category must be static strings.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "minimuf.h"
+
+#define TCHUNK	4096		/* events per chunk */
+
+/*
+ * Trace event
+ */
+struct tevent {
+	char *name;		/* event name */
+	char *cat;		/* event category */
+	double ts;		/* start time (us) */
+	double dur;		/* duration (us) */
+	long arg;		/* argument */
+};
+
+/*
+ * Chunk of trace events
+ */
+struct tchunk {
+	struct tchunk *next;	/* next chunk */
+	int n;			/* number of events */
+	struct tevent ev[TCHUNK]; /* events */
+};
+
+/*
+ * Per-thread trace buffer
+ */
+struct tbuf {
+	struct tbuf *next;	/* next buffer on global list */
+	int tid;		/* thread number */
+	char *name;		/* thread name */
+	struct tchunk *head;	/* first chunk */
+	struct tchunk *tail;	/* current chunk */
+};
+
+int tracing;			/* tracing enabled */
+
+static char *tracefile;		/* trace file name */
+static struct tbuf *tlist;	/* list of thread buffers */
+static int ntid;		/* thread numbers assigned */
+static double t0;		/* trace origin (us) */
+static __thread struct tbuf *tb; /* this thread's buffer */
+
+/*
+ * Local function declarations
+ */
+static double tnow(void);
+static struct tbuf *tget(void);
+static void twrite(void);
+
+/*
+ * trinit(file) - initialize tracing
+ */
+void
+trinit(
+	char *file		/* trace file name */
+	)
+{
+	tracefile = file;
+	t0 = tnow();
+	tracing = 1;
+	atexit(twrite);
+	trname("main");
+}
+
+/*
+ * trname(name) - name the current thread
+ */
+void
+trname(
+	char *name		/* thread name (static) */
+	)
+{
+	if (!tracing)
+		return;
+	tget()->name = name;
+}
+
+/*
+ * tbegin() - start span
+ *
+ * Returns the start time, which is zero if tracing is not enabled.
+ */
+double
+tbegin(void)
+{
+	if (!tracing)
+		return (0);
+	return (tnow());
+}
+
+/*
+ * tend(name, cat, start, arg) - end span
+ */
+void
+tend(
+	char *name,		/* span name */
+	char *cat,		/* span category */
+	double start,		/* start time from tbegin() */
+	long arg		/* argument */
+	)
+{
+	struct tbuf *bp;
+	struct tchunk *cp;
+	struct tevent *ep;
+
+	if (!tracing)
+		return;
+	bp = tget();
+	cp = bp->tail;
+	if (cp->n == TCHUNK) {
+		cp = malloc(sizeof(struct tchunk));
+		if (cp == NULL)
+			return;
+		cp->next = NULL;
+		cp->n = 0;
+		bp->tail->next = cp;
+		bp->tail = cp;
+	}
+	ep = &cp->ev[cp->n++];
+	ep->name = name;
+	ep->cat = cat;
+	ep->ts = start - t0;
+	ep->dur = tnow() - start;
+	ep->arg = arg;
+}
+
+/*
+ * tget() - get this thread's buffer, creating it if necessary
+ */
+static struct tbuf *
+tget(void)
+{
+	struct tbuf *bp;
+
+	if (tb != NULL)
+		return (tb);
+	bp = calloc(1, sizeof(struct tbuf));
+	if (bp != NULL)
+		bp->head = bp->tail = calloc(1, sizeof(struct tchunk));
+	if (bp == NULL || bp->head == NULL) {
+		fprintf(stderr, "minimuf: no memory for trace\n");
+		exit(1);
+	}
+	bp->tid = __atomic_fetch_add(&ntid, 1, __ATOMIC_RELAXED);
+	bp->next = __atomic_load_n(&tlist, __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&tlist, &bp->next, bp, 1,
+	    __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+		;
+	tb = bp;
+	return (bp);
+}
+
+/*
+ * tnow() - monotonic time (us)
+ */
+static double
+tnow(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+/*
+ * twrite() - write trace file
+ *
+ * This is called at exit, after any other threads have finished.
+ */
+static void
+twrite(void)
+{
+	FILE *fp;
+	struct tbuf *bp;
+	struct tchunk *cp;
+	struct tevent *ep;
+	char *sep;
+	int i;
+
+	fp = fopen(tracefile, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "minimuf: cannot write trace %s\n",
+		    tracefile);
+		return;
+	}
+	fprintf(fp, "{\"traceEvents\":[\n");
+	sep = "";
+	for (bp = __atomic_load_n(&tlist, __ATOMIC_ACQUIRE); bp !=
+	    NULL; bp = bp->next) {
+		if (bp->name != NULL) {
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+			    sep, bp->tid, bp->name);
+			sep = ",\n";
+		}
+		for (cp = bp->head; cp != NULL; cp = cp->next) {
+			for (i = 0; i < cp->n; i++) {
+				ep = &cp->ev[i];
+				fprintf(fp, "%s{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"n\":%ld}}",
+				    sep, ep->name, ep->cat, bp->tid,
+				    ep->ts, ep->dur, ep->arg);
+				sep = ",\n";
+			}
+		}
+	}
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+}
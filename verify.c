@@ -0,0 +1,383 @@
+/*
+ * Differential verification of prediction kernels
+ *
+ * This routine generates a randomized corpus of paths, dates, hours,
+ * fluxes and frequencies and runs each kernel in the table below
+ * against the reference kernel (ref.c), which is the original program
+ * logic. It reports the maximum and RMS differences in MUF and receive
+ * power, together with the fraction of hop selections and path flags
+ * that differ, and fails if any of these exceed the tolerances.
+ *
+ * Command line:
+ *
+ *	minimuf -V count[,seed] [-K muf,dB,hop,flags]
+ *
+ *	count	number of corpus samples
+ *	seed	random number seed (default 1)
+ *	muf	max MUF difference (MHz)
+ *	dB	max receive power difference (dB)
+ *	hop	max fraction of hop selections that differ
+ *	flags	max fraction of path flags that differ
+ *
+ * The tolerances given by -K apply to all kernels; otherwise, each
+ * kernel has its own defaults. The receive power and flags are compared
+ * only when both kernels select the same hop.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "minimuf.h"
+
+/*
+ * Tolerance indices (tol)
+ */
+#define T_MUF	0		/* MUF (MHz) */
+#define T_DB	1		/* receive power (dB) */
+#define T_HOP	2		/* hop selection (fraction) */
+#define T_FLAG	3		/* path flags (fraction) */
+
+/*
+ * Kernel statistics
+ */
+struct stats {
+	double mufmax, mufsum;	/* MUF difference max, sum of squares */
+	double dbmax, dbsum;	/* power difference max, sum of squares */
+	long nmuf, ndb;		/* number of MUF, power comparisons */
+	long ncell;		/* number of cells compared */
+	long nhop;		/* hop selections that differ */
+	long nflag;		/* path flags that differ */
+};
+
+/*
+ * Local function declarations
+ */
+static void live_evaluate(struct param *, struct path *, double,
+    struct result *);
+static void batch_evaluate(struct param *, struct path *, double,
+    struct result *);
+static void float_evaluate(struct param *, struct path *, double,
+    struct result *);
+static void approx_evaluate(struct param *, struct path *, double,
+    struct result *);
+static double urand(double, double);
+static void diff(double, double, double *, double *, long *);
+
+/*
+ * Kernel table. The reference kernel is not included. Kernels that
+ * are intended to be exact have zero tolerances.
+ */
+static struct kernel kernels[] = {
+	{"live", live_evaluate, {0, 0, 0, 0}},
+	{"batch", batch_evaluate, {1e-9, 1e-6, 0, 0}},
+	{"float", float_evaluate, {1e-3, .1, 1e-3, 1e-3}},
+	{"approx", approx_evaluate, {1e-6, 1e-6, 1e-4, 1e-4}},
+	{NULL, NULL, {0, 0, 0, 0}}
+};
+
+static unsigned long long seed;	/* random number state */
+
+/*
+ * verify(spec, tol) - verify kernels against reference
+ */
+int
+verify(
+	char *spec,		/* count[,seed] */
+	char *tolspec		/* muf,dB,hop,flags */
+	)
+{
+	struct param par;	/* prediction parameters */
+	struct path path, kpath; /* path state */
+	struct result ref, res;	/* predictions */
+	struct stats st[sizeof(kernels) / sizeof(kernels[0])];
+	struct kernel *kp;	/* kernel pointer */
+	struct stats *sp;	/* statistics pointer */
+	double tol[4];		/* tolerances */
+	double hour;		/* hour of day (UTC) */
+	long count, n;		/* corpus size */
+	long nskip;		/* samples skipped */
+	int i, j, k, ntol;	/* int temps */
+	int fail;		/* failure count */
+
+	count = 0;
+	seed = 1;
+	if (sscanf(spec, "%ld,%llu", &count, &seed) < 1 || count <= 0) {
+		fprintf(stderr, "minimuf: bad verify count %s\n", spec);
+		return (1);
+	}
+	if (seed == 0)
+		seed = 1;
+	ntol = 0;
+	if (tolspec != NULL) {
+		ntol = sscanf(tolspec, "%lf,%lf,%lf,%lf", &tol[0],
+		    &tol[1], &tol[2], &tol[3]);
+		if (ntol != 4) {
+			fprintf(stderr,
+			    "minimuf: bad verify tolerances %s\n",
+			    tolspec);
+			return (1);
+		}
+	}
+	memset(st, 0, sizeof(st));
+	nskip = 0;
+
+	/*
+	 * Construct a synthetic antenna gain table. This is used for
+	 * half the corpus; the other half uses isotropic antennas.
+	 */
+	antenna.freq[0] = 3.5;
+	antenna.freq[1] = 7.;
+	antenna.freq[2] = 14.;
+	antenna.freq[3] = 21.;
+	antenna.freq[4] = 28.;
+	for (i = 0; i < 46; i++) {
+		for (j = 0; j < NGAIN; j++)
+			antenna.gain[i][j] = 10. * sin(i * (j + 1) * PI / 90.) -
+			    5. + urand(-1., 1.);
+	}
+
+	/*
+	 * Main loop. Each sample is a random path, date, hour, flux,
+	 * power and frequency list.
+	 */
+	for (n = 0; n < count; n++) {
+		memset(&par, 0, sizeof(par));
+		par.ant = &antenna;
+		par.month = (int)urand(1., 13.);
+		par.day = (int)urand(1., 32.);
+		par.flux = urand(60., 300.);
+		par.ssn = spots(par.flux);
+		par.dB1 = urand(0., 40.);
+		par.noise = 10. * log10(BOLTZ * NTEMP * DELTAF) + 30.;
+		par.minbeta = MINBETA;
+		if (urand(0., 1.) < .2)
+			par.minbeta = urand(1., 20.) * D2R;
+		if (urand(0., 1.) < .5)
+			par.options |= H_GAIN;
+		if (urand(0., 1.) < .2)
+			par.options |= H_LONG;
+		par.nfreq = (int)urand(1., FMAX + 1.);
+		for (i = 0; i < par.nfreq; i++)
+			par.freq[i] = urand(1.5, 35.);
+		hour = (int)urand(0., 24.);
+		memset(&path, 0, sizeof(path));
+		path.lat1 = urand(-89., 89.) * D2R;
+		path.lon1 = urand(-180., 180.) * D2R;
+		path.lat2 = urand(-89., 89.) * D2R;
+		path.lon2 = urand(-180., 180.) * D2R;
+		for (i = 0; i < HMAX; i++)
+			path.dB2[i] = urand(-150., -60.);
+
+		/*
+		 * Paths needing more than HMAX hops overrun the hop
+		 * arrays in the reference kernel, so these are skipped.
+		 */
+		kpath = path;
+		geometry(&par, &kpath);
+		if (kpath.hop + 3 > HMAX) {
+			nskip++;
+			continue;
+		}
+		ref_evaluate(&par, &path, hour, &ref);
+
+		/*
+		 * Run each kernel in turn on its own copy of the path.
+		 */
+		for (k = 0; kernels[k].name != NULL; k++) {
+			kp = &kernels[k];
+			sp = &st[k];
+			kpath = path;
+			kp->eval(&par, &kpath, hour, &res);
+			diff(ref.muf, res.muf, &sp->mufmax, &sp->mufsum,
+			    &sp->nmuf);
+			sp->ncell++;
+			if (ref.best != res.best || ref.bhop != res.bhop)
+				sp->nhop++;
+			for (i = 0; i < par.nfreq; i++) {
+				sp->ncell++;
+				if (ref.f[i].hop != res.f[i].hop) {
+					sp->nhop++;
+					continue;
+				}
+				if (ref.f[i].hop == 0)
+					continue;
+				if (ref.f[i].flags != res.f[i].flags)
+					sp->nflag++;
+				diff(ref.f[i].dB2, res.f[i].dB2,
+				    &sp->dbmax, &sp->dbsum, &sp->ndb);
+			}
+		}
+	}
+
+	/*
+	 * Display the results.
+	 */
+	fail = 0;
+	if (nskip > 0)
+		printf("%ld samples skipped (too many hops)\n", nskip);
+	printf("kernel   samples  MUF max  MUF rms   dB max   dB rms     hop   flags\n");
+	for (k = 0; kernels[k].name != NULL; k++) {
+		kp = &kernels[k];
+		sp = &st[k];
+		if (ntol == 0)
+			memcpy(tol, kp->tol, sizeof(tol));
+		printf("%-8s %7ld %8.5f %8.5f %8.4f %8.4f %7.5f %7.5f",
+		    kp->name, count - nskip, sp->mufmax, sp->nmuf > 0 ?
+		    sqrt(sp->mufsum / sp->nmuf) : 0., sp->dbmax,
+		    sp->ndb > 0 ? sqrt(sp->dbsum / sp->ndb) : 0.,
+		    (double)sp->nhop / sp->ncell,
+		    (double)sp->nflag / sp->ncell);
+		if (sp->mufmax > tol[T_MUF] || sp->dbmax > tol[T_DB] ||
+		    (double)sp->nhop / sp->ncell > tol[T_HOP] ||
+		    (double)sp->nflag / sp->ncell > tol[T_FLAG]) {
+			printf(" FAIL\n");
+			fail++;
+		} else {
+			printf(" pass\n");
+		}
+	}
+	return (fail > 0);
+}
+
+/*
+ * live_evaluate(par, p, hour, r) - main program kernel
+ */
+static void
+live_evaluate(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	struct result *r	/* prediction */
+	)
+{
+	geometry(pp, p);
+	evaluate(pp, p, hour, r);
+}
+
+/*
+ * batch_evaluate(par, p, hour, r) - batch geometry kernel
+ *
+ * The path geometry is computed by catgeom() for a catalog of one
+ * receiver, which differs from geometry() only by roundoff.
+ */
+static void
+batch_evaluate(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	struct result *r	/* prediction */
+	)
+{
+	static struct catalog cat; /* receiver catalog */
+	static struct gbatch gb; /* geometry batch */
+	struct station txs;	/* transmitter */
+
+	if (gb.size == 0 && gbinit(&gb, 1) < 0)
+		exit(1);
+	txs.lat = p->lat1;
+	txs.lon = p->lon1;
+	txs.slat = sin(p->lat1);
+	txs.clat = cos(p->lat1);
+	txs.slon = sin(p->lon1);
+	txs.clon = cos(p->lon1);
+	cat.n = 0;
+	if (catadd(&cat, p->lat2, p->lon2) < 0)
+		exit(1);
+	catgeom(pp, &txs, &cat, 0, 1, &gb);
+	catpath(&gb, 0, p);
+	evaluate(pp, p, hour, r);
+}
+
+/*
+ * float_evaluate(par, p, hour, r) - single-precision geometry kernel
+ *
+ * This is the batch geometry kernel in single precision (-f option).
+ * The MUF and receive power differ by roundoff in the geometry, which
+ * is enough to move a frequency across the 0.85 MUF limit now and then,
+ * so the tolerances are not zero.
+ */
+static void
+float_evaluate(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	struct result *r	/* prediction */
+	)
+{
+	struct param pf;	/* parameters with -f */
+
+	pf = *pp;
+	pf.options |= H_FLOAT;
+	batch_evaluate(&pf, p, hour, r);
+}
+
+/*
+ * approx_evaluate(par, p, hour, r) - approximate kernels
+ *
+ * This is the live kernel with the table-driven power laws and
+ * exponential (-A option). The errors are near roundoff, but may move
+ * a frequency across the multipath or sensitivity limit now and then.
+ */
+static void
+approx_evaluate(
+	struct param *pp,	/* prediction parameters */
+	struct path *p,		/* path state */
+	double hour,		/* hour of day (UTC) */
+	struct result *r	/* prediction */
+	)
+{
+	struct param pa;	/* parameters with -A */
+
+	pa = *pp;
+	pa.options |= H_APPROX;
+	live_evaluate(&pa, p, hour, r);
+}
+
+/*
+ * diff(a, b, max, sum, n) - accumulate difference statistics
+ *
+ * Two NaNs compare equal; a NaN and a number compare infinitely
+ * different.
+ */
+static void
+diff(
+	double a,		/* reference value */
+	double b,		/* kernel value */
+	double *max,		/* max difference */
+	double *sum,		/* sum of squares */
+	long *n			/* number of values */
+	)
+{
+	double ftemp;		/* double temp */
+
+	if (isnan(a) && isnan(b))
+		ftemp = 0.;
+	else if (isnan(a) || isnan(b))
+		ftemp = HUGE_VAL;
+	else
+		ftemp = fabs(a - b);
+	if (ftemp > *max)
+		*max = ftemp;
+	*sum += ftemp * ftemp;
+	(*n)++;
+}
+
+/*
+ * urand(lo, hi) - uniform random number in [lo, hi)
+ *
+ * This is the xorshift64* generator, which is used instead of the
+ * library generator so the corpus is the same on all systems.
+ */
+static double
+urand(
+	double lo,		/* lower bound */
+	double hi		/* upper bound */
+	)
+{
+	seed ^= seed >> 12;
+	seed ^= seed << 25;
+	seed ^= seed >> 27;
+	return (lo + (hi - lo) * ((seed * 2685821657736338717ULL) >>
+	    11) / 9007199254740992.);
+}
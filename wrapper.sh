@@ -74,9 +74,8 @@ echo "high_noise: $high_noise"
 
 
 get_best_hour() {
-	#echo "$data"|awk {'print $5'}
-	nnnihf_hour_path_descriptor=$(echo "$data"|grep -A24 'MUF Zen'|awk {'print $1, $5'}|tr "[a-z]" " "|awk {'print $2,$1'}|sort -n|awk {'print "UTC:" $2, "dB:" $1'}|tail -1)
-	echo best_hour: "$nnnihf_hour_path_descriptor"
+	best_hour=$(./minimuf -b 1 ${temp_in} dipole.dat 2>/dev/null|awk '/^ *1 /{print "UTC:" $4, "dB:" $6+0}')
+	echo best_hour: "$best_hour"
 }
 get_best_hour
 